@@ -0,0 +1,72 @@
+AR = ['/usr/bin/ar']
+ARFLAGS = ['rcs']
+BINDIR = '/usr/local/bin'
+BUILD_FCGI = False
+BUILD_MPRPC = False
+BUILD_MYSQL = False
+BUILD_PGSQL = False
+CC_VERSION = ('12', '2', '0')
+COMPILER_CXX = 'g++'
+CPPPATH_ST = '-I%s'
+CXX = ['/usr/bin/g++']
+CXXFLAGS = ['-O2', '-Wall', '-g', '-pipe', '-D_REENTRANT', '-fno-omit-frame-pointer', '-std=c++11', '-Wno-deprecated-declarations']
+CXXFLAGS_MACBUNDLE = ['-fPIC']
+CXXFLAGS_cxxshlib = ['-fPIC']
+CXXLNK_SRC_F = []
+CXXLNK_TGT_F = ['-o']
+CXX_NAME = 'gcc'
+CXX_SRC_F = []
+CXX_TGT_F = ['-c', '-o']
+DATADIR = '/usr/local/share'
+DATAROOTDIR = '/usr/local/share'
+DEFINES = []
+DEFINES_ST = '-D%s'
+DEFINE_COMMENTS = {'HAVE_MSGPACK_HPP': '', 'HAVE_FCGIAPP_H': '', 'HAVE_STDINT_H': '', 'PFICOMMON_VERSION': ''}
+DEST_BINFMT = 'elf'
+DEST_CPU = 'x86_64'
+DEST_OS = 'linux'
+DOCDIR = '/usr/local/share/doc/pficommon'
+DVIDIR = '/usr/local/share/doc/pficommon'
+EXEC_PREFIX = '/usr/local'
+FEATURES = 'cxx cxxshlib'
+HAVE_STDINT_H = 1
+HPREFIX = '/usr/local/include/pficommon'
+HTMLDIR = '/usr/local/share/doc/pficommon'
+INCLUDEDIR = '/usr/local/include'
+INFODIR = '/usr/local/share/info'
+LIBDIR = '/usr/local/lib64'
+LIBEXECDIR = '/usr/local/libexec'
+LIBPATH_ST = '-L%s'
+LIB_GTEST_PTHREAD = ['pthread']
+LIB_PTHREAD = ['pthread']
+LIB_ST = '-l%s'
+LINKFLAGS_MACBUNDLE = ['-bundle', '-undefined', 'dynamic_lookup']
+LINKFLAGS_cxxshlib = ['-shared']
+LINKFLAGS_cxxstlib = ['-Wl,-Bstatic']
+LINK_CXX = ['/usr/bin/g++']
+LOCALEDIR = '/usr/local/share/locale'
+LOCALSTATEDIR = '/usr/local/var'
+MANDIR = '/usr/local/share/man'
+OBJECTS_CXXFLAGS = ['-fPIC']
+OLDINCLUDEDIR = '/usr/include'
+PACKAGE = 'pficommon'
+PDFDIR = '/usr/local/share/doc/pficommon'
+PREFIX = '/usr/local'
+PSDIR = '/usr/local/share/doc/pficommon'
+RPATH_ST = '-Wl,-rpath,%s'
+SBINDIR = '/usr/local/sbin'
+SHAREDSTATEDIR = '/usr/local/com'
+SHLIB_MARKER = '-Wl,-Bdynamic'
+SONAME_ST = '-Wl,-h,%s'
+STLIBPATH_ST = '-L%s'
+STLIB_MARKER = '-Wl,-Bstatic'
+STLIB_ST = '-l%s'
+SYSCONFDIR = '/usr/local/etc'
+UNITTEST_GTEST_PATH = '/root/repo/.unittest-gtest'
+VERSION = '4.0.0'
+cfg_files = ['/root/repo/build/src/pfi-config.h']
+cxxprogram_PATTERN = '%s'
+cxxshlib_PATTERN = 'lib%s.so'
+cxxstlib_PATTERN = 'lib%s.a'
+define_key = []
+macbundle_PATTERN = '%s.bundle'
@@ -0,0 +1,11 @@
+/* WARNING! All changes made to this file will be lost! */
+
+#ifndef W_SRC_PFI_CONFIG_H_WAF
+#define W_SRC_PFI_CONFIG_H_WAF
+
+/* #undef HAVE_MSGPACK_HPP */
+/* #undef HAVE_FCGIAPP_H */
+#define HAVE_STDINT_H 1
+#define PFICOMMON_VERSION "4.0.0"
+
+#endif /* W_SRC_PFI_CONFIG_H_WAF */
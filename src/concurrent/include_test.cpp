@@ -5,6 +5,7 @@
 #include "mutex.h"
 #include "mutex_impl.h"
 #include "mvar.h"
+#include "parallel.h"
 #include "pcbuf.h"
 #include "qsem.h"
 #include "rwmutex.h"
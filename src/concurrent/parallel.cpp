@@ -0,0 +1,70 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "parallel.h"
+
+#include "thread.h"
+#include "../lang/bind.h"
+#include "../lang/shared_ptr.h"
+
+using namespace std;
+
+namespace pfi {
+namespace concurrent {
+
+namespace {
+
+void call_at(const vector<pfi::lang::function<void()> >* fs, int i)
+{
+  (*fs)[i]();
+}
+
+} // anonymous namespace
+
+void parallel_run(int n, const pfi::lang::function<void(int)>& f)
+{
+  vector<pfi::lang::shared_ptr<thread> > ths;
+  for (int i=1;i<n;++i) {
+    pfi::lang::shared_ptr<thread> th(new thread(pfi::lang::bind(f,i)));
+    if (th->start()) ths.push_back(th);
+    else f(i);
+  }
+  if (n>0) f(0);
+  for (size_t i=0;i<ths.size();++i) ths[i]->join();
+}
+
+void parallel_run(const vector<pfi::lang::function<void()> >& fs)
+{
+  parallel_run(fs.size(), pfi::lang::bind(&call_at, &fs, pfi::lang::_1));
+}
+
+} // concurrent
+} // pfi
@@ -0,0 +1,58 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INCLUDE_GUARD_PFI_CONCURRENT_PARALLEL_H_
+#define INCLUDE_GUARD_PFI_CONCURRENT_PARALLEL_H_
+
+#include <vector>
+
+#include "../lang/function.h"
+
+namespace pfi {
+namespace concurrent {
+
+/**
+ * @brief runs f(0), ..., f(n-1) in parallel and waits for all of them
+ *
+ * f(0) runs on the calling thread and the others on their own threads.
+ * when a thread cannot be started, its call runs on the calling thread
+ * instead, so every call is made exactly once. f must not throw.
+ */
+void parallel_run(int n, const pfi::lang::function<void(int)>& f);
+
+/**
+ * @brief runs every function of fs in parallel and waits for them
+ */
+void parallel_run(const std::vector<pfi::lang::function<void()> >& fs);
+
+} // concurrent
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_CONCURRENT_PARALLEL_H_
@@ -0,0 +1,72 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include "parallel.h"
+
+#include <vector>
+
+#include "../lang/bind.h"
+
+using namespace std;
+using namespace pfi::concurrent;
+using namespace pfi::lang;
+
+namespace {
+
+void count_at(vector<int> *counts, int i)
+{
+  (*counts)[i]++;
+}
+
+} // namespace
+
+TEST(parallel, parallel_run)
+{
+  for (int n = 0; n <= 8; n++) {
+    vector<int> counts(n);
+    parallel_run(n, bind(&count_at, &counts, _1));
+    EXPECT_TRUE(vector<int>(n, 1) == counts);
+  }
+}
+
+TEST(parallel, parallel_run_functions)
+{
+  vector<int> counts(5);
+  vector<pfi::lang::function<void()> > fs;
+  for (int i = 0; i < 5; i++)
+    fs.push_back(bind(&count_at, &counts, i));
+  parallel_run(fs);
+  EXPECT_TRUE(vector<int>(5, 1) == counts);
+
+  parallel_run(vector<pfi::lang::function<void()> >());
+}
@@ -0,0 +1,479 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "block_codec.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "../../system/endian_util.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#define PFI_BLOCK_CODEC_X86
+#endif
+
+using namespace std;
+using namespace pfi::system::endian;
+
+namespace pfi {
+namespace data {
+namespace code {
+
+  namespace {
+
+    inline uint32_t load32(const unsigned char* p) {
+      uint32_t v;
+      memcpy(&v,p,4);
+      return to_little(v);
+    }
+
+    inline void store32(unsigned char* p, uint32_t v) {
+      v=to_little(v);
+      memcpy(p,&v,4);
+    }
+
+    inline unsigned int bits_of(uint32_t v) {
+      return v?32-__builtin_clz(v):0;
+    }
+
+    inline uint32_t low_mask(unsigned int b) {
+      return b>=32?0xffffffffU:(1U<<b)-1;
+    }
+
+    inline size_t varint_size(uint32_t v) {
+      size_t s=1;
+      while (v>=128) {
+        v>>=7;
+        ++s;
+      }
+      return s;
+    }
+
+    inline unsigned char* put_varint(unsigned char* p, uint32_t v) {
+      while (v>=128) {
+        *p++=(v&127)|128;
+        v>>=7;
+      }
+      *p++=v;
+      return p;
+    }
+
+    inline const unsigned char* get_varint(const unsigned char* p, uint32_t& v) {
+      uint32_t c=*p++;
+      v=c&127;
+      for (unsigned int s=7;c&128;s+=7) {
+        c=*p++;
+        v|=(c&127)<<s;
+      }
+      return p;
+    }
+
+    ////////////////////////////////////////////////////////////////
+    //
+    // 128 values of b bits in 4 lanes. value 4*j+l is the j-th value
+    // of lane l, and word k of lane l is at byte 16*k+4*l, so one
+    // 16 byte load holds word k of all lanes.
+    //
+
+    void pack_block(const uint32_t* in, unsigned int b, unsigned char* out) {
+      uint32_t w[4*32];
+      fill(w,w+4*b,0);
+      for (unsigned int j=0;j<32&&b>0;++j) {
+        unsigned int pos=j*b,k=pos>>5,sh=pos&31;
+        for (unsigned int l=0;l<4;++l) {
+          uint32_t v=in[4*j+l]&low_mask(b);
+          w[4*k+l]|=v<<sh;
+          if (sh+b>32) w[4*(k+1)+l]|=v>>(32-sh);
+        }
+      }
+      for (unsigned int i=0;i<4*b;++i) store32(out+4*i,w[i]);
+    }
+
+    void unpack_block_scalar(const unsigned char* in, unsigned int b, uint32_t* out) {
+      if (b==0) {
+        fill(out,out+pack_block_size,0);
+        return;
+      }
+      uint32_t mask=low_mask(b);
+      for (unsigned int j=0;j<32;++j) {
+        unsigned int pos=j*b,k=pos>>5,sh=pos&31;
+        for (unsigned int l=0;l<4;++l) {
+          uint32_t v=load32(in+16*k+4*l)>>sh;
+          if (sh+b>32) v|=load32(in+16*(k+1)+4*l)<<(32-sh);
+          out[4*j+l]=v&mask;
+        }
+      }
+    }
+
+#ifdef PFI_BLOCK_CODEC_X86
+    void unpack_block_sse2(const unsigned char* in, unsigned int b, uint32_t* out) {
+      if (b==0) {
+        fill(out,out+pack_block_size,0);
+        return;
+      }
+      const __m128i mask=_mm_set1_epi32(low_mask(b));
+      for (unsigned int j=0;j<32;++j) {
+        unsigned int pos=j*b,k=pos>>5,sh=pos&31;
+        __m128i v=_mm_srl_epi32(_mm_loadu_si128((const __m128i*)(in+16*k)),_mm_cvtsi32_si128(sh));
+        if (sh+b>32) {
+          __m128i h=_mm_loadu_si128((const __m128i*)(in+16*(k+1)));
+          v=_mm_or_si128(v,_mm_sll_epi32(h,_mm_cvtsi32_si128(32-sh)));
+        }
+        _mm_storeu_si128((__m128i*)(out+4*j),_mm_and_si128(v,mask));
+      }
+    }
+
+    void delta_decode_sse2(uint32_t* p, size_t n, uint32_t prev) {
+      __m128i s=_mm_set1_epi32(prev);
+      size_t i=0;
+      for (;i+4<=n;i+=4) {
+        __m128i v=_mm_loadu_si128((const __m128i*)(p+i));
+        v=_mm_add_epi32(v,_mm_slli_si128(v,4));
+        v=_mm_add_epi32(v,_mm_slli_si128(v,8));
+        v=_mm_add_epi32(v,s);
+        _mm_storeu_si128((__m128i*)(p+i),v);
+        s=_mm_shuffle_epi32(v,0xff);
+      }
+      uint32_t last=i>0?p[i-1]:prev;
+      for (;i<n;++i) last=p[i]+=last;
+    }
+#endif
+
+    ////////////////////////////////////////////////////////////////
+    //
+    // stream vbyte
+    //
+
+    struct svb_tables {
+      unsigned char len[256];
+      unsigned char shuffle[256][16];
+
+      svb_tables() {
+        for (int c=0;c<256;++c) {
+          int o=0;
+          for (int i=0;i<4;++i) {
+            int l=((c>>(2*i))&3)+1;
+            for (int j=0;j<4;++j) shuffle[c][4*i+j]=j<l?o+j:0x80;
+            o+=l;
+          }
+          len[c]=o;
+        }
+      }
+    };
+
+    const svb_tables& svb() {
+      static const svb_tables t;
+      return t;
+    }
+
+    inline unsigned int svb_code(uint32_t v) {
+      return v<(1U<<8)?0:v<(1U<<16)?1:v<(1U<<24)?2:3;
+    }
+
+    // decodes groups [g, groups) of 4 values, returns the data end
+    const unsigned char* svb_decode_scalar(const unsigned char* ctrl, const unsigned char* data,
+                                           size_t g, size_t n, uint32_t* out) {
+      for (size_t i=g*4;i<n;++i) {
+        unsigned int l=((ctrl[i>>2]>>(2*(i&3)))&3)+1;
+        uint32_t v=0;
+        for (unsigned int j=0;j<l;++j) v|=uint32_t(data[j])<<(8*j);
+        data+=l;
+        out[i]=v;
+      }
+      return data;
+    }
+
+#ifdef PFI_BLOCK_CODEC_X86
+    __attribute__((target("ssse3")))
+    const unsigned char* svb_decode_ssse3(const unsigned char* ctrl, const unsigned char* data,
+                                          const unsigned char* data_end, size_t& g, size_t groups,
+                                          uint32_t* out) {
+      const svb_tables& t=svb();
+      for (;g<groups&&data+16<=data_end;++g) {
+        unsigned char c=ctrl[g];
+        __m128i d=_mm_loadu_si128((const __m128i*)data);
+        __m128i s=_mm_loadu_si128((const __m128i*)t.shuffle[c]);
+        _mm_storeu_si128((__m128i*)(out+4*g),_mm_shuffle_epi8(d,s));
+        data+=t.len[c];
+      }
+      return data;
+    }
+#endif
+
+    ////////////////////////////////////////////////////////////////
+    //
+    // dispatch
+    //
+
+    simd_level best_simd() {
+#ifdef PFI_BLOCK_CODEC_X86
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("ssse3")) return simd_ssse3;
+      return simd_sse2;
+#else
+      return simd_scalar;
+#endif
+    }
+
+    simd_level current_simd=best_simd();
+
+    inline void unpack_block(const unsigned char* in, unsigned int b, uint32_t* out) {
+#ifdef PFI_BLOCK_CODEC_X86
+      if (current_simd>=simd_sse2) {
+        unpack_block_sse2(in,b,out);
+        return;
+      }
+#endif
+      unpack_block_scalar(in,b,out);
+    }
+
+    size_t encode_tail(const uint32_t* in, size_t n, unsigned char* out) {
+      unsigned char* p=out;
+      for (size_t i=0;i<n;++i) p=put_varint(p,in[i]);
+      return p-out;
+    }
+
+    size_t decode_tail(const unsigned char* in, size_t n, uint32_t* out) {
+      const unsigned char* p=in;
+      for (size_t i=0;i<n;++i) p=get_varint(p,out[i]);
+      return p-in;
+    }
+
+  }
+
+  ////////////////////////////////////////////////////////////////
+  //
+  // transforms
+  //
+
+  void delta_encode(uint32_t* p, size_t n, uint32_t prev)
+  {
+    for (size_t i=0;i<n;++i) {
+      uint32_t v=p[i];
+      p[i]=v-prev;
+      prev=v;
+    }
+  }
+
+  void delta_decode(uint32_t* p, size_t n, uint32_t prev)
+  {
+#ifdef PFI_BLOCK_CODEC_X86
+    if (current_simd>=simd_sse2) {
+      delta_decode_sse2(p,n,prev);
+      return;
+    }
+#endif
+    for (size_t i=0;i<n;++i) prev=p[i]+=prev;
+  }
+
+  void zigzag_encode(const int32_t* in, size_t n, uint32_t* out)
+  {
+    for (size_t i=0;i<n;++i) out[i]=(uint32_t(in[i])<<1)^uint32_t(in[i]>>31);
+  }
+
+  void zigzag_decode(const uint32_t* in, size_t n, int32_t* out)
+  {
+    for (size_t i=0;i<n;++i) out[i]=int32_t((in[i]>>1)^(0U-(in[i]&1)));
+  }
+
+  ////////////////////////////////////////////////////////////////
+  //
+  // bitpack
+  //
+
+  size_t bitpack_bound(size_t n)
+  {
+    return n/pack_block_size*(1+16*32)+n%pack_block_size*5;
+  }
+
+  size_t bitpack_encode(const uint32_t* in, size_t n, unsigned char* out)
+  {
+    unsigned char* p=out;
+    size_t i=0;
+    for (;i+pack_block_size<=n;i+=pack_block_size) {
+      uint32_t acc=0;
+      for (size_t j=0;j<pack_block_size;++j) acc|=in[i+j];
+      unsigned int b=bits_of(acc);
+      *p++=b;
+      pack_block(in+i,b,p);
+      p+=16*b;
+    }
+    p+=encode_tail(in+i,n-i,p);
+    return p-out;
+  }
+
+  size_t bitpack_decode(const unsigned char* in, size_t n, uint32_t* out)
+  {
+    const unsigned char* p=in;
+    size_t i=0;
+    for (;i+pack_block_size<=n;i+=pack_block_size) {
+      unsigned int b=*p++;
+      unpack_block(p,b,out+i);
+      p+=16*b;
+    }
+    p+=decode_tail(p,n-i,out+i);
+    return p-in;
+  }
+
+  ////////////////////////////////////////////////////////////////
+  //
+  // pfor
+  //
+
+  size_t pfor_bound(size_t n)
+  {
+    return n/pack_block_size*(2+16*32)+n%pack_block_size*5;
+  }
+
+  size_t pfor_encode(const uint32_t* in, size_t n, unsigned char* out)
+  {
+    unsigned char* p=out;
+    size_t i=0;
+    for (;i+pack_block_size<=n;i+=pack_block_size) {
+      const uint32_t* v=in+i;
+
+      // exact size for each bit width
+      size_t best=33,best_size=0;
+      for (unsigned int b=0;b<=32;++b) {
+        size_t size=2+16*b;
+        for (size_t j=0;j<pack_block_size;++j)
+          if (b<32&&(v[j]>>b)) size+=1+varint_size(v[j]>>b);
+        if (best>32||size<best_size) {
+          best=b;
+          best_size=size;
+        }
+      }
+
+      unsigned int b=best;
+      unsigned char* head=p;
+      p+=2;
+      pack_block(v,b,p);
+      p+=16*b;
+      unsigned int exc=0;
+      for (size_t j=0;j<pack_block_size;++j)
+        if (b<32&&(v[j]>>b)) {
+          *p++=j;
+          ++exc;
+        }
+      for (size_t j=0;j<pack_block_size;++j)
+        if (b<32&&(v[j]>>b)) p=put_varint(p,v[j]>>b);
+      head[0]=b;
+      head[1]=exc;
+    }
+    p+=encode_tail(in+i,n-i,p);
+    return p-out;
+  }
+
+  size_t pfor_decode(const unsigned char* in, size_t n, uint32_t* out)
+  {
+    const unsigned char* p=in;
+    size_t i=0;
+    for (;i+pack_block_size<=n;i+=pack_block_size) {
+      unsigned int b=p[0],exc=p[1];
+      p+=2;
+      unpack_block(p,b,out+i);
+      p+=16*b;
+      const unsigned char* pos=p;
+      p+=exc;
+      for (unsigned int j=0;j<exc;++j) {
+        uint32_t h;
+        p=get_varint(p,h);
+        out[i+pos[j]]|=h<<b;
+      }
+    }
+    p+=decode_tail(p,n-i,out+i);
+    return p-in;
+  }
+
+  ////////////////////////////////////////////////////////////////
+  //
+  // stream vbyte
+  //
+
+  size_t streamvbyte_bound(size_t n)
+  {
+    return (n+3)/4+4*n;
+  }
+
+  size_t streamvbyte_encode(const uint32_t* in, size_t n, unsigned char* out)
+  {
+    unsigned char* ctrl=out;
+    unsigned char* data=out+(n+3)/4;
+    fill(ctrl,data,0);
+    for (size_t i=0;i<n;++i) {
+      unsigned int c=svb_code(in[i]);
+      ctrl[i>>2]|=c<<(2*(i&3));
+      store32(data,in[i]);
+      data+=c+1;
+    }
+    return data-out;
+  }
+
+  size_t streamvbyte_decode(const unsigned char* in, size_t n, uint32_t* out)
+  {
+    const unsigned char* ctrl=in;
+    const unsigned char* data=in+(n+3)/4;
+    size_t g=0;
+#ifdef PFI_BLOCK_CODEC_X86
+    if (current_simd>=simd_ssse3) {
+      // the end of data is known from the control bytes, so the 16 byte
+      // loads never read past the input
+      const svb_tables& t=svb();
+      size_t len=0;
+      for (size_t i=0;i<n/4;++i) len+=t.len[ctrl[i]];
+      data=svb_decode_ssse3(ctrl,data,data+len,g,n/4,out);
+    }
+#endif
+    data=svb_decode_scalar(ctrl,data,g,n,out);
+    return data-in;
+  }
+
+  ////////////////////////////////////////////////////////////////
+  //
+  // dispatch
+  //
+
+  simd_level block_codec_simd()
+  {
+    return current_simd;
+  }
+
+  simd_level set_block_codec_simd(simd_level level)
+  {
+    current_simd=min(level,best_simd());
+    return current_simd;
+  }
+
+} // code
+} // data
+} // pfi
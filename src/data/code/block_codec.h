@@ -0,0 +1,117 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INCLUDE_GUARD_PFI_DATA_CODE_BLOCK_CODEC_H_
+#define INCLUDE_GUARD_PFI_DATA_CODE_BLOCK_CODEC_H_
+
+#include <stdint.h>
+#include <cstddef>
+
+namespace pfi {
+namespace data {
+namespace code {
+
+  /*
+   * block based integer codecs for uint32 sequences.
+   *
+   * unlike encoder/decoder, values are not coded one by one. they are
+   * packed in blocks of pack_block_size values so that decoding runs
+   * on SIMD registers:
+   *
+   *   bitpack:     per block, 1 byte bit width b, then 128 values of b
+   *                bits in 4 interleaved lanes (16*b bytes).
+   *   pfor:        like bitpack, but b is chosen to minimize the size and
+   *                values wider than b bits are patched as exceptions:
+   *                b, exception count, packed values, exception
+   *                positions (1 byte each), high bits (varint each).
+   *   streamvbyte: 2 bit length codes of 4 values per control byte,
+   *                then 1-4 little endian bytes per value.
+   *
+   * values after the last full block of bitpack and pfor are varints.
+   * the number of values is not stored; the caller keeps it. output
+   * buffers must have *_bound(n) bytes. decoders trust their input.
+   *
+   * sorted sequences should be delta coded first and signed values
+   * zigzag coded.
+   */
+
+  const size_t pack_block_size=128;
+
+  /**
+   * @brief p[i]-=p[i-1] in place (p[0]-=prev)
+   */
+  void delta_encode(uint32_t* p, size_t n, uint32_t prev=0);
+  /**
+   * @brief inverse of delta_encode (prefix sum)
+   */
+  void delta_decode(uint32_t* p, size_t n, uint32_t prev=0);
+
+  void zigzag_encode(const int32_t* in, size_t n, uint32_t* out);
+  void zigzag_decode(const uint32_t* in, size_t n, int32_t* out);
+
+  /**
+   * @return bytes written or read
+   */
+  size_t bitpack_bound(size_t n);
+  size_t bitpack_encode(const uint32_t* in, size_t n, unsigned char* out);
+  size_t bitpack_decode(const unsigned char* in, size_t n, uint32_t* out);
+
+  size_t pfor_bound(size_t n);
+  size_t pfor_encode(const uint32_t* in, size_t n, unsigned char* out);
+  size_t pfor_decode(const unsigned char* in, size_t n, uint32_t* out);
+
+  size_t streamvbyte_bound(size_t n);
+  size_t streamvbyte_encode(const uint32_t* in, size_t n, unsigned char* out);
+  size_t streamvbyte_decode(const unsigned char* in, size_t n, uint32_t* out);
+
+  /**
+   * @brief decode kernels
+   * the best level supported by the cpu is selected at startup.
+   */
+  enum simd_level {
+    simd_scalar,
+    simd_sse2,
+    simd_ssse3
+  };
+
+  simd_level block_codec_simd();
+
+  /**
+   * @brief select kernels, e.g. for benchmarks
+   * levels the cpu does not support are lowered. not thread safe.
+   * @return selected level
+   */
+  simd_level set_block_codec_simd(simd_level level);
+
+} // code
+} // data
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_DATA_CODE_BLOCK_CODEC_H_
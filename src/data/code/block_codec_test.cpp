@@ -0,0 +1,150 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include "block_codec.h"
+
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+using namespace pfi::data::code;
+
+namespace {
+
+typedef size_t (*encode_fn)(const uint32_t*, size_t, unsigned char*);
+typedef size_t (*decode_fn)(const unsigned char*, size_t, uint32_t*);
+typedef size_t (*bound_fn)(size_t);
+
+vector<uint32_t> random_values(size_t n, int max_bits, int wide_percent)
+{
+  vector<uint32_t> v(n);
+  for (size_t i=0;i<n;++i) {
+    int bits=random()%100<wide_percent?32:random()%(max_bits+1);
+    uint32_t x=(uint32_t(random())<<16)^uint32_t(random());
+    v[i]=bits==0?0:bits==32?x:x&((1U<<bits)-1);
+  }
+  return v;
+}
+
+void check_codec(bound_fn bound, encode_fn enc, decode_fn dec)
+{
+  const size_t sizes[]={0,1,5,127,128,129,256,1000,4096+77};
+  const int bits[]={0,1,7,12,20,32};
+  for (int level=simd_scalar;level<=simd_ssse3;++level) {
+    set_block_codec_simd(simd_level(level));
+    for (size_t s=0;s<sizeof(sizes)/sizeof(sizes[0]);++s) {
+      for (size_t b=0;b<sizeof(bits)/sizeof(bits[0]);++b) {
+        for (int wide=0;wide<=10;wide+=5) {
+          vector<uint32_t> in=random_values(sizes[s],bits[b],wide);
+          vector<unsigned char> buf(bound(in.size())+1,0xcc);
+          size_t len=enc(in.empty()?NULL:&in[0],in.size(),&buf[0]);
+          ASSERT_LE(len,bound(in.size()));
+          EXPECT_EQ(0xcc,buf[bound(in.size())]);
+
+          vector<uint32_t> out(in.size()+1,12345);
+          EXPECT_EQ(len,dec(&buf[0],in.size(),&out[0]));
+          EXPECT_EQ(12345U,out.back());
+          out.pop_back();
+          EXPECT_TRUE(in==out) << "level " << level << " n " << sizes[s] << " bits " << bits[b];
+        }
+      }
+    }
+  }
+  set_block_codec_simd(simd_ssse3);
+}
+
+}
+
+TEST(block_codec, bitpack) {
+  check_codec(&bitpack_bound,&bitpack_encode,&bitpack_decode);
+}
+
+TEST(block_codec, pfor) {
+  check_codec(&pfor_bound,&pfor_encode,&pfor_decode);
+}
+
+TEST(block_codec, streamvbyte) {
+  check_codec(&streamvbyte_bound,&streamvbyte_encode,&streamvbyte_decode);
+}
+
+TEST(block_codec, pfor_exceptions) {
+  // a few wide values should not widen the whole block
+  vector<uint32_t> in(pack_block_size,3);
+  in[5]=1U<<30;
+  in[100]=0xffffffffU;
+  vector<unsigned char> buf(pfor_bound(in.size()));
+  size_t len=pfor_encode(&in[0],in.size(),&buf[0]);
+  EXPECT_GT(100U,len);
+  vector<uint32_t> out(in.size());
+  pfor_decode(&buf[0],in.size(),&out[0]);
+  EXPECT_TRUE(in==out);
+}
+
+TEST(block_codec, delta) {
+  for (int level=simd_scalar;level<=simd_ssse3;++level) {
+    set_block_codec_simd(simd_level(level));
+    for (size_t n=0;n<40;++n) {
+      vector<uint32_t> v(n);
+      uint32_t x=7;
+      for (size_t i=0;i<n;++i) v[i]=x+=random()%1000;
+      vector<uint32_t> d=v;
+      delta_encode(d.empty()?NULL:&d[0],n,5);
+      if (n>0) {
+        EXPECT_EQ(v[0]-5,d[0]);
+      }
+      delta_decode(d.empty()?NULL:&d[0],n,5);
+      EXPECT_TRUE(v==d);
+    }
+  }
+  set_block_codec_simd(simd_ssse3);
+}
+
+TEST(block_codec, zigzag) {
+  const int32_t in[]={0,-1,1,-2,2,2147483647,-2147483647-1};
+  const uint32_t expected[]={0,1,2,3,4,0xfffffffeU,0xffffffffU};
+  uint32_t z[7];
+  int32_t out[7];
+  zigzag_encode(in,7,z);
+  zigzag_decode(z,7,out);
+  for (int i=0;i<7;++i) {
+    EXPECT_EQ(expected[i],z[i]);
+    EXPECT_EQ(in[i],out[i]);
+  }
+}
+
+TEST(block_codec, simd_level) {
+  simd_level best=set_block_codec_simd(simd_ssse3);
+  EXPECT_EQ(best,block_codec_simd());
+  EXPECT_EQ(simd_scalar,set_block_codec_simd(simd_scalar));
+  EXPECT_EQ(best,set_block_codec_simd(simd_ssse3));
+}
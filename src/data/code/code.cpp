@@ -34,6 +34,7 @@
 #include <algorithm>
 #include <fstream>
 #include <cassert>
+#include <stdint.h>
 
 #include "../../system/file.h"
 #include "../../system/endian_util.h"
@@ -56,7 +57,14 @@ namespace code {
 // encoder
 //
 
-  encoder::encoder():bit(0) { }
+  // bytes kept before they are written to an attached stream
+  static const size_t spill_size=1<<16;
+
+  encoder::encoder():bit(0),os(NULL),written(0) { }
+
+  encoder::~encoder() {
+    close();
+  }
 
   int encoder::flush(string fn) {
     ofstream ofs(fn.c_str());
@@ -65,19 +73,63 @@ namespace code {
 
   int encoder::flush(ostream& os) {
     int res=bytes.size();
-    os.write((char*)&bytes[0],bytes.size());
+    if (!bytes.empty()) os.write((char*)&bytes[0],bytes.size());
+    written+=bytes.size();
     bytes.clear();
     bit=0;
     return res;
   }
 
+  int encoder::open(const string& fn) {
+    close();
+    ofs.reset(new ofstream(fn.c_str(),ios::binary));
+    if (!*ofs) {
+      ofs.reset();
+      return -1;
+    }
+    attach(*ofs);
+    return 0;
+  }
+
+  void encoder::attach(ostream& os_) {
+    os=&os_;
+  }
+
+  int encoder::close() {
+    if (!os) return 0;
+    flush(*os);
+    os->flush();
+    bool ok=!os->fail();
+    os=NULL;
+    ofs.reset();
+    return ok?0:-1;
+  }
+
   vector<unsigned char>& encoder::get_bytes() {
     return bytes;
   }
 
+  uint64_t encoder::size() const {
+    return written+bytes.size();
+  }
+
+  void encoder::spill() {
+    // keep a partially written byte
+    size_t n=bytes.size()-(bit?1:0);
+    os->write((char*)&bytes[0],n);
+    written+=n;
+    if (bit) {
+      bytes[0]=bytes.back();
+      bytes.resize(1);
+    } else {
+      bytes.clear();
+    }
+  }
+
   void encoder::byte(unsigned char v) {
     bit=0;
     bytes.push_back(v);
+    if (os&&bytes.size()>=spill_size) spill();
   }
 
   void encoder::word_with_length(unsigned int v, unsigned int len)
@@ -93,6 +145,7 @@ namespace code {
       bit=(bit+consume)&7;
       rest=8;
     }
+    if (os&&bytes.size()>=spill_size) spill();
   }
 
   void encoder::gamma(unsigned int v)
@@ -124,6 +177,7 @@ namespace code {
       v>>=7;
     } 
     bytes.push_back(v+128);
+    if (os&&bytes.size()>=spill_size) spill();
   }
 
 ////////////////////////////////////////////////////////////////
@@ -131,7 +185,7 @@ namespace code {
 // decoder
 //
 
-  decoder::decoder():newed(false),pos(0),bit(0),bytes(NULL) 
+  decoder::decoder():newed(false),pos(0),bit(0),bytes(NULL),size(0)
   { 
   }
 
@@ -145,37 +199,62 @@ namespace code {
   }
 
   int decoder::attach(string fn) {
+    detach();
+    if (mm.open(fn)==0&&mm.size()>0) {
+      bytes=reinterpret_cast<const unsigned char*>(mm.begin());
+      size=mm.size();
+      return 0;
+    }
+    mm.close();
+
     ifstream ifs(fn.c_str());
     if (!ifs) return -1;
-    return attach(ifs,get_file_size(fn));
+    ssize_t fsize=get_file_size(fn);
+    if (fsize<0) return -1;
+    return attach(ifs,fsize);
   }
 
-  int decoder::attach(istream& is, int size) {
+  int decoder::attach(istream& is, uint64_t size_) {
     detach();
-    bytes=new unsigned char[size+sizeof(long long)];
+    unsigned char* buf=new unsigned char[size_+sizeof(long long)];
+    is.read((char*)&buf[0],size_);
+    for (uint64_t i=size_;i<size_+sizeof(long long);++i) buf[i]=0;
+    bytes=buf;
+    size=size_+sizeof(long long);
     newed=true;
-    is.read((char*)&bytes[0],size);
-    for (int i=size;i<(int)(size+sizeof(long long));++i) bytes[i]=0;
     return 0;
   }
 
-  int decoder::attach(unsigned char* buf)
+  int decoder::attach(const pfi::system::mmapper::mmapper& m)
+  {
+    if (!m.is_open()) return -1;
+    return attach(reinterpret_cast<const unsigned char*>(m.begin()),m.size());
+  }
+
+  int decoder::attach(const unsigned char* buf, uint64_t size_)
   {
     detach();
-    newed=false;
     bytes=buf;
+    size=size_;
     return 0;
   }
 
+  int decoder::attach(const unsigned char* buf)
+  {
+    return attach(buf,UINT64_MAX);
+  }
+
   void decoder::detach()
   {
     if (bytes&&newed) delete[] bytes;
+    mm.close();
     newed=false;
     bytes=NULL;
+    size=0;
     pos=bit=0;
   }
 
-  void decoder::seek(int pos_, int bit_) {
+  void decoder::seek(uint64_t pos_, unsigned int bit_) {
     pos=pos_;
     bit=bit_;
   }
@@ -184,37 +263,161 @@ namespace code {
     return bytes[pos++];
   }
 
+  // decoding works on a bit position p=pos*8+bit. a 64 bit load at
+  // p>>3 shifted by p&7 has at least 57 valid bits, so any code up to
+  // 57 bits is decoded from one load. codes up to code_table_bits bits
+  // are looked up in tables.
+  namespace {
+
+    const unsigned int code_table_bits=12;
+
+    struct code_entry {
+      unsigned short value;
+      unsigned char len;      // 0 if the code is longer than the table
+    };
+
+    struct code_tables {
+      code_entry gamma[1<<code_table_bits];
+      code_entry delta[1<<code_table_bits];
+
+      code_tables() {
+        for (unsigned int x=0;x<(1U<<code_table_bits);++x) {
+          gamma[x].value=delta[x].value=0;
+          gamma[x].len=delta[x].len=0;
+          if (x==0) continue;
+
+          unsigned int pmsf=__builtin_ctz(x);
+          unsigned int glen=2*pmsf+1;
+          if (glen>code_table_bits) continue;
+          unsigned int g=(1U<<pmsf)+((x>>(pmsf+1))&((1U<<pmsf)-1));
+          gamma[x].value=g;
+          gamma[x].len=glen;
+
+          unsigned int len=g-1;
+          if (glen+len>code_table_bits) continue;
+          delta[x].value=(1U<<len)+((x>>glen)&((1U<<len)-1));
+          delta[x].len=glen+len;
+        }
+      }
+    };
+
+    const code_tables& tables() {
+      static const code_tables t;
+      return t;
+    }
+
+    // a 64 bit load is done only if all 8 bytes are in the source
+    struct bit_source {
+      bit_source(const unsigned char* bytes, uint64_t size)
+        :bytes(bytes),size(size),limit(size>=8?size-7:0) {}
+
+      const unsigned char* bytes;
+      uint64_t size;
+      uint64_t limit;
+    };
+
+    inline uint64_t peek(const bit_source& s, uint64_t p) {
+      uint64_t b=p>>3;
+      if (__builtin_expect(b<s.limit,1))
+        return to_little(*(const uint64_t*)&s.bytes[b])>>(p&7);
+      uint64_t w=0;
+      for (unsigned int i=0;i<8&&b+i<s.size;++i) w|=uint64_t(s.bytes[b+i])<<(8*i);
+      return w>>(p&7);
+    }
+
+    inline unsigned int low_bits(uint64_t w, unsigned int len) {
+      return w&((1ULL<<len)-1);
+    }
+
+    inline unsigned int decode_gamma(const bit_source& src, uint64_t& p, const code_tables& t) {
+      uint64_t w=peek(src,p);
+      const code_entry& e=t.gamma[w&((1U<<code_table_bits)-1)];
+      if (e.len) {
+        p+=e.len;
+        return e.value;
+      }
+      unsigned int pmsf=__builtin_ctzll(w);
+      if (2*pmsf+1<=57) {
+        p+=2*pmsf+1;
+        return (1U<<pmsf)+low_bits(w>>(pmsf+1),pmsf);
+      }
+      p+=pmsf+1;
+      w=peek(src,p);
+      p+=pmsf;
+      return (1U<<pmsf)+low_bits(w,pmsf);
+    }
+
+    inline unsigned int decode_delta(const bit_source& src, uint64_t& p, const code_tables& t) {
+      const code_entry& e=t.delta[peek(src,p)&((1U<<code_table_bits)-1)];
+      if (e.len) {
+        p+=e.len;
+        return e.value;
+      }
+      unsigned int len=decode_gamma(src,p,t)-1;
+      uint64_t w=peek(src,p);
+      p+=len;
+      return (1U<<len)+low_bits(w,len);
+    }
+
+    inline unsigned int decode_rice(const bit_source& src, uint64_t& p, unsigned int k, const code_tables& t) {
+      unsigned int res=(decode_delta(src,p,t)-1)<<k;
+      uint64_t w=peek(src,p);
+      p+=k;
+      return res+low_bits(w,k);
+    }
+
+    inline unsigned int decode_prefix_code(const unsigned char* bytes, uint64_t& pos) {
+      unsigned int c=bytes[pos++];
+      if (c&128) return c-128;
+
+      unsigned int res=c;
+      unsigned int k=7;
+      while(!((c=bytes[pos++])&128)) {
+        res+=c<<k;
+        k+=7;
+      }
+      return res+((c-128)<<k);
+    }
+  }
+
   unsigned int decoder::word_with_length(unsigned int len)
   {
-    unsigned int v=to_little((*(long long*)&bytes[pos]))>>bit;
-    bit+=len;
-    pos+=bit>>3;
-    bit&=7;
-    return v&((1ULL<<len)-1);  
+    const bit_source src(bytes,size);
+    uint64_t p=pos*8+bit;
+    unsigned int v=low_bits(peek(src,p),len);
+    p+=len;
+    pos=p>>3;
+    bit=p&7;
+    return v;
   }
 
   unsigned int decoder::gamma()
   {
-    long long v=to_little((*(long long*)&bytes[pos]))>>bit;
-    unsigned int pmsf=__builtin_ctzll(v); 
-    bit+=pmsf+1;
-    pos+=bit>>3;
-    bit&=7;
-
-    unsigned int res=word_with_length(pmsf);
-    return (1U<<pmsf)+res;
+    const bit_source src(bytes,size);
+    uint64_t p=pos*8+bit;
+    unsigned int res=decode_gamma(src,p,tables());
+    pos=p>>3;
+    bit=p&7;
+    return res;
   }
 
   unsigned int decoder::delta()
   {
-    int len=gamma()-1;
-    return (1<<len)+word_with_length(len);
+    const bit_source src(bytes,size);
+    uint64_t p=pos*8+bit;
+    unsigned int res=decode_delta(src,p,tables());
+    pos=p>>3;
+    bit=p&7;
+    return res;
   }
 
   unsigned int decoder::rice(unsigned int k)
   {
-    unsigned int res=(delta()-1)<<k;
-    res+=word_with_length(k);
+    const bit_source src(bytes,size);
+    uint64_t p=pos*8+bit;
+    unsigned int res=decode_rice(src,p,k,tables());
+    pos=p>>3;
+    bit=p&7;
     return res;
   }
 
@@ -224,18 +427,51 @@ namespace code {
       ++pos;
       bit=0;
     }
+    uint64_t p=pos;
+    unsigned int res=decode_prefix_code(bytes,p);
+    pos=p;
+    return res;
+  }
+
+  void decoder::gamma_n(unsigned int* out, size_t n)
+  {
+    const code_tables& t=tables();
+    const bit_source src(bytes,size);
+    uint64_t p=pos*8+bit;
+    for (size_t i=0;i<n;++i) out[i]=decode_gamma(src,p,t);
+    pos=p>>3;
+    bit=p&7;
+  }
 
-    unsigned int res=0;
-    unsigned int k=1;
-    while(!(bytes[pos]&128)) {
-      res+=bytes[pos]*k;
+  void decoder::delta_n(unsigned int* out, size_t n)
+  {
+    const code_tables& t=tables();
+    const bit_source src(bytes,size);
+    uint64_t p=pos*8+bit;
+    for (size_t i=0;i<n;++i) out[i]=decode_delta(src,p,t);
+    pos=p>>3;
+    bit=p&7;
+  }
+
+  void decoder::rice_n(unsigned int* out, size_t n, unsigned int k)
+  {
+    const code_tables& t=tables();
+    const bit_source src(bytes,size);
+    uint64_t p=pos*8+bit;
+    for (size_t i=0;i<n;++i) out[i]=decode_rice(src,p,k,t);
+    pos=p>>3;
+    bit=p&7;
+  }
+
+  void decoder::prefix_code_n(unsigned int* out, size_t n)
+  {
+    if (bit) {
       ++pos;
-      k<<=7;
+      bit=0;
     }
-    res+=(bytes[pos]-128)*k;
-    ++pos;
-
-    return res;
+    uint64_t p=pos;
+    for (size_t i=0;i<n;++i) out[i]=decode_prefix_code(bytes,p);
+    pos=p;
   }
   
 
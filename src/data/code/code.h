@@ -32,17 +32,26 @@
 #ifndef INCLUDE_GUARD_PFI_DATA_CODE_CODE_H_
 #define INCLUDE_GUARD_PFI_DATA_CODE_CODE_H_
 
+#include <stdint.h>
 #include <cstdio>
 #include <vector>
+#include <string>
 #include <ostream>
 #include <istream>
+#include <fstream>
+
+#include "../../lang/noncopyable.h"
+#include "../../lang/scoped_ptr.h"
+#include "../../system/mmapper.h"
 
 namespace pfi {
 namespace data {
 namespace code {
-  class encoder {
+  class encoder : pfi::lang::noncopyable {
   public:
     encoder();
+    ~encoder();
+
     /**
      * @brief write encoded bitstream
      * @return 0 for success, -1 for error
@@ -50,8 +59,26 @@ namespace code {
     int flush(std::string fn);
     int flush(std::ostream& os);
 
+    /**
+     * @brief stream encoded bytes to a file or os while encoding
+     * bytes are written in chunks as they are completed, so only a
+     * chunk is kept in memory. call close() at the end.
+     * @return 0 for success, -1 for error
+     */
+    int open(const std::string& fn);
+    void attach(std::ostream& os);
+    int close();
+
+    /**
+     * @brief bytes not written yet
+     */
     std::vector<unsigned char>& get_bytes();
 
+    /**
+     * @brief number of bytes encoded so far, including written ones
+     */
+    uint64_t size() const;
+
     /**
      * @brief write raw bytes
      * @param v byte to write
@@ -92,21 +119,50 @@ namespace code {
     void prefix_code(unsigned int v);
 
   private:
+    void spill();
+
     unsigned int bit;
     std::vector<unsigned char> bytes;
+    std::ostream* os;
+    pfi::lang::scoped_ptr<std::ofstream> ofs;
+    uint64_t written;
   };
 
-  class decoder {
+  class decoder : pfi::lang::noncopyable {
   public:
     decoder();
     ~decoder();
 
     bool is_open();
+
+    /**
+     * @brief attach a file
+     * the file is mapped, or read into memory if it cannot be mapped.
+     */
     int attach(std::string fn);
-    int attach(std::istream& is, int size);
-    int attach(unsigned char* buf);
+    int attach(std::istream& is, uint64_t size);
+
+    /**
+     * @brief attach a mapped region, which must outlive the decoder
+     */
+    int attach(const pfi::system::mmapper::mmapper& m);
+
+    /**
+     * @brief attach size bytes of buf. word reads never go past them.
+     */
+    int attach(const unsigned char* buf, uint64_t size);
+
+    /**
+     * @brief attach buf of unknown size
+     * codes are read by 8 bytes, so 8 bytes after the last code must
+     * be readable.
+     */
+    int attach(const unsigned char* buf);
     void detach();
-    void seek(int pos, int bit=0);
+    void seek(uint64_t pos, unsigned int bit=0);
+
+    uint64_t position() const { return pos; }
+    unsigned int bit_position() const { return bit; }
 
     unsigned char byte();
     unsigned int word_with_length(unsigned int len);
@@ -114,11 +170,23 @@ namespace code {
     unsigned int delta();
     unsigned int rice(unsigned int k);
     unsigned int prefix_code();
+
+    /**
+     * @brief decode n values of the same code into out
+     * same as calling gamma() etc. n times, but the position is
+     * kept in registers during the loop.
+     */
+    void gamma_n(unsigned int* out, size_t n);
+    void delta_n(unsigned int* out, size_t n);
+    void rice_n(unsigned int* out, size_t n, unsigned int k);
+    void prefix_code_n(unsigned int* out, size_t n);
   private:
     bool newed;
-    unsigned int pos;
+    uint64_t pos;
     unsigned int bit;
-    unsigned char* bytes;
+    const unsigned char* bytes;
+    uint64_t size;
+    pfi::system::mmapper::mmapper mm;
   };
 
 } // code
@@ -33,6 +33,8 @@
 
 #include "code.h"
 
+#include "../../system/mmapper.h"
+
 #include <climits>
 #include <fstream>
 #include <algorithm>
@@ -239,3 +241,97 @@ TEST(code_test, index)
 
   unlink(tmp_file);
 }
+
+TEST(code_test, decode_n)
+{
+  srandom(time(NULL));
+  // small values hit the lookup tables, large ones the word path
+  vector<unsigned int> vs;
+  for (int i=0;i<2000;++i) {
+    int bits=random()%32+1;
+    unsigned int v=random()&((bits==32)?0xffffffffU:((1U<<bits)-1));
+    vs.push_back(v?v:1);
+  }
+  for (unsigned int i=1;i<=300;++i) vs.push_back(i);
+
+  encoder ec;
+  for (int i=0;i<(int)vs.size();++i) ec.gamma(vs[i]);
+  for (int i=0;i<(int)vs.size();++i) ec.delta(vs[i]);
+  for (int i=0;i<(int)vs.size();++i) ec.rice(vs[i]-1,5);
+  for (int i=0;i<(int)vs.size();++i) ec.prefix_code(vs[i]);
+  ec.byte(42);
+  for (int i=0;i<8;++i) ec.byte(0);
+
+  vector<unsigned int> out(vs.size());
+  decoder dc;
+  dc.attach(&ec.get_bytes()[0]);
+  dc.gamma_n(&out[0],out.size());
+  EXPECT_TRUE(vs==out);
+  dc.delta_n(&out[0],out.size());
+  EXPECT_TRUE(vs==out);
+  dc.rice_n(&out[0],out.size(),5);
+  for (int i=0;i<(int)vs.size();++i) EXPECT_EQ(vs[i]-1,out[i]);
+  dc.prefix_code_n(&out[0],out.size());
+  EXPECT_TRUE(vs==out);
+  EXPECT_EQ(42,dc.byte());
+}
+
+TEST(code_test, stream_and_mmap)
+{
+  srandom(time(NULL));
+  vector<unsigned int> vs;
+  for (int i=0;i<100000;++i) vs.push_back(random()%100000+1);
+
+  // streamed in chunks while encoding
+  {
+    encoder ec;
+    ASSERT_EQ(0,ec.open(tmp_file));
+    for (int i=0;i<(int)vs.size();++i) {
+      ec.gamma(vs[i]);
+      ec.rice(vs[i],4);
+    }
+    ec.prefix_code(12345);
+    EXPECT_GT(ec.size(),ec.get_bytes().size());
+    EXPECT_LT(ec.get_bytes().size(),size_t(1<<17));
+    ASSERT_EQ(0,ec.close());
+  }
+  {
+    decoder dc;
+    ASSERT_EQ(0,dc.attach(string(tmp_file)));
+    for (int i=0;i<(int)vs.size();++i) {
+      ASSERT_EQ(vs[i],dc.gamma());
+      ASSERT_EQ(vs[i],dc.rice(4));
+    }
+    EXPECT_EQ(12345U,dc.prefix_code());
+
+    pfi::system::mmapper::mmapper m;
+    ASSERT_EQ(0,m.open(tmp_file));
+    decoder dm;
+    ASSERT_EQ(0,dm.attach(m));
+    vector<unsigned int> out(1);
+    dm.gamma_n(&out[0],1);
+    EXPECT_EQ(vs[0],out[0]);
+    uint64_t pos=dm.position();
+    unsigned int bit=dm.bit_position();
+    EXPECT_EQ(vs[0],dm.rice(4));
+    dm.seek(pos,bit);
+    EXPECT_EQ(vs[0],dm.rice(4));
+  }
+
+  unlink(tmp_file);
+}
+
+TEST(code_test, attach_with_size)
+{
+  // codes end at the last byte of the buffer, without padding
+  encoder ec;
+  for (unsigned int i=1;i<=100;++i) ec.delta(i*1000);
+  ec.word_with_length(0x7ffff,19);
+  vector<unsigned char> bytes=ec.get_bytes();
+  bytes.shrink_to_fit();
+
+  decoder dc;
+  dc.attach(&bytes[0],bytes.size());
+  for (unsigned int i=1;i<=100;++i) EXPECT_EQ(i*1000,dc.delta());
+  EXPECT_EQ(0x7ffffU,dc.word_with_length(19));
+}
@@ -0,0 +1,269 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "lz.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <stdint.h>
+
+using namespace std;
+
+namespace pfi{
+namespace data{
+namespace compress{
+
+namespace {
+
+const int hash_log=14;
+const size_t min_match=4;
+const size_t mf_limit=12;     // a match must start this far before the end
+const size_t last_literals=5; // and the last bytes are always literals
+const size_t max_offset=65535;
+
+inline uint32_t read32(const unsigned char* p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline uint64_t read64(const unsigned char* p)
+{
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline uint32_t hash4(uint32_t v)
+{
+  return (v*2654435761U)>>(32-hash_log);
+}
+
+// length of the common prefix of p and q, not reading beyond limit
+inline size_t common_length(const unsigned char* p, const unsigned char* q,
+                            const unsigned char* limit)
+{
+  const unsigned char* start=p;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__==__ORDER_LITTLE_ENDIAN__
+  while (p+8<=limit){
+    uint64_t diff=read64(p)^read64(q);
+    if (diff)
+      return p-start+(__builtin_ctzll(diff)>>3);
+    p+=8;
+    q+=8;
+  }
+#endif
+  while (p<limit && *p==*q){
+    ++p;
+    ++q;
+  }
+  return p-start;
+}
+
+inline unsigned char* put_length(unsigned char* op, size_t len)
+{
+  while (len>=255){
+    *op++=255;
+    len-=255;
+  }
+  *op++=static_cast<unsigned char>(len);
+  return op;
+}
+
+inline unsigned char* put_literals(unsigned char* op, unsigned char* token,
+                                   const unsigned char* p, size_t len)
+{
+  if (len>=15){
+    *token=15<<4;
+    op=put_length(op, len-15);
+  } else {
+    *token=static_cast<unsigned char>(len<<4);
+  }
+  memcpy(op, p, len);
+  return op+len;
+}
+
+} // namespace
+
+size_t lz_compress_bound(size_t n)
+{
+  return n+n/255+16;
+}
+
+size_t lz_compress(const char* src, size_t n, char* dst)
+{
+  const unsigned char* const base=reinterpret_cast<const unsigned char*>(src);
+  const unsigned char* const iend=base+n;
+  const unsigned char* anchor=base;
+  unsigned char* op=reinterpret_cast<unsigned char*>(dst);
+
+  if (n>mf_limit){
+    const unsigned char* const mflimit=iend-mf_limit;
+    const unsigned char* const matchlimit=iend-last_literals;
+    vector<uint32_t> table(1<<hash_log, 0);
+    const unsigned char* ip=base+1;
+
+    for (;;){
+      // find a match, skipping faster through incompressible data
+      const unsigned char* match=NULL;
+      size_t attempts=1<<6;
+      for (;;){
+        if (ip>mflimit)
+          goto done;
+        uint32_t seq=read32(ip);
+        uint32_t h=hash4(seq);
+        match=base+table[h];
+        table[h]=static_cast<uint32_t>(ip-base);
+        if (static_cast<size_t>(ip-match)<=max_offset && match<ip && read32(match)==seq)
+          break;
+        ip+=attempts++>>6;
+      }
+
+      while (ip>anchor && match>base && ip[-1]==match[-1]){
+        --ip;
+        --match;
+      }
+
+      unsigned char* token=op++;
+      op=put_literals(op, token, anchor, ip-anchor);
+
+      size_t offset=ip-match;
+      *op++=static_cast<unsigned char>(offset);
+      *op++=static_cast<unsigned char>(offset>>8);
+
+      size_t len=common_length(ip+min_match, match+min_match, matchlimit);
+      ip+=min_match+len;
+      if (len>=15){
+        *token|=15;
+        op=put_length(op, len-15);
+      } else {
+        *token|=static_cast<unsigned char>(len);
+      }
+
+      anchor=ip;
+      if (ip>mflimit)
+        break;
+      table[hash4(read32(ip-2))]=static_cast<uint32_t>(ip-2-base);
+    }
+  }
+
+done:
+  unsigned char* token=op++;
+  op=put_literals(op, token, anchor, iend-anchor);
+  return op-reinterpret_cast<unsigned char*>(dst);
+}
+
+long lz_decompress(const char* src, size_t n, char* dst, size_t cap)
+{
+  const unsigned char* ip=reinterpret_cast<const unsigned char*>(src);
+  const unsigned char* const iend=ip+n;
+  unsigned char* const obase=reinterpret_cast<unsigned char*>(dst);
+  unsigned char* op=obase;
+  unsigned char* const oend=obase+cap;
+
+  while (ip<iend){
+    unsigned token=*ip++;
+
+    size_t lit=token>>4;
+    if (lit==15){
+      unsigned char c;
+      do {
+        if (ip>=iend) return -1;
+        c=*ip++;
+        lit+=c;
+      } while (c==255);
+    }
+    if (lit>static_cast<size_t>(iend-ip) || lit>static_cast<size_t>(oend-op))
+      return -1;
+    memcpy(op, ip, lit);
+    op+=lit;
+    ip+=lit;
+    if (ip==iend)
+      break;
+
+    if (iend-ip<2) return -1;
+    size_t offset=ip[0]|(ip[1]<<8);
+    ip+=2;
+    if (offset==0 || offset>static_cast<size_t>(op-obase))
+      return -1;
+
+    size_t len=token&15;
+    if (len==15){
+      unsigned char c;
+      do {
+        if (ip>=iend) return -1;
+        c=*ip++;
+        len+=c;
+      } while (c==255);
+    }
+    len+=min_match;
+    if (len>static_cast<size_t>(oend-op))
+      return -1;
+
+    const unsigned char* match=op-offset;
+    if (offset>=len){
+      memcpy(op, match, len);
+    } else if (offset>=8){
+      size_t i=0;
+      for (; i+8<=len; i+=8)
+        memcpy(op+i, match+i, 8);
+      for (; i<len; ++i)
+        op[i]=match[i];
+    } else {
+      for (size_t i=0; i<len; ++i)
+        op[i]=match[i];
+    }
+    op+=len;
+  }
+  return op-obase;
+}
+
+string lz_compress(const string& s)
+{
+  vector<char> buf(lz_compress_bound(s.size()));
+  size_t len=lz_compress(s.data(), s.size(), &buf[0]);
+  return string(&buf[0], len);
+}
+
+string lz_decompress(const string& s, size_t raw_size)
+{
+  string ret(raw_size, '\0');
+  long len=lz_decompress(s.data(), s.size(), raw_size ? &ret[0] : NULL, raw_size);
+  if (len<0 || static_cast<size_t>(len)!=raw_size)
+    throw runtime_error("lz_decompress: corrupt input");
+  return ret;
+}
+
+} // compress
+} // data
+} // pfi
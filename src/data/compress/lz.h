@@ -0,0 +1,66 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INCLUDE_GUARD_PFI_DATA_COMPRESS_LZ_H_
+#define INCLUDE_GUARD_PFI_DATA_COMPRESS_LZ_H_
+
+#include <cstddef>
+#include <string>
+
+namespace pfi{
+namespace data{
+namespace compress{
+
+// LZ77 block codec in the LZ4 block format.
+// no entropy stage; it trades ratio for speed.
+
+// upper bound of the compressed size of n bytes
+size_t lz_compress_bound(size_t n);
+
+// compresses [src, src+n) into dst, which must hold lz_compress_bound(n)
+// bytes, and returns the compressed size
+size_t lz_compress(const char* src, size_t n, char* dst);
+
+// decompresses [src, src+n) into dst of capacity cap.
+// returns the decompressed size, or -1 if the input is corrupt or
+// does not fit in cap
+long lz_decompress(const char* src, size_t n, char* dst, size_t cap);
+
+std::string lz_compress(const std::string& s);
+
+// raw_size is the size of the original data.
+// throws std::runtime_error on corrupt input
+std::string lz_decompress(const std::string& s, size_t raw_size);
+
+} // compress
+} // data
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_DATA_COMPRESS_LZ_H_
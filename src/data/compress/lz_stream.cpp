@@ -0,0 +1,252 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "lz_stream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
+
+#include "lz.h"
+#include "../../concurrent/parallel.h"
+#include "../../lang/bind.h"
+#include "../../system/endian_util.h"
+
+using namespace std;
+
+namespace pfi{
+namespace data{
+namespace compress{
+
+namespace {
+
+const char magic[4]={'p', 'L', 'Z', '1'};
+const uint32_t raw_flag=0x80000000U;
+const size_t max_block_size=64*1024*1024;
+
+void put32(vector<char>& out, uint32_t v)
+{
+  v=pfi::system::endian::to_little(v);
+  const char* p=reinterpret_cast<const char*>(&v);
+  out.insert(out.end(), p, p+4);
+}
+
+bool get32(istream& is, uint32_t& v)
+{
+  if (!is.read(reinterpret_cast<char*>(&v), 4))
+    return false;
+  v=pfi::system::endian::from_little(v);
+  return true;
+}
+
+// turns a raw block into its frame
+void encode_block(vector<char>* block)
+{
+  vector<char>& raw=*block;
+  vector<char> out;
+  out.reserve(8+lz_compress_bound(raw.size()));
+  put32(out, raw.size());
+  put32(out, 0);
+  out.resize(8+lz_compress_bound(raw.size()));
+  size_t len=lz_compress(&raw[0], raw.size(), &out[8]);
+  if (len>=raw.size()){
+    out.resize(8);
+    out.insert(out.end(), raw.begin(), raw.end());
+    len=raw.size()|raw_flag;
+  } else {
+    out.resize(8+len);
+  }
+  uint32_t stored=pfi::system::endian::to_little(static_cast<uint32_t>(len));
+  memcpy(&out[4], &stored, 4);
+  raw.swap(out);
+}
+
+void encode_block_at(vector<vector<char> >* blocks, int i)
+{
+  encode_block(&(*blocks)[i]);
+}
+
+} // namespace
+
+lz_ostreambuf::lz_ostreambuf(ostream& os, size_t block_size, int threads)
+  : os(os)
+  , block_size(min(max(block_size, static_cast<size_t>(1)), max_block_size))
+  , threads(max(threads, 1))
+  , cur(this->block_size)
+  , closed(false)
+{
+  os.write(magic, sizeof(magic));
+  setp(&cur[0], &cur[0]+cur.size());
+}
+
+lz_ostreambuf::~lz_ostreambuf()
+{
+  close();
+}
+
+bool lz_ostreambuf::close()
+{
+  if (closed)
+    return os.good();
+  seal();
+  bool ok=write_pending();
+  vector<char> end;
+  put32(end, 0);
+  os.write(&end[0], end.size());
+  os.flush();
+  closed=true;
+  setp(NULL, NULL);
+  return ok && os.good();
+}
+
+lz_ostreambuf::int_type lz_ostreambuf::overflow(int_type c)
+{
+  if (closed)
+    return traits_type::eof();
+  seal();
+  if (pending.size()>=static_cast<size_t>(threads) && !write_pending())
+    return traits_type::eof();
+  if (!traits_type::eq_int_type(c, traits_type::eof())){
+    *pptr()=traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+int lz_ostreambuf::sync()
+{
+  if (closed)
+    return os.good() ? 0 : -1;
+  seal();
+  if (!write_pending())
+    return -1;
+  os.flush();
+  return os.good() ? 0 : -1;
+}
+
+// moves the current block, if any, to the pending list
+void lz_ostreambuf::seal()
+{
+  size_t used=pptr()-pbase();
+  if (used>0){
+    cur.resize(used);
+    pending.push_back(vector<char>());
+    pending.back().swap(cur);
+    cur.resize(block_size);
+  }
+  setp(&cur[0], &cur[0]+cur.size());
+}
+
+bool lz_ostreambuf::write_pending()
+{
+  if (pending.empty())
+    return os.good();
+
+  // at most `threads' blocks are pending here
+  pfi::concurrent::parallel_run(pending.size(),
+                                pfi::lang::bind(&encode_block_at, &pending, pfi::lang::_1));
+
+  for (size_t i=0; i<pending.size(); ++i)
+    os.write(&pending[i][0], pending[i].size());
+  pending.clear();
+  return os.good();
+}
+
+lz_istreambuf::lz_istreambuf(istream& is)
+  : is(is)
+  , started(false)
+  , finished(false)
+  , corrupt(false)
+{
+}
+
+lz_istreambuf::int_type lz_istreambuf::underflow()
+{
+  while (gptr()==egptr()){
+    if (finished || !read_block()){
+      finished=true;
+      return traits_type::eof();
+    }
+  }
+  return traits_type::to_int_type(*gptr());
+}
+
+bool lz_istreambuf::read_block()
+{
+  if (!started){
+    char m[4];
+    if (!is.read(m, sizeof(m)) || memcmp(m, magic, sizeof(m))!=0){
+      corrupt=true;
+      return false;
+    }
+    started=true;
+  }
+
+  uint32_t raw_size=0, stored_size=0;
+  if (!get32(is, raw_size)){
+    corrupt=true;
+    return false;
+  }
+  if (raw_size==0)
+    return false;
+  if (!get32(is, stored_size) || raw_size>max_block_size){
+    corrupt=true;
+    return false;
+  }
+
+  bool is_raw=stored_size&raw_flag;
+  stored_size&=~raw_flag;
+  if (stored_size>lz_compress_bound(max_block_size) || (is_raw && stored_size!=raw_size)){
+    corrupt=true;
+    return false;
+  }
+
+  raw.resize(raw_size);
+  if (is_raw){
+    if (!is.read(&raw[0], raw_size)){
+      corrupt=true;
+      return false;
+    }
+  } else {
+    stored.resize(stored_size);
+    if (!is.read(stored.empty() ? NULL : &stored[0], stored_size)
+        || lz_decompress(stored.empty() ? NULL : &stored[0], stored_size, &raw[0], raw_size)!=static_cast<long>(raw_size)){
+      corrupt=true;
+      return false;
+    }
+  }
+  setg(&raw[0], &raw[0], &raw[0]+raw.size());
+  return true;
+}
+
+} // compress
+} // data
+} // pfi
@@ -0,0 +1,145 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INCLUDE_GUARD_PFI_DATA_COMPRESS_LZ_STREAM_H_
+#define INCLUDE_GUARD_PFI_DATA_COMPRESS_LZ_STREAM_H_
+
+#include <iostream>
+#include <streambuf>
+#include <vector>
+
+#include "../../lang/noncopyable.h"
+
+namespace pfi{
+namespace data{
+namespace compress{
+
+// framed, block compressed streams. put any archive on top of them:
+//
+//   std::ofstream ofs(fn);
+//   lz_ostream los(ofs, lz_ostream::default_block_size, 4);
+//   binary_oarchive oa(los);
+//   oa << model;
+//   los.close();
+//
+// format: "pLZ1", then blocks of
+//   uint32 raw size (little endian, not 0)
+//   uint32 stored size, with the top bit set if the block is not compressed
+//   stored bytes
+// and a uint32 0 at the end. the reader stops at the end mark, so the
+// underlying stream may carry other data after it.
+
+class lz_ostreambuf : public std::streambuf, pfi::lang::noncopyable {
+public:
+  // blocks are compressed by up to threads threads at a time
+  lz_ostreambuf(std::ostream& os, size_t block_size, int threads);
+  ~lz_ostreambuf();
+
+  // writes the remaining data and the end mark. further output fails
+  bool close();
+
+protected:
+  int_type overflow(int_type c);
+  int sync();
+
+private:
+  void seal();
+  bool write_pending();
+
+  std::ostream& os;
+  size_t block_size;
+  int threads;
+  std::vector<char> cur;
+  std::vector<std::vector<char> > pending;
+  bool closed;
+};
+
+class lz_istreambuf : public std::streambuf, pfi::lang::noncopyable {
+public:
+  explicit lz_istreambuf(std::istream& is);
+
+  // false if the input was corrupt or truncated
+  bool good() const { return !corrupt; }
+
+protected:
+  int_type underflow();
+
+private:
+  bool read_block();
+
+  std::istream& is;
+  std::vector<char> raw;
+  std::vector<char> stored;
+  bool started;
+  bool finished;
+  bool corrupt;
+};
+
+class lz_ostream : public std::ostream {
+public:
+  static const size_t default_block_size = 256 * 1024;
+
+  explicit lz_ostream(std::ostream& os,
+                      size_t block_size = default_block_size,
+                      int threads = 1)
+    : std::ostream(NULL), buf(os, block_size, threads) {
+    rdbuf(&buf);
+  }
+
+  bool close() {
+    if (!buf.close()) {
+      setstate(std::ios::badbit);
+      return false;
+    }
+    return true;
+  }
+
+private:
+  lz_ostreambuf buf;
+};
+
+class lz_istream : public std::istream {
+public:
+  explicit lz_istream(std::istream& is)
+    : std::istream(NULL), buf(is) {
+    rdbuf(&buf);
+  }
+
+  bool corrupt() const { return !buf.good(); }
+
+private:
+  lz_istreambuf buf;
+};
+
+} // compress
+} // data
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_DATA_COMPRESS_LZ_STREAM_H_
@@ -0,0 +1,189 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include "./lz.h"
+#include "./lz_stream.h"
+
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../serialization.h"
+
+using namespace std;
+using namespace pfi::data::compress;
+
+namespace {
+
+string random_bytes(size_t n, unsigned seed)
+{
+  string ret(n, '\0');
+  uint32_t x=seed*2654435761U+1;
+  for (size_t i=0; i<n; ++i){
+    x^=x<<13; x^=x>>17; x^=x<<5;
+    ret[i]=static_cast<char>(x);
+  }
+  return ret;
+}
+
+string text(size_t n)
+{
+  const char* words[]={"pfi", "common", "serialization", "archive", "block", "the", "of", " ", "\n"};
+  string ret;
+  uint32_t x=12345;
+  while (ret.size()<n){
+    x^=x<<13; x^=x>>17; x^=x<<5;
+    ret+=words[x%9];
+  }
+  ret.resize(n);
+  return ret;
+}
+
+} // namespace
+
+TEST(lz, roundtrip) {
+  vector<string> inputs;
+  inputs.push_back("");
+  inputs.push_back("a");
+  inputs.push_back("abcdabcdabcdabcd");
+  inputs.push_back(string(100000, 'x'));
+  inputs.push_back(random_bytes(100000, 1));
+  inputs.push_back(text(300000));
+  for (size_t n=0; n<64; ++n)
+    inputs.push_back(text(n));
+
+  for (size_t i=0; i<inputs.size(); ++i){
+    string c=lz_compress(inputs[i]);
+    EXPECT_LE(c.size(), lz_compress_bound(inputs[i].size()));
+    EXPECT_EQ(inputs[i], lz_decompress(c, inputs[i].size())) << i;
+  }
+
+  EXPECT_LT(lz_compress(string(100000, 'x')).size(), 1000u);
+  EXPECT_LT(lz_compress(text(300000)).size(), 300000u/2);
+}
+
+TEST(lz, corrupt) {
+  string s=text(10000);
+  string c=lz_compress(s);
+  vector<char> out(s.size());
+
+  EXPECT_THROW(lz_decompress(c, s.size()-1), runtime_error);
+  EXPECT_EQ(-1, lz_decompress(c.data(), c.size()/2, &out[0], out.size()));
+
+  // no input may make it write out of bounds
+  for (int t=0; t<200; ++t){
+    string d=c;
+    d[(t*7919)%d.size()]^=static_cast<char>(1+t%255);
+    long r=lz_decompress(d.data(), d.size(), &out[0], out.size());
+    EXPECT_LE(r, static_cast<long>(out.size()));
+  }
+}
+
+TEST(lz_stream, roundtrip) {
+  string data=text(1000000)+random_bytes(50000, 2);
+  for (int threads=1; threads<=4; threads+=3){
+    stringstream ss;
+    {
+      lz_ostream los(ss, 4096*3, threads);
+      los.write(data.data(), 1000);
+      los.flush();
+      los.write(data.data()+1000, data.size()-1000);
+      EXPECT_TRUE(los.close());
+    }
+    ss<<"trailer";
+    EXPECT_LT(ss.str().size(), data.size());
+
+    lz_istream lis(ss);
+    string got((istreambuf_iterator<char>(lis)), istreambuf_iterator<char>());
+    EXPECT_FALSE(lis.corrupt());
+    EXPECT_EQ(data, got);
+
+    string rest;
+    ss>>rest;
+    EXPECT_EQ("trailer", rest);
+  }
+
+  for (int threads=1; threads<=4; threads+=3){
+    stringstream ss;
+    {
+      lz_ostream los(ss, 4096, threads);
+    }
+    {
+      lz_ostream los(ss, 4096, threads);
+      los.flush();
+      EXPECT_TRUE(los.close());
+    }
+    for (int i=0; i<2; ++i){
+      lz_istream lis(ss);
+      string got((istreambuf_iterator<char>(lis)), istreambuf_iterator<char>());
+      EXPECT_FALSE(lis.corrupt());
+      EXPECT_EQ("", got);
+    }
+  }
+}
+
+TEST(lz_stream, archive) {
+  map<string, vector<int> > m;
+  for (int i=0; i<1000; ++i)
+    m[text(i%50)].push_back(i);
+
+  stringstream ss;
+  {
+    lz_ostream los(ss, lz_ostream::default_block_size, 2);
+    pfi::data::serialization::binary_oarchive oa(los);
+    oa<<m;
+  }
+  lz_istream lis(ss);
+  pfi::data::serialization::binary_iarchive ia(lis);
+  map<string, vector<int> > m2;
+  ia>>m2;
+  EXPECT_TRUE(ia);
+  EXPECT_EQ(m, m2);
+}
+
+TEST(lz_stream, truncated) {
+  string data=text(100000);
+  stringstream ss;
+  {
+    lz_ostream los(ss, 10000);
+    los<<data;
+  }
+  string s=ss.str();
+  stringstream half(s.substr(0, s.size()/2));
+  lz_istream lis(half);
+  string got((istreambuf_iterator<char>(lis)), istreambuf_iterator<char>());
+  EXPECT_TRUE(lis.corrupt());
+  EXPECT_LT(got.size(), data.size());
+}
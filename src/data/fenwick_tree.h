@@ -32,6 +32,7 @@
 #ifndef INCLUDE_GUARD_PFI_DATA_FENWICK_TREE_H_
 #define INCLUDE_GUARD_PFI_DATA_FENWICK_TREE_H_
 
+#include <iterator>
 #include <vector>
 
 namespace pfi{
@@ -42,11 +43,25 @@ class fenwick_tree{
 public:
   explicit fenwick_tree(int n) :v(n) {}
 
-  T query(int a){
+  // builds the tree from [first, last) in O(n)
+  template <class InputIterator>
+  fenwick_tree(InputIterator first, InputIterator last) :v(first, last) {
+    int n=v.size();
+    for (int i=0; i<n; ++i){
+      int j=i|(i+1);
+      if (j<n) v[j]+=v[i];
+    }
+  }
+
+  int size() const{
+    return v.size();
+  }
+
+  T query(int a) const{
     return a>=0?v[a]+query((a&(a+1))-1):0;
   }
 
-  T query(int a, int b){
+  T query(int a, int b) const{
     return query(b)-query(a-1);
   }
 
@@ -57,7 +72,101 @@ public:
     }
   }
 
+  // smallest k such that query(k)>=w, or size() if there is none.
+  // all elements must be non-negative.
+  int lower_bound(T w) const{
+    int n=v.size(), pos=0;
+    int step=1;
+    while (step*2<=n) step*=2;
+    for (; step>0; step>>=1){
+      if (pos+step<=n && v[pos+step-1]<w){
+        pos+=step;
+        w-=v[pos-1];
+      }
+    }
+    return pos;
+  }
+
+private:
+  std::vector<T> v;
+};
+
+// fenwick tree supporting range addition and range sum
+template <class T>
+class range_fenwick_tree{
+public:
+  explicit range_fenwick_tree(int n) :b1(n), b2(n) {}
+
+  template <class ForwardIterator>
+  range_fenwick_tree(ForwardIterator first, ForwardIterator last)
+    :b1(std::distance(first, last)), b2(first, last) {}
+
+  int size() const{
+    return b2.size();
+  }
+
+  // add n to each element of [a, b]
+  void increase(int a, int b, T n){
+    if (a>b) return;
+    b1.increase(a, n);
+    b2.increase(a, -n*a);
+    if (b+1<size()){
+      b1.increase(b+1, -n);
+      b2.increase(b+1, n*(b+1));
+    }
+  }
+
+  void increase(int k, T n){
+    increase(k, k, n);
+  }
+
+  T query(int a) const{
+    return a>=0?b1.query(a)*(a+1)+b2.query(a):0;
+  }
+
+  T query(int a, int b) const{
+    return query(b)-query(a-1);
+  }
+
+private:
+  fenwick_tree<T> b1, b2;
+};
+
+template <class T>
+class fenwick_tree_2d{
+public:
+  fenwick_tree_2d(int rows, int cols) :rows(rows), cols(cols), v(rows*cols) {}
+
+  int row_size() const{
+    return rows;
+  }
+
+  int col_size() const{
+    return cols;
+  }
+
+  // sum of [0, r] x [0, c]
+  T query(int r, int c) const{
+    T ret=T();
+    for (int i=r; i>=0; i=(i&(i+1))-1)
+      for (int j=c; j>=0; j=(j&(j+1))-1)
+        ret+=v[i*cols+j];
+    return ret;
+  }
+
+  // sum of [r1, r2] x [c1, c2]
+  T query(int r1, int c1, int r2, int c2) const{
+    return query(r2, c2)-query(r1-1, c2)-query(r2, c1-1)+query(r1-1, c1-1);
+  }
+
+  void increase(int r, int c, T n){
+    for (int i=r; i<rows; i|=i+1)
+      for (int j=c; j<cols; j|=j+1)
+        v[i*cols+j]+=n;
+  }
+
 private:
+  int rows, cols;
   std::vector<T> v;
 };
 
@@ -0,0 +1,147 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include "./fenwick_tree.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+using namespace pfi::data;
+
+TEST(fenwick_tree_test, increase_and_query) {
+  fenwick_tree<int> ft(100);
+  vector<int> v(100);
+  for (int i=0; i<1000; ++i){
+    int k=rand()%100, n=rand()%20-10;
+    ft.increase(k, n);
+    v[k]+=n;
+  }
+  int sum=0;
+  for (int i=0; i<100; ++i){
+    sum+=v[i];
+    EXPECT_EQ(sum, ft.query(i));
+  }
+  EXPECT_EQ(0, ft.query(-1));
+  EXPECT_EQ(v[10]+v[11]+v[12], ft.query(10, 12));
+}
+
+TEST(fenwick_tree_test, bulk_build) {
+  vector<long long> v;
+  for (int i=0; i<1000; ++i)
+    v.push_back(rand()%1000);
+
+  fenwick_tree<long long> bulk(v.begin(), v.end());
+  fenwick_tree<long long> inc(v.size());
+  for (size_t i=0; i<v.size(); ++i)
+    inc.increase(i, v[i]);
+
+  EXPECT_EQ(1000, bulk.size());
+  for (int i=0; i<1000; ++i)
+    EXPECT_EQ(inc.query(i), bulk.query(i));
+}
+
+TEST(fenwick_tree_test, lower_bound) {
+  int a[]={3, 0, 2, 5, 0, 1};
+  fenwick_tree<int> ft(a, a+6);
+
+  EXPECT_EQ(0, ft.lower_bound(0));
+  EXPECT_EQ(0, ft.lower_bound(1));
+  EXPECT_EQ(0, ft.lower_bound(3));
+  EXPECT_EQ(2, ft.lower_bound(4));
+  EXPECT_EQ(2, ft.lower_bound(5));
+  EXPECT_EQ(3, ft.lower_bound(6));
+  EXPECT_EQ(3, ft.lower_bound(10));
+  EXPECT_EQ(5, ft.lower_bound(11));
+  EXPECT_EQ(6, ft.lower_bound(12));
+
+  // order statistics on counts
+  fenwick_tree<int> cnt(1000);
+  vector<int> xs;
+  for (int i=0; i<500; ++i){
+    int x=rand()%1000;
+    xs.push_back(x);
+    cnt.increase(x, 1);
+  }
+  sort(xs.begin(), xs.end());
+  for (int k=0; k<500; ++k)
+    EXPECT_EQ(xs[k], cnt.lower_bound(k+1));
+}
+
+TEST(fenwick_tree_test, range_increase) {
+  vector<long long> init(200);
+  for (size_t i=0; i<init.size(); ++i)
+    init[i]=rand()%100;
+
+  range_fenwick_tree<long long> ft(init.begin(), init.end());
+  vector<long long> v(init);
+  for (int t=0; t<500; ++t){
+    int a=rand()%200, b=rand()%200;
+    if (a>b) swap(a, b);
+    long long n=rand()%21-10;
+    ft.increase(a, b, n);
+    for (int i=a; i<=b; ++i) v[i]+=n;
+  }
+  ft.increase(7, 100);
+  v[7]+=100;
+
+  for (int t=0; t<500; ++t){
+    int a=rand()%200, b=rand()%200;
+    if (a>b) swap(a, b);
+    long long sum=0;
+    for (int i=a; i<=b; ++i) sum+=v[i];
+    EXPECT_EQ(sum, ft.query(a, b));
+  }
+}
+
+TEST(fenwick_tree_test, two_dimensional) {
+  fenwick_tree_2d<int> ft(30, 20);
+  vector<vector<int> > v(30, vector<int>(20));
+  for (int t=0; t<1000; ++t){
+    int r=rand()%30, c=rand()%20, n=rand()%10;
+    ft.increase(r, c, n);
+    v[r][c]+=n;
+  }
+
+  for (int t=0; t<200; ++t){
+    int r1=rand()%30, r2=rand()%30, c1=rand()%20, c2=rand()%20;
+    if (r1>r2) swap(r1, r2);
+    if (c1>c2) swap(c1, c2);
+    int sum=0;
+    for (int i=r1; i<=r2; ++i)
+      for (int j=c1; j<=c2; ++j)
+        sum+=v[i][j];
+    EXPECT_EQ(sum, ft.query(r1, c1, r2, c2));
+  }
+}
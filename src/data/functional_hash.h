@@ -32,13 +32,365 @@
 #ifndef INCLUDE_GUARD_PFI_DATA_FUNCTIONAL_HASH_H_
 #define INCLUDE_GUARD_PFI_DATA_FUNCTIONAL_HASH_H_
 
+#include <cstddef>
+#include <cstring>
 #include <functional>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <stdint.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace pfi{
 namespace data{
 
+namespace detail{
+
+static const uint64_t hash_p0=0xa0761d6478bd642fULL;
+static const uint64_t hash_p1=0xe7037ed1a0b428dbULL;
+static const uint64_t hash_p2=0x8ebc6af09c88c6e3ULL;
+static const uint64_t hash_p3=0x589965cc75374cc3ULL;
+static const uint32_t hash_prime32=0x9e3779b1U;
+
+// lane keys for long inputs; 8 for a stripe plus one per following stripe of a block
+template <class Dummy>
+struct hash_secret{
+  static const uint64_t value[23];
+};
+
+template <class Dummy>
+const uint64_t hash_secret<Dummy>::value[23]={
+  0x2cb0f69f4abea221ULL, 0x9417034723148989ULL, 0xdd555950609dfe03ULL,
+  0xdbafb150deb12800ULL, 0x7e789b2e6c442cb6ULL, 0xf41e5636c7e4f8c4ULL,
+  0x0959d150f8fba7e4ULL, 0xa97316f13cdb9eeaULL, 0x74cd8258f9520068ULL,
+  0x55c74a62e116868bULL, 0xd2f4c799a2023cbdULL, 0xdf98cb79a37b51b9ULL,
+  0x396f5885524f3905ULL, 0xaf1d56386ca3b276ULL, 0xa9ffbe6b5104e85aULL,
+  0x6bd0c51b9fd533b3ULL, 0x980ce91c50ab4b56ULL, 0x28ac395780fe62c5ULL,
+  0x768912e3a6bcedc7ULL, 0x50b3e8c9332c7c88ULL, 0xce3bbfe520bd47daULL,
+  0xcba6c8e8e0bb7c4fULL, 0xbf194db8434a346dULL,
+};
+
+static const size_t hash_stripe_len=64;
+static const size_t hash_block_stripes=16;
+static const size_t hash_block_len=hash_stripe_len*hash_block_stripes;
+static const size_t hash_long_threshold=256;
+
+inline uint64_t hash_read64(const unsigned char* p)
+{
+  uint64_t v;
+  std::memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__==__ORDER_BIG_ENDIAN__
+  v=__builtin_bswap64(v);
+#endif
+  return v;
+}
+
+inline uint64_t hash_read32(const unsigned char* p)
+{
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__==__ORDER_BIG_ENDIAN__
+  v=__builtin_bswap32(v);
+#endif
+  return v;
+}
+
+inline void hash_mum(uint64_t& a, uint64_t& b)
+{
+#ifdef __SIZEOF_INT128__
+  __uint128_t r=static_cast<__uint128_t>(a)*b;
+  a=static_cast<uint64_t>(r);
+  b=static_cast<uint64_t>(r>>64);
+#else
+  uint64_t ha=a>>32, hb=b>>32, la=static_cast<uint32_t>(a), lb=static_cast<uint32_t>(b);
+  uint64_t rh=ha*hb, rm0=ha*lb, rm1=hb*la, rl=la*lb;
+  uint64_t t=rl+(rm0<<32), c=t<rl;
+  uint64_t lo=t+(rm1<<32);
+  c+=lo<t;
+  a=lo;
+  b=rh+(rm0>>32)+(rm1>>32)+c;
+#endif
+}
+
+inline uint64_t hash_mix(uint64_t a, uint64_t b)
+{
+  hash_mum(a, b);
+  return a^b;
+}
+
+inline uint64_t hash_avalanche(uint64_t h)
+{
+  h^=h>>37;
+  h*=0x165667919e3779f9ULL;
+  h^=h>>32;
+  return h;
+}
+
+inline void hash_accumulate_scalar(uint64_t* acc, const unsigned char* p, const uint64_t* key)
+{
+  for (int i=0; i<8; ++i){
+    uint64_t d=hash_read64(p+8*i);
+    uint64_t dk=d^key[i];
+    acc[i^1]+=d;
+    acc[i]+=(dk&0xffffffffULL)*(dk>>32);
+  }
+}
+
+inline void hash_scramble_scalar(uint64_t* acc, const uint64_t* key)
+{
+  for (int i=0; i<8; ++i){
+    uint64_t a=acc[i];
+    a^=a>>47;
+    a^=key[i];
+    acc[i]=a*hash_prime32;
+  }
+}
+
+#ifdef __SSE2__
+
+inline void hash_accumulate_sse2(uint64_t* acc, const unsigned char* p, const uint64_t* key)
+{
+  __m128i* xacc=reinterpret_cast<__m128i*>(acc);
+  for (int i=0; i<4; ++i){
+    __m128i d=_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)+i);
+    __m128i k=_mm_loadu_si128(reinterpret_cast<const __m128i*>(key)+i);
+    __m128i dk=_mm_xor_si128(d, k);
+    __m128i prod=_mm_mul_epu32(dk, _mm_shuffle_epi32(dk, _MM_SHUFFLE(0, 3, 0, 1)));
+    __m128i swapped=_mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+    __m128i a=_mm_loadu_si128(xacc+i);
+    _mm_storeu_si128(xacc+i, _mm_add_epi64(_mm_add_epi64(a, swapped), prod));
+  }
+}
+
+inline void hash_scramble_sse2(uint64_t* acc, const uint64_t* key)
+{
+  __m128i* xacc=reinterpret_cast<__m128i*>(acc);
+  const __m128i prime=_mm_set1_epi32(hash_prime32);
+  for (int i=0; i<4; ++i){
+    __m128i a=_mm_loadu_si128(xacc+i);
+    a=_mm_xor_si128(a, _mm_srli_epi64(a, 47));
+    a=_mm_xor_si128(a, _mm_loadu_si128(reinterpret_cast<const __m128i*>(key)+i));
+    __m128i lo=_mm_mul_epu32(a, prime);
+    __m128i hi=_mm_mul_epu32(_mm_srli_epi64(a, 32), prime);
+    _mm_storeu_si128(xacc+i, _mm_add_epi64(lo, _mm_slli_epi64(hi, 32)));
+  }
+}
+
+#endif
+
+inline void hash_accumulate(uint64_t* acc, const unsigned char* p, const uint64_t* key)
+{
+#ifdef __SSE2__
+  hash_accumulate_sse2(acc, p, key);
+#else
+  hash_accumulate_scalar(acc, p, key);
+#endif
+}
+
+inline void hash_scramble(uint64_t* acc, const uint64_t* key)
+{
+#ifdef __SSE2__
+  hash_scramble_sse2(acc, key);
+#else
+  hash_scramble_scalar(acc, key);
+#endif
+}
+
+// striped accumulation for keys longer than hash_long_threshold.
+// len must be at least hash_stripe_len.
+inline void hash_long(const unsigned char* p, size_t len, uint64_t seed,
+                      uint64_t* acc, uint64_t* key)
+{
+  for (int i=0; i<23; ++i)
+    key[i]=hash_secret<void>::value[i]+seed;
+
+  acc[0]=hash_prime32; acc[1]=hash_p0; acc[2]=hash_p1; acc[3]=hash_p2;
+  acc[4]=hash_p3; acc[5]=~hash_p0; acc[6]=~hash_p1; acc[7]=~hash_p2;
+
+  size_t blocks=(len-1)/hash_block_len;
+  for (size_t b=0; b<blocks; ++b){
+    const unsigned char* q=p+b*hash_block_len;
+    for (size_t s=0; s<hash_block_stripes; ++s)
+      hash_accumulate(acc, q+s*hash_stripe_len, key+s);
+    hash_scramble(acc, key+15);
+  }
+
+  const unsigned char* q=p+blocks*hash_block_len;
+  size_t stripes=((len-1)-blocks*hash_block_len)/hash_stripe_len;
+  for (size_t s=0; s<stripes; ++s)
+    hash_accumulate(acc, q+s*hash_stripe_len, key+s);
+  hash_accumulate(acc, p+len-hash_stripe_len, key+11);
+}
+
+inline uint64_t hash_merge(const uint64_t* acc, const uint64_t* key, uint64_t start)
+{
+  uint64_t r=start;
+  for (int i=0; i<4; ++i)
+    r+=hash_mix(acc[2*i]^key[2*i], acc[2*i+1]^key[2*i+1]);
+  return hash_avalanche(r);
+}
+
+// wyhash-style core for short and medium keys.
+// leaves the two lanes to be finalized in a and b.
+inline void hash_short(const unsigned char* p, size_t len, uint64_t seed,
+                       uint64_t& a, uint64_t& b)
+{
+  seed^=hash_mix(seed^hash_p0, hash_p1);
+  if (len<=16){
+    if (len>=4){
+      a=(hash_read32(p)<<32)|hash_read32(p+((len>>3)<<2));
+      b=(hash_read32(p+len-4)<<32)|hash_read32(p+len-4-((len>>3)<<2));
+    } else if (len>0){
+      a=(static_cast<uint64_t>(p[0])<<16)|(static_cast<uint64_t>(p[len>>1])<<8)|p[len-1];
+      b=0;
+    } else {
+      a=b=0;
+    }
+  } else {
+    size_t i=len;
+    if (i>48){
+      uint64_t see1=seed, see2=seed;
+      do{
+        seed=hash_mix(hash_read64(p)^hash_p1, hash_read64(p+8)^seed);
+        see1=hash_mix(hash_read64(p+16)^hash_p2, hash_read64(p+24)^see1);
+        see2=hash_mix(hash_read64(p+32)^hash_p3, hash_read64(p+40)^see2);
+        p+=48;
+        i-=48;
+      } while (i>48);
+      seed^=see1^see2;
+    }
+    while (i>16){
+      seed=hash_mix(hash_read64(p)^hash_p1, hash_read64(p+8)^seed);
+      i-=16;
+      p+=16;
+    }
+    a=hash_read64(p+i-16);
+    b=hash_read64(p+i-8);
+  }
+  a^=hash_p1;
+  b^=seed;
+  hash_mum(a, b);
+}
+
+template <class Tuple, size_t I=std::tuple_size<Tuple>::value>
+struct tuple_hash_combiner;
+
+} // detail
+
+/**
+ * @brief 64bit hash value of a byte range
+ */
+inline uint64_t hash_bytes(const void* data, size_t len, uint64_t seed=0)
+{
+  const unsigned char* p=static_cast<const unsigned char*>(data);
+  if (len>detail::hash_long_threshold){
+    uint64_t acc[8], key[23];
+    detail::hash_long(p, len, seed, acc, key);
+    return detail::hash_merge(acc, key, len*detail::hash_p0);
+  }
+  uint64_t a, b;
+  detail::hash_short(p, len, seed, a, b);
+  return detail::hash_mix(a^detail::hash_p0^len, b^detail::hash_p1);
+}
+
+/**
+ * @brief 128bit hash value of a byte range as (low, high)
+ */
+inline std::pair<uint64_t, uint64_t> hash_bytes128(const void* data, size_t len, uint64_t seed=0)
+{
+  const unsigned char* p=static_cast<const unsigned char*>(data);
+  if (len>detail::hash_long_threshold){
+    uint64_t acc[8], key[23];
+    detail::hash_long(p, len, seed, acc, key);
+    return std::make_pair(detail::hash_merge(acc, key, len*detail::hash_p0),
+                          detail::hash_merge(acc, key+12, ~(len*detail::hash_p1)));
+  }
+  uint64_t a, b;
+  detail::hash_short(p, len, seed, a, b);
+  return std::make_pair(detail::hash_mix(a^detail::hash_p0^len, b^detail::hash_p1),
+                        detail::hash_mix(a^detail::hash_p2, b^detail::hash_p3^len));
+}
+
+/**
+ * @brief default hasher of pfi::data containers
+ *
+ * falls back to std::hash. strings, pairs and tuples are specialized below.
+ */
+template <class T>
+struct hash : public std::hash<T> {
+};
+
+/**
+ * @brief mix the hash value of v into seed
+ */
 template <class T>
-using hash = std::hash<T>;
+inline void hash_combine(std::size_t& seed, const T& v)
+{
+  seed=static_cast<std::size_t>(
+    detail::hash_mix(seed^detail::hash_p0,
+                     static_cast<uint64_t>(hash<T>()(v))^detail::hash_p1));
+}
+
+template <class CharT, class Traits, class Alloc>
+struct hash<std::basic_string<CharT, Traits, Alloc> > {
+  typedef std::basic_string<CharT, Traits, Alloc> argument_type;
+  typedef std::size_t result_type;
+
+  hash() : seed(0) {}
+  explicit hash(uint64_t seed) : seed(seed) {}
+
+  std::size_t operator()(const argument_type& s) const {
+    return static_cast<std::size_t>(hash_bytes(s.data(), s.size()*sizeof(CharT), seed));
+  }
+
+private:
+  uint64_t seed;
+};
+
+template <class T1, class T2>
+struct hash<std::pair<T1, T2> > {
+  typedef std::pair<T1, T2> argument_type;
+  typedef std::size_t result_type;
+
+  std::size_t operator()(const argument_type& p) const {
+    std::size_t seed=0;
+    hash_combine(seed, p.first);
+    hash_combine(seed, p.second);
+    return seed;
+  }
+};
+
+namespace detail{
+
+template <class Tuple, size_t I>
+struct tuple_hash_combiner{
+  static void combine(std::size_t& seed, const Tuple& t){
+    tuple_hash_combiner<Tuple, I-1>::combine(seed, t);
+    hash_combine(seed, std::get<I-1>(t));
+  }
+};
+
+template <class Tuple>
+struct tuple_hash_combiner<Tuple, 0>{
+  static void combine(std::size_t&, const Tuple&){}
+};
+
+} // detail
+
+template <class... Ts>
+struct hash<std::tuple<Ts...> > {
+  typedef std::tuple<Ts...> argument_type;
+  typedef std::size_t result_type;
+
+  std::size_t operator()(const argument_type& t) const {
+    std::size_t seed=0;
+    detail::tuple_hash_combiner<argument_type>::combine(seed, t);
+    return seed;
+  }
+};
 
 } // data
 } // pfi
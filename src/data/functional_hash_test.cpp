@@ -0,0 +1,185 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include "./functional_hash.h"
+
+#include <set>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "./unordered_map.h"
+#include "./intern.h"
+#include "./string/ustring.h"
+
+using namespace std;
+using pfi::data::hash_bytes;
+using pfi::data::hash_bytes128;
+using pfi::data::hash_combine;
+using pfi::data::intern;
+namespace detail = pfi::data::detail;
+
+namespace {
+
+vector<unsigned char> make_bytes(size_t n)
+{
+  vector<unsigned char> ret(n);
+  uint64_t x=88172645463325252ULL;
+  for (size_t i=0; i<n; ++i){
+    x^=x<<13; x^=x>>7; x^=x<<17;
+    ret[i]=static_cast<unsigned char>(x);
+  }
+  return ret;
+}
+
+} // namespace
+
+TEST(functional_hash_test, deterministic) {
+  vector<unsigned char> buf=make_bytes(5000);
+  for (size_t len=0; len<buf.size(); len+=37){
+    EXPECT_EQ(hash_bytes(&buf[0], len), hash_bytes(&buf[0], len));
+    EXPECT_EQ(hash_bytes128(&buf[0], len), hash_bytes128(&buf[0], len));
+  }
+}
+
+TEST(functional_hash_test, lengths_and_seeds_differ) {
+  vector<unsigned char> buf=make_bytes(3000);
+  set<uint64_t> h64, seeded;
+  set<pair<uint64_t, uint64_t> > h128;
+  for (size_t len=0; len<=buf.size(); ++len){
+    h64.insert(hash_bytes(&buf[0], len));
+    seeded.insert(hash_bytes(&buf[0], len, 12345));
+    h128.insert(hash_bytes128(&buf[0], len));
+  }
+  EXPECT_EQ(buf.size()+1, h64.size());
+  EXPECT_EQ(buf.size()+1, seeded.size());
+  EXPECT_EQ(buf.size()+1, h128.size());
+  EXPECT_NE(hash_bytes(&buf[0], 10), hash_bytes(&buf[0], 10, 1));
+  EXPECT_NE(hash_bytes(&buf[0], 1000), hash_bytes(&buf[0], 1000, 1));
+}
+
+TEST(functional_hash_test, single_bit_flip) {
+  const size_t lens[]={1, 3, 8, 15, 16, 17, 48, 49, 100, 256, 257, 1024, 1025, 4000};
+  for (size_t i=0; i<sizeof(lens)/sizeof(lens[0]); ++i){
+    vector<unsigned char> buf=make_bytes(lens[i]);
+    uint64_t orig=hash_bytes(&buf[0], buf.size());
+    for (size_t pos=0; pos<buf.size(); pos+=(buf.size()+6)/7){
+      for (int bit=0; bit<8; ++bit){
+        buf[pos]^=1<<bit;
+        EXPECT_NE(orig, hash_bytes(&buf[0], buf.size())) << lens[i] << " " << pos << " " << bit;
+        buf[pos]^=1<<bit;
+      }
+    }
+  }
+}
+
+TEST(functional_hash_test, stripe_order_matters) {
+  vector<unsigned char> buf=make_bytes(2048);
+  uint64_t orig=hash_bytes(&buf[0], buf.size());
+  swap_ranges(buf.begin(), buf.begin()+64, buf.begin()+64);
+  EXPECT_NE(orig, hash_bytes(&buf[0], buf.size()));
+}
+
+#ifdef __SSE2__
+TEST(functional_hash_test, sse2_matches_scalar) {
+  vector<unsigned char> buf=make_bytes(64);
+  const uint64_t* key=detail::hash_secret<void>::value;
+  uint64_t a[8], b[8];
+  for (int i=0; i<8; ++i) a[i]=b[i]=key[i+3]*(i+1);
+
+  for (int r=0; r<4; ++r){
+    detail::hash_accumulate_scalar(a, &buf[0], key+r);
+    detail::hash_accumulate_sse2(b, &buf[0], key+r);
+    detail::hash_scramble_scalar(a, key+15);
+    detail::hash_scramble_sse2(b, key+15);
+    for (int i=0; i<8; ++i)
+      EXPECT_EQ(a[i], b[i]);
+  }
+}
+#endif
+
+TEST(functional_hash_test, string) {
+  pfi::data::hash<string> h;
+  string s="hello, world";
+  EXPECT_EQ(static_cast<size_t>(hash_bytes(s.data(), s.size())), h(s));
+  EXPECT_NE(h(s), pfi::data::hash<string>(1)(s));
+  EXPECT_NE(h("abc"), h("abd"));
+}
+
+TEST(functional_hash_test, ustring) {
+  using pfi::data::string::ustring;
+  using pfi::data::string::string_to_ustring;
+
+  pfi::data::hash<ustring> h;
+  ustring a=string_to_ustring("あいうえお");
+  ustring b=string_to_ustring("あいうえか");
+  EXPECT_EQ(h(a), h(string_to_ustring("あいうえお")));
+  EXPECT_NE(h(a), h(b));
+
+  pfi::data::unordered_map<ustring, int> m;
+  m[a]=1;
+  m[b]=2;
+  EXPECT_EQ(1, m[a]);
+  EXPECT_EQ(2, m[b]);
+}
+
+TEST(functional_hash_test, pair_and_tuple) {
+  pfi::data::hash<pair<int, string> > hp;
+  EXPECT_EQ(hp(make_pair(1, string("a"))), hp(make_pair(1, string("a"))));
+  EXPECT_NE(hp(make_pair(1, string("a"))), hp(make_pair(2, string("a"))));
+  pfi::data::hash<pair<int, int> > hpi;
+  EXPECT_NE(hpi(make_pair(1, 2)), hpi(make_pair(2, 1)));
+
+  pfi::data::hash<tuple<int, string, double> > ht;
+  EXPECT_EQ(ht(make_tuple(1, string("x"), 0.5)), ht(make_tuple(1, string("x"), 0.5)));
+  EXPECT_NE(ht(make_tuple(1, string("x"), 0.5)), ht(make_tuple(1, string("y"), 0.5)));
+
+  size_t seed=0;
+  hash_combine(seed, 1);
+  hash_combine(seed, string("a"));
+  EXPECT_NE(0u, seed);
+
+  pfi::data::unordered_map<pair<int, int>, int> m;
+  for (int i=0; i<100; ++i)
+    m[make_pair(i, i*i)]=i;
+  EXPECT_EQ(100u, m.size());
+  EXPECT_EQ(7, m[make_pair(7, 49)]);
+}
+
+TEST(functional_hash_test, intern_with_tuple_key) {
+  intern<tuple<int, int> > im;
+  EXPECT_EQ(0, im.key2id(make_tuple(1, 2)));
+  EXPECT_EQ(1, im.key2id(make_tuple(2, 1)));
+  EXPECT_EQ(0, im.key2id(make_tuple(1, 2)));
+}
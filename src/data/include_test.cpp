@@ -2,17 +2,25 @@
 #include "config_file.h"
 #include "string/kmp.h"
 #include "string/aho_corasick.h"
+#include "string/substring_search.h"
+#include "string/similarity_search.h"
 #include "string/algorithm.h"
 #include "string/ustring.h"
 #include "string/utility.h"
+#include "string/string_view.h"
 #include "code/code.h"
+#include "code/block_codec.h"
 #include "optional.h"
 #include "intern.h"
 #include "functional_hash.h"
 #include "encoding/base64.h"
+#include "compress/lz.h"
+#include "compress/lz_stream.h"
 #include "serialization.h"
 #include "unordered_map.h"
 #include "sparse_matrix/sparse_matrix.h"
+#include "sparse_matrix/basic_sparse_matrix.h"
+#include "sparse_matrix/csr_matrix.h"
 #include "serialization/string.h"
 #include "serialization/deque.h"
 #include "serialization/vector.h"
@@ -26,6 +34,10 @@
 #include "serialization/base.h"
 #include "serialization/pair.h"
 #include "serialization/reflect.h"
+#include "serialization/buffer.h"
+#include "serialization/array_ref.h"
+#include "serialization/compact.h"
+#include "serialization/parallel.h"
 #include "digest/md5.h"
 #include "unordered_set.h"
 #include "lru.h"
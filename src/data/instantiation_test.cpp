@@ -21,6 +21,7 @@ namespace string {
 template class kmp<std::string>;
 
 template int edit_distance<std::string>(const std::string&, const std::string&);
+template int edit_distance_within<std::string>(const std::string&, const std::string&, int);
 template int longest_common_subsequence<std::string>(const std::string&, const std::string&);
 template int longest_increasing_subsequence<std::string>(const std::string&);
 
@@ -40,6 +40,10 @@
 #include "serialization/list.h"
 #include "serialization/set.h"
 #include "serialization/map.h"
+#include "serialization/buffer.h"
+#include "serialization/array_ref.h"
+#include "serialization/compact.h"
+#include "serialization/parallel.h"
 
 #include "serialization/iostream.h"
 #endif // #ifndef INCLUDE_GUARD_PFI_DATA_SERIALIZATION_H_
@@ -41,8 +41,7 @@ namespace serialization{
 template <class Archive, class T, std::size_t N>
 void serialize(Archive &ar, T (&v)[N])
 {
-  for (size_t i=0;i<N;i++)
-    ar & v[i];
+  serialize_array(ar, v, N);
 }
 
 } // serializatin
@@ -0,0 +1,258 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INCLUDE_GUARD_PFI_DATA_SERIALIZATION_ARRAY_REF_H_
+#define INCLUDE_GUARD_PFI_DATA_SERIALIZATION_ARRAY_REF_H_
+
+#include "base.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <stdint.h>
+
+#include "../../lang/shared_ptr.h"
+#include "buffer.h"
+#include "reflect.h"
+#include "string.h"
+#include "vector.h"
+
+namespace pfi{
+namespace data{
+namespace serialization{
+
+/**
+ * @brief read-only array with the serialized format of std::vector<T>
+ *
+ * when read from a buffer_iarchive that has an owner (e.g. a shared mmapper),
+ * an array_ref points into that region and keeps it alive instead of copying.
+ * otherwise, and when the data is misaligned or needs byte swapping, the
+ * elements are copied into storage shared by the copies of the array_ref.
+ */
+template <class T>
+class array_ref{
+public:
+  typedef T value_type;
+  typedef const T* iterator;
+  typedef const T* const_iterator;
+
+  array_ref() : p(NULL), n(0), borrowed(false) {}
+
+  // refers to [p, p+n) without keeping it alive
+  array_ref(const T* p, size_t n) : p(p), n(n), borrowed(false) {}
+
+  // refers to [p, p+n) and keeps owner alive
+  array_ref(const T* p, size_t n, const pfi::lang::shared_ptr<const void>& owner)
+    : p(p), n(n), owner(owner), borrowed(true) {}
+
+  // refers to the contents of v without keeping it alive
+  explicit array_ref(const std::vector<T>& v)
+    : p(v.empty() ? NULL : &v[0]), n(v.size()), borrowed(false) {}
+
+  size_t size() const { return n; }
+  bool empty() const { return n==0; }
+  const T* data() const { return p; }
+  const T* begin() const { return p; }
+  const T* end() const { return p+n; }
+  const T& operator[](size_t i) const { return p[i]; }
+  const T& front() const { return p[0]; }
+  const T& back() const { return p[n-1]; }
+
+  std::vector<T> to_vector() const { return std::vector<T>(begin(), end()); }
+
+  // true if the elements live in a region kept alive for this array_ref,
+  // such as an mmapped file, rather than in a private copy
+  bool is_borrowed() const { return borrowed; }
+
+  void swap(array_ref& other){
+    std::swap(p, other.p);
+    std::swap(n, other.n);
+    owner.swap(other.owner);
+    std::swap(borrowed, other.borrowed);
+  }
+
+  // takes over a copy of the elements
+  void assign(std::vector<T>& v){
+    pfi::lang::shared_ptr<std::vector<T> > s(new std::vector<T>());
+    s->swap(v);
+    p=s->empty() ? NULL : &(*s)[0];
+    n=s->size();
+    owner=s;
+    borrowed=false;
+  }
+
+private:
+  const T* p;
+  size_t n;
+  pfi::lang::shared_ptr<const void> owner;
+  bool borrowed;
+};
+
+template <class T>
+bool operator==(const array_ref<T>& a, const array_ref<T>& b)
+{
+  return a.size()==b.size() && std::equal(a.begin(), a.end(), b.begin());
+}
+
+template <class T>
+bool operator!=(const array_ref<T>& a, const array_ref<T>& b)
+{
+  return !(a==b);
+}
+
+/**
+ * @brief read-only string with the serialized format of std::string
+ */
+class string_ref : public array_ref<char> {
+public:
+  string_ref() {}
+  string_ref(const char* p, size_t n) : array_ref<char>(p, n) {}
+  explicit string_ref(const std::string& s) : array_ref<char>(s.data(), s.size()) {}
+
+  std::string str() const { return std::string(begin(), end()); }
+};
+
+inline bool operator==(const string_ref& a, const std::string& b)
+{
+  return a.size()==b.size() && std::memcmp(a.data(), b.data(), a.size())==0;
+}
+
+inline bool operator==(const std::string& a, const string_ref& b)
+{
+  return b==a;
+}
+
+inline bool operator!=(const string_ref& a, const std::string& b)
+{
+  return !(a==b);
+}
+
+inline bool operator!=(const std::string& a, const string_ref& b)
+{
+  return !(b==a);
+}
+
+inline std::ostream& operator<<(std::ostream& os, const string_ref& s)
+{
+  return os.write(s.data(), s.size());
+}
+
+namespace detail{
+
+template <class Archive, class T>
+void read_array_ref(Archive& ar, array_ref<T>& r)
+{
+  uint32_t size=0;
+  ar & size;
+  std::vector<T> v(size);
+  if (size>0)
+    pfi::data::serialization::serialize_array(ar, &v[0], size);
+  r.assign(v);
+}
+
+template <class T>
+void read_array_ref(buffer_iarchive& ar, array_ref<T>& r)
+{
+  const pfi::lang::shared_ptr<const void>& owner=ar.owner();
+  if (!owner || !is_bulk_serializable<T>::value
+      || !pfi::system::endian::is_little()){
+    read_array_ref<buffer_iarchive, T>(ar, r);
+    return;
+  }
+
+  uint32_t size=0;
+  ar & size;
+  if (!ar) return;
+  const char* p=ar.data()+ar.position();
+  if (reinterpret_cast<uintptr_t>(p)%alignof(T)!=0){
+    std::vector<T> v(size);
+    if (size>0)
+      pfi::data::serialization::serialize_array(ar, &v[0], size);
+    r.assign(v);
+    return;
+  }
+  if (!ar.consume(static_cast<size_t>(size)*sizeof(T))) return;
+  array_ref<T>(reinterpret_cast<const T*>(p), size, owner).swap(r);
+}
+
+template <class Archive, class T>
+void write_array_ref(Archive& ar, const array_ref<T>& r)
+{
+  uint32_t size=static_cast<uint32_t>(r.size());
+  ar & size;
+  if (size>0)
+    pfi::data::serialization::serialize_array(ar, const_cast<T*>(r.data()), size);
+}
+
+template <class Archive, class T>
+void serialize_array_ref(Archive& ar, array_ref<T>& r, std::true_type)
+{
+  read_array_ref(ar, r);
+}
+
+template <class Archive, class T>
+void serialize_array_ref(Archive& ar, array_ref<T>& r, std::false_type)
+{
+  write_array_ref(ar, r);
+}
+
+} // detail
+
+template <class Archive, class T>
+void serialize(Archive& ar, array_ref<T>& r)
+{
+  detail::serialize_array_ref(ar, r, std::integral_constant<bool, Archive::is_read>());
+}
+
+template <class Archive>
+void serialize(Archive& ar, string_ref& s)
+{
+  detail::serialize_array_ref(ar, static_cast<array_ref<char>&>(s),
+                              std::integral_constant<bool, Archive::is_read>());
+}
+
+template <class T>
+void serialize(reflection& ref, array_ref<T>&)
+{
+  ref.add("", pfi::lang::shared_ptr<type_rep>(new array_type(get_type<T>())));
+}
+
+inline void serialize(reflection& ref, string_ref&)
+{
+  ref.add("", pfi::lang::shared_ptr<type_rep>(new string_type()));
+}
+
+} // serialization
+} // data
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_DATA_SERIALIZATION_ARRAY_REF_H_
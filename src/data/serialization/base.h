@@ -32,8 +32,11 @@
 #ifndef INCLUDE_GUARD_PFI_DATA_SERIALIZATION_BASE_H_
 #define INCLUDE_GUARD_PFI_DATA_SERIALIZATION_BASE_H_
 
+#include <algorithm>
 #include <cstdio>
 #include <iostream>
+#include <type_traits>
+#include <vector>
 
 #include "../../lang/safe_bool.h"
 #include "../../system/endian_util.h"
@@ -212,6 +215,113 @@ gen_serial_binary_oarchive(long double);
 
 #undef gen_serial_binary_oarchive
 
+// archives whose primitives are the little endian bytes of the value,
+// so that arrays of them can be moved as one block.
+template <class Archive>
+struct is_binary_archive {
+  static const bool value = false;
+};
+
+template <>
+struct is_binary_archive<binary_iarchive> {
+  static const bool value = true;
+};
+
+template <>
+struct is_binary_archive<binary_oarchive> {
+  static const bool value = true;
+};
+
+// element types serialized as their object representation on binary
+// archives. it may be specialized for trivially copyable classes whose
+// serialize() writes exactly their bytes; those take the block path on
+// little endian hosts only.
+template <class T>
+struct is_bulk_serializable {
+  static const bool value =
+    std::is_arithmetic<T>::value && !std::is_same<T, bool>::value;
+};
+
+namespace detail {
+
+// keeps each read/write call within the int size of binary archives
+static const size_t bulk_chunk_bytes = 1 << 30;
+
+template <class Archive, class T>
+void serialize_array(Archive& ar, T* p, size_t n, std::false_type)
+{
+  for (size_t i = 0; i < n; ++i)
+    ar & p[i];
+}
+
+template <class T>
+void reverse_array(T* p, size_t n)
+{
+  for (size_t i = 0; i < n; ++i)
+    p[i] = pfi::system::endian::reverse(p[i]);
+}
+
+// reading
+template <class Archive, class T>
+void transfer_array(Archive& ar, T* p, size_t n, std::true_type)
+{
+  const size_t chunk = bulk_chunk_bytes / sizeof(T);
+  for (size_t i = 0; i < n && ar; i += chunk) {
+    size_t m = std::min(chunk, n - i);
+    ar.read(reinterpret_cast<char*>(p + i), m * sizeof(T));
+  }
+  if (!pfi::system::endian::is_little())
+    reverse_array(p, n);
+}
+
+// writing
+template <class Archive, class T>
+void transfer_array(Archive& ar, const T* p, size_t n, std::false_type)
+{
+  if (pfi::system::endian::is_little()) {
+    const size_t chunk = bulk_chunk_bytes / sizeof(T);
+    for (size_t i = 0; i < n; i += chunk) {
+      size_t m = std::min(chunk, n - i);
+      ar.write(reinterpret_cast<const char*>(p + i), m * sizeof(T));
+    }
+  } else {
+    std::vector<T> tmp;
+    const size_t chunk = 4096;
+    for (size_t i = 0; i < n; i += chunk) {
+      tmp.assign(p + i, p + std::min(n, i + chunk));
+      reverse_array(&tmp[0], tmp.size());
+      ar.write(reinterpret_cast<const char*>(&tmp[0]), tmp.size() * sizeof(T));
+    }
+  }
+}
+
+template <class Archive, class T>
+void serialize_array(Archive& ar, T* p, size_t n, std::true_type)
+{
+  if (n == 0)
+    return;
+  if (!std::is_arithmetic<T>::value && !pfi::system::endian::is_little()) {
+    serialize_array(ar, p, n, std::false_type());
+    return;
+  }
+  transfer_array(ar, p, n, std::integral_constant<bool, Archive::is_read>());
+}
+
+} // detail
+
+/**
+ * @brief serialize n contiguous elements
+ *
+ * moves the whole block in one read/write when both the archive and the
+ * element type allow it, and falls back to element-wise operator& otherwise.
+ */
+template <class Archive, class T>
+void serialize_array(Archive& ar, T* p, size_t n)
+{
+  detail::serialize_array(ar, p, n, std::integral_constant<bool,
+    is_binary_archive<Archive>::value && is_bulk_serializable<T>::value>());
+}
+
 } // serialization
 } // data
 } // pfi
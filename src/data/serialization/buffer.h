@@ -0,0 +1,331 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INCLUDE_GUARD_PFI_DATA_SERIALIZATION_BUFFER_H_
+#define INCLUDE_GUARD_PFI_DATA_SERIALIZATION_BUFFER_H_
+
+#include "base.h"
+
+#include <cstring>
+#include <vector>
+
+#include "../../lang/safe_bool.h"
+#include "../../lang/shared_ptr.h"
+#include "../../system/endian_util.h"
+#include "../../system/mmapper.h"
+
+namespace pfi {
+namespace data {
+namespace serialization {
+
+// binary archives on a contiguous memory region.
+// the byte format is the same as binary_iarchive/binary_oarchive.
+// reading or writing past the region makes the archive bad and
+// leaves the destination untouched, like a stream's failbit.
+
+class buffer_iarchive : public pfi::lang::safe_bool<buffer_iarchive> {
+  buffer_iarchive(const buffer_iarchive&);
+  buffer_iarchive& operator=(const buffer_iarchive&);
+
+public:
+  buffer_iarchive(const char* p, size_t size)
+    : beg(p), cur(p), end(p + size), good(true)
+  {}
+
+  explicit buffer_iarchive(const std::vector<char>& buf)
+    : beg(buf.empty() ? NULL : &buf[0]), cur(beg), end(beg + buf.size()), good(true)
+  {}
+
+  explicit buffer_iarchive(const pfi::system::mmapper::mmapper& m)
+    : beg(m.begin()), cur(beg), end(m.end()), good(true)
+  {}
+
+  // the region is kept alive by owner, so that array_ref and string_ref
+  // can be deserialized to point into it instead of copying
+  buffer_iarchive(const char* p, size_t size,
+                  const pfi::lang::shared_ptr<const void>& owner)
+    : beg(p), cur(p), end(p + size), good(true), owner_(owner)
+  {}
+
+  explicit buffer_iarchive(const pfi::lang::shared_ptr<pfi::system::mmapper::mmapper>& m)
+    : beg(m->begin()), cur(beg), end(m->end()), good(true), owner_(m)
+  {}
+
+  static const bool is_read = true;
+
+  template <int N>
+  buffer_iarchive& read(char* p) {
+    if (static_cast<size_t>(end - cur) < static_cast<size_t>(N))
+      return fail();
+    std::memcpy(p, cur, N);
+    cur += N;
+    return *this;
+  }
+
+  buffer_iarchive& read(char* p, size_t size) {
+    if (static_cast<size_t>(end - cur) < size)
+      return fail();
+    std::memcpy(p, cur, size);
+    cur += size;
+    return *this;
+  }
+
+  // current read position from the beginning of the region
+  size_t position() const {
+    return cur - beg;
+  }
+
+  size_t size() const {
+    return end - beg;
+  }
+
+  const char* data() const {
+    return beg;
+  }
+
+  // skips size bytes and returns where they start, or NULL if the region
+  // is too short
+  const char* consume(size_t size) {
+    if (static_cast<size_t>(end - cur) < size) {
+      fail();
+      return NULL;
+    }
+    const char* ret = cur;
+    cur += size;
+    return ret;
+  }
+
+  const pfi::lang::shared_ptr<const void>& owner() const {
+    return owner_;
+  }
+
+  bool bool_test() const {
+    return good;
+  }
+
+private:
+  buffer_iarchive& fail() {
+    good = false;
+    end = cur;
+    return *this;
+  }
+
+  const char* beg;
+  const char* cur;
+  const char* end;
+  bool good;
+  pfi::lang::shared_ptr<const void> owner_;
+};
+
+template <class T>
+buffer_iarchive& operator>>(buffer_iarchive& ar, T& v)
+{
+  ar & v;
+  return ar;
+}
+
+template <class T>
+buffer_iarchive& operator>>(buffer_iarchive& ar, const T& v)
+{
+  ar & v;
+  return ar;
+}
+
+#define gen_serial_buffer_iarchive(tt) \
+  inline void serialize(buffer_iarchive& ar, tt& n) \
+  { \
+    tt tmp; \
+    ar.read<sizeof(tmp)>(reinterpret_cast<char*>(&tmp)); \
+    if (ar) n = pfi::system::endian::from_little(tmp); \
+  }
+
+gen_serial_buffer_iarchive(bool);
+gen_serial_buffer_iarchive(char);
+gen_serial_buffer_iarchive(signed char);
+gen_serial_buffer_iarchive(unsigned char);
+gen_serial_buffer_iarchive(short);
+gen_serial_buffer_iarchive(unsigned short);
+gen_serial_buffer_iarchive(int);
+gen_serial_buffer_iarchive(unsigned int);
+gen_serial_buffer_iarchive(long);
+gen_serial_buffer_iarchive(unsigned long);
+gen_serial_buffer_iarchive(long long);
+gen_serial_buffer_iarchive(unsigned long long);
+gen_serial_buffer_iarchive(float);
+gen_serial_buffer_iarchive(double);
+gen_serial_buffer_iarchive(long double);
+
+#undef gen_serial_buffer_iarchive
+
+// writes either to a growable std::vector<char>, which receives the
+// output appended to its original contents, or to a fixed region.
+// with a vector, its size is only settled by flush() or destruction.
+class buffer_oarchive : public pfi::lang::safe_bool<buffer_oarchive> {
+  buffer_oarchive(const buffer_oarchive&);
+  buffer_oarchive& operator=(const buffer_oarchive&);
+
+public:
+  explicit buffer_oarchive(std::vector<char>& buf)
+    : vec(&buf), base(buf.size()), beg(NULL), cur(NULL), end(NULL), good(true)
+  {
+    reset_pointers(buf.size());
+  }
+
+  buffer_oarchive(char* p, size_t size)
+    : vec(NULL), base(0), beg(p), cur(p), end(p + size), good(true)
+  {}
+
+  explicit buffer_oarchive(pfi::system::mmapper::mmapper& m)
+    : vec(NULL), base(0), beg(m.begin()), cur(beg), end(m.end()), good(true)
+  {}
+
+  ~buffer_oarchive() {
+    flush();
+  }
+
+  static const bool is_read = false;
+
+  template <int N>
+  buffer_oarchive& write(const char* p) {
+    if (static_cast<size_t>(end - cur) < static_cast<size_t>(N) && !reserve(N))
+      return *this;
+    std::memcpy(cur, p, N);
+    cur += N;
+    return *this;
+  }
+
+  buffer_oarchive& write(const char* p, size_t size) {
+    if (static_cast<size_t>(end - cur) < size && !reserve(size))
+      return *this;
+    std::memcpy(cur, p, size);
+    cur += size;
+    return *this;
+  }
+
+  // shrinks the vector to the bytes written so far
+  void flush() {
+    if (vec)
+      vec->resize(base + size());
+  }
+
+  // number of bytes written by this archive
+  size_t size() const {
+    return cur - beg;
+  }
+
+  bool bool_test() const {
+    return good;
+  }
+
+private:
+  bool reserve(size_t n) {
+    if (!vec) {
+      good = false;
+      end = cur;
+      return false;
+    }
+    size_t used = base + size();
+    size_t cap = vec->size();
+    while (cap - used < n)
+      cap = cap * 2 + 64;
+    vec->resize(cap);
+    reset_pointers(used);
+    return true;
+  }
+
+  void reset_pointers(size_t used) {
+    char* p = vec->empty() ? NULL : &(*vec)[0];
+    beg = p + base;
+    cur = p + used;
+    end = p + vec->size();
+  }
+
+  std::vector<char>* vec;
+  size_t base;
+  char* beg;
+  char* cur;
+  char* end;
+  bool good;
+};
+
+template <class T>
+buffer_oarchive& operator<<(buffer_oarchive& ar, T& v)
+{
+  ar & v;
+  return ar;
+}
+
+template <class T>
+buffer_oarchive& operator<<(buffer_oarchive& ar, const T& v)
+{
+  ar & v;
+  return ar;
+}
+
+#define gen_serial_buffer_oarchive(tt) \
+  inline void serialize(buffer_oarchive& ar, tt n) \
+  { \
+    n = pfi::system::endian::to_little(n); \
+    ar.write<sizeof(n)>(reinterpret_cast<const char*>(&n)); \
+  }
+
+gen_serial_buffer_oarchive(bool);
+gen_serial_buffer_oarchive(char);
+gen_serial_buffer_oarchive(signed char);
+gen_serial_buffer_oarchive(unsigned char);
+gen_serial_buffer_oarchive(short);
+gen_serial_buffer_oarchive(unsigned short);
+gen_serial_buffer_oarchive(int);
+gen_serial_buffer_oarchive(unsigned int);
+gen_serial_buffer_oarchive(long);
+gen_serial_buffer_oarchive(unsigned long);
+gen_serial_buffer_oarchive(long long);
+gen_serial_buffer_oarchive(unsigned long long);
+gen_serial_buffer_oarchive(float);
+gen_serial_buffer_oarchive(double);
+gen_serial_buffer_oarchive(long double);
+
+#undef gen_serial_buffer_oarchive
+
+template <>
+struct is_binary_archive<buffer_iarchive> {
+  static const bool value = true;
+};
+
+template <>
+struct is_binary_archive<buffer_oarchive> {
+  static const bool value = true;
+};
+
+} // serialization
+} // data
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_DATA_SERIALIZATION_BUFFER_H_
@@ -0,0 +1,313 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INCLUDE_GUARD_PFI_DATA_SERIALIZATION_COMPACT_H_
+#define INCLUDE_GUARD_PFI_DATA_SERIALIZATION_COMPACT_H_
+
+#include "base.h"
+
+#include <limits>
+#include <stdint.h>
+
+#include "../../lang/safe_bool.h"
+#include "../../system/endian_util.h"
+#include "buffer.h"
+
+namespace pfi {
+namespace data {
+namespace serialization {
+
+// compact archives store integers wider than a byte as LEB128 varints,
+// zigzag encoded when signed. container lengths are integers too, so they
+// shrink the same way. bool, char types and floating point values keep
+// their binary_oarchive encoding.
+//
+// Base is the byte level archive underneath, binary_* or buffer_*, and is
+// constructed from the arguments of the compact archive:
+//
+//   compact_oarchive oa(ofs);
+//   basic_compact_iarchive<buffer_iarchive> ia(buf);
+
+template <class Base>
+class basic_compact_iarchive : public pfi::lang::safe_bool<basic_compact_iarchive<Base> > {
+  basic_compact_iarchive(const basic_compact_iarchive&);
+  basic_compact_iarchive& operator=(const basic_compact_iarchive&);
+
+public:
+  template <class A>
+  explicit basic_compact_iarchive(A& a)
+    : base(a), good(true)
+  {}
+
+  template <class A, class B>
+  basic_compact_iarchive(A a, B b)
+    : base(a, b), good(true)
+  {}
+
+  static const bool is_read = true;
+
+  template <int N>
+  basic_compact_iarchive& read(char* p) {
+    base.template read<N>(p);
+    return *this;
+  }
+
+  basic_compact_iarchive& read(char* p, size_t size) {
+    base.read(p, size);
+    return *this;
+  }
+
+  bool read_varint(uint64_t& v) {
+    uint64_t ret = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      unsigned char c = 0;
+      base.template read<1>(reinterpret_cast<char*>(&c));
+      if (!base)
+        return false;
+      if (shift == 63 && c > 1)
+        break;
+      ret |= static_cast<uint64_t>(c & 0x7f) << shift;
+      if (!(c & 0x80)) {
+        v = ret;
+        return true;
+      }
+    }
+    good = false;
+    return false;
+  }
+
+  // marks a decoded value as out of range for its destination
+  void set_bad() {
+    good = false;
+  }
+
+  Base& get_base() {
+    return base;
+  }
+
+  bool bool_test() const {
+    return good && base;
+  }
+
+private:
+  Base base;
+  bool good;
+};
+
+template <class Base, class T>
+basic_compact_iarchive<Base>& operator>>(basic_compact_iarchive<Base>& ar, T& v)
+{
+  ar & v;
+  return ar;
+}
+
+template <class Base, class T>
+basic_compact_iarchive<Base>& operator>>(basic_compact_iarchive<Base>& ar, const T& v)
+{
+  ar & v;
+  return ar;
+}
+
+template <class Base>
+class basic_compact_oarchive : public pfi::lang::safe_bool<basic_compact_oarchive<Base> > {
+  basic_compact_oarchive(const basic_compact_oarchive&);
+  basic_compact_oarchive& operator=(const basic_compact_oarchive&);
+
+public:
+  template <class A>
+  explicit basic_compact_oarchive(A& a)
+    : base(a)
+  {}
+
+  template <class A, class B>
+  basic_compact_oarchive(A a, B b)
+    : base(a, b)
+  {}
+
+  static const bool is_read = false;
+
+  template <int N>
+  basic_compact_oarchive& write(const char* p) {
+    base.template write<N>(p);
+    return *this;
+  }
+
+  basic_compact_oarchive& write(const char* p, size_t size) {
+    base.write(p, size);
+    return *this;
+  }
+
+  void write_varint(uint64_t v) {
+    char buf[10];
+    int n = 0;
+    while (v >= 0x80) {
+      buf[n++] = static_cast<char>((v & 0x7f) | 0x80);
+      v >>= 7;
+    }
+    buf[n++] = static_cast<char>(v);
+    base.write(buf, n);
+  }
+
+  void flush() {
+    base.flush();
+  }
+
+  Base& get_base() {
+    return base;
+  }
+
+  bool bool_test() const {
+    return base;
+  }
+
+private:
+  Base base;
+};
+
+template <class Base, class T>
+basic_compact_oarchive<Base>& operator<<(basic_compact_oarchive<Base>& ar, T& v)
+{
+  ar & v;
+  return ar;
+}
+
+template <class Base, class T>
+basic_compact_oarchive<Base>& operator<<(basic_compact_oarchive<Base>& ar, const T& v)
+{
+  ar & v;
+  return ar;
+}
+
+typedef basic_compact_iarchive<binary_iarchive> compact_iarchive;
+typedef basic_compact_oarchive<binary_oarchive> compact_oarchive;
+
+#define gen_serial_compact_iarchive_raw(tt) \
+  template <class Base> \
+  inline void serialize(basic_compact_iarchive<Base>& ar, tt& n) \
+  { \
+    tt tmp; \
+    ar.template read<sizeof(tmp)>(reinterpret_cast<char*>(&tmp)); \
+    if (ar) n = pfi::system::endian::from_little(tmp); \
+  }
+
+#define gen_serial_compact_iarchive_unsigned(tt) \
+  template <class Base> \
+  inline void serialize(basic_compact_iarchive<Base>& ar, tt& n) \
+  { \
+    uint64_t v; \
+    if (!ar.read_varint(v)) return; \
+    if (v > static_cast<uint64_t>(std::numeric_limits<tt>::max())) \
+      ar.set_bad(); \
+    else \
+      n = static_cast<tt>(v); \
+  }
+
+#define gen_serial_compact_iarchive_signed(tt) \
+  template <class Base> \
+  inline void serialize(basic_compact_iarchive<Base>& ar, tt& n) \
+  { \
+    uint64_t v; \
+    if (!ar.read_varint(v)) return; \
+    int64_t s = static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); \
+    if (s < static_cast<int64_t>(std::numeric_limits<tt>::min()) || \
+        s > static_cast<int64_t>(std::numeric_limits<tt>::max())) \
+      ar.set_bad(); \
+    else \
+      n = static_cast<tt>(s); \
+  }
+
+gen_serial_compact_iarchive_raw(bool);
+gen_serial_compact_iarchive_raw(char);
+gen_serial_compact_iarchive_raw(signed char);
+gen_serial_compact_iarchive_raw(unsigned char);
+gen_serial_compact_iarchive_signed(short);
+gen_serial_compact_iarchive_unsigned(unsigned short);
+gen_serial_compact_iarchive_signed(int);
+gen_serial_compact_iarchive_unsigned(unsigned int);
+gen_serial_compact_iarchive_signed(long);
+gen_serial_compact_iarchive_unsigned(unsigned long);
+gen_serial_compact_iarchive_signed(long long);
+gen_serial_compact_iarchive_unsigned(unsigned long long);
+gen_serial_compact_iarchive_raw(float);
+gen_serial_compact_iarchive_raw(double);
+gen_serial_compact_iarchive_raw(long double);
+
+#undef gen_serial_compact_iarchive_raw
+#undef gen_serial_compact_iarchive_unsigned
+#undef gen_serial_compact_iarchive_signed
+
+#define gen_serial_compact_oarchive_raw(tt) \
+  template <class Base> \
+  inline void serialize(basic_compact_oarchive<Base>& ar, tt n) \
+  { \
+    n = pfi::system::endian::to_little(n); \
+    ar.template write<sizeof(n)>(reinterpret_cast<const char*>(&n)); \
+  }
+
+#define gen_serial_compact_oarchive_unsigned(tt) \
+  template <class Base> \
+  inline void serialize(basic_compact_oarchive<Base>& ar, tt n) \
+  { \
+    ar.write_varint(n); \
+  }
+
+#define gen_serial_compact_oarchive_signed(tt) \
+  template <class Base> \
+  inline void serialize(basic_compact_oarchive<Base>& ar, tt n) \
+  { \
+    int64_t s = n; \
+    ar.write_varint((static_cast<uint64_t>(s) << 1) ^ static_cast<uint64_t>(s >> 63)); \
+  }
+
+gen_serial_compact_oarchive_raw(bool);
+gen_serial_compact_oarchive_raw(char);
+gen_serial_compact_oarchive_raw(signed char);
+gen_serial_compact_oarchive_raw(unsigned char);
+gen_serial_compact_oarchive_signed(short);
+gen_serial_compact_oarchive_unsigned(unsigned short);
+gen_serial_compact_oarchive_signed(int);
+gen_serial_compact_oarchive_unsigned(unsigned int);
+gen_serial_compact_oarchive_signed(long);
+gen_serial_compact_oarchive_unsigned(unsigned long);
+gen_serial_compact_oarchive_signed(long long);
+gen_serial_compact_oarchive_unsigned(unsigned long long);
+gen_serial_compact_oarchive_raw(float);
+gen_serial_compact_oarchive_raw(double);
+gen_serial_compact_oarchive_raw(long double);
+
+#undef gen_serial_compact_oarchive_raw
+#undef gen_serial_compact_oarchive_unsigned
+#undef gen_serial_compact_oarchive_signed
+
+} // serialization
+} // data
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_DATA_SERIALIZATION_COMPACT_H_
@@ -37,6 +37,9 @@
 #include <iostream>
 #include <fstream>
 #include <cstdio>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
 
 #include <unistd.h>
 
@@ -90,44 +93,101 @@ private:
   std::iostream *pios;
 };
 
+namespace detail{
+
+// a stream is sent as a series of length-prefixed chunks:
+//   ff 01                  -> chunked format marker
+//   <uint32 n> <n bytes>   -> one chunk (n > 0)
+//   <uint32 0>             -> end of stream
+//
+// the marker can not appear in the former byte-escaped format
+// (00-fe as is, ff -> ff ff, EOF -> ff 00), so old streams still load.
+
+static const size_t stream_chunk_size=64*1024;
+
 template <class Archive>
-void serialize(Archive &ar, std::iostream &ios)
+void read_stream_chunks(Archive &ar, std::streambuf &sb)
 {
-  // encode:
-  // 00-fe -> sonomama
-  // ff    -> ff ff
-  // EOF   -> ff 00
-
-  if (ar.is_read){
-    std::ostreambuf_iterator<char> p(ios);
-    char c[2]={};
-    for (;;){
-      ar & c[0];
-      if (static_cast<unsigned char>(c[0])==0xff){
-        ar & c[1];
-        if (c[1]==0x00)
-          break;
-        *p=0xff;
-      }
-      else
-        *p=c[0];
+  std::vector<char> buf(stream_chunk_size);
+  for (;;){
+    uint32_t n=0;
+    ar & n;
+    if (!ar || n==0) break;
+    while(n>0){
+      size_t m=std::min<size_t>(n, buf.size());
+      serialize_array(ar, &buf[0], m);
+      if (!ar) return;
+      sb.sputn(&buf[0], m);
+      n-=m;
     }
-    ios.seekg(0);
   }
-  else{
-    std::istreambuf_iterator<char> p(ios), end;
-    char c[]={'\0', '\xff'};
-    while(p!=end){
-      c[0]=*p++;
-      if (static_cast<unsigned char>(c[0])==0xff)
-        ar & c[0] & c[1];
-      else
-        ar & c[0];
+}
+
+template <class Archive>
+void read_stream_escaped(Archive &ar, std::streambuf &sb)
+{
+  for (;;){
+    char c=0;
+    ar & c;
+    if (!ar) break;
+    if (static_cast<unsigned char>(c)==0xff){
+      ar & c;
+      if (!ar || c==0x00) break;
+    }
+    sb.sputc(c);
+  }
+}
+
+template <class Archive>
+void read_stream(Archive &ar, std::iostream &ios)
+{
+  std::streambuf &sb=*ios.rdbuf();
+  char c=0;
+  ar & c;
+  if (!ar) return;
+  if (static_cast<unsigned char>(c)==0xff){
+    ar & c;
+    if (ar && c==0x01)
+      read_stream_chunks(ar, sb);
+    else if (ar && c!=0x00){
+      sb.sputc(c);
+      read_stream_escaped(ar, sb);
     }
-    c[0]='\xff';
-    c[1]='\0';
-    ar & c[0] & c[1];
   }
+  else{
+    sb.sputc(c);
+    read_stream_escaped(ar, sb);
+  }
+  ios.seekg(0);
+}
+
+template <class Archive>
+void write_stream(Archive &ar, std::iostream &ios)
+{
+  char c[]={'\xff', '\x01'};
+  ar & c[0] & c[1];
+
+  std::vector<char> buf(stream_chunk_size);
+  std::streambuf &sb=*ios.rdbuf();
+  for (;;){
+    uint32_t n=static_cast<uint32_t>(sb.sgetn(&buf[0], buf.size()));
+    if (n==0) break;
+    ar & n;
+    serialize_array(ar, &buf[0], n);
+  }
+  uint32_t n=0;
+  ar & n;
+}
+
+} // detail
+
+template <class Archive>
+void serialize(Archive &ar, std::iostream &ios)
+{
+  if (ar.is_read)
+    detail::read_stream(ar, ios);
+  else
+    detail::write_stream(ar, ios);
 }
 
 template <class Archive, class Func>
@@ -0,0 +1,296 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INCLUDE_GUARD_PFI_DATA_SERIALIZATION_PARALLEL_H_
+#define INCLUDE_GUARD_PFI_DATA_SERIALIZATION_PARALLEL_H_
+
+#include "base.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "buffer.h"
+#include "pair.h"
+#include "../../concurrent/parallel.h"
+#include "../../lang/bind.h"
+#include "../../lang/function.h"
+
+namespace pfi{
+namespace data{
+namespace serialization{
+
+// opt-in parallel serialization of large containers
+// (map, set, unordered_map, vector, ...):
+//
+//   oa << parallel(m, 16);
+//   ia >> parallel(m, 16);
+//
+// elements are encoded in chunks by up to threads threads at a time,
+// each chunk into its own buffer in the binary format, and the chunks
+// are written one after another:
+//   uint64 number of elements
+//   chunks of
+//     uint64 number of elements in the chunk (not 0)
+//     uint64 bytes of the chunk
+//     the encoded elements
+//   uint64 0
+// the reader decodes chunks on the same number of threads. memory
+// overhead is about threads chunks in both directions.
+//
+// the format differs from plain serialization of the container, so
+// data must be read back with parallel().
+
+template <class Container>
+class parallel_container{
+public:
+  parallel_container(Container &c, int threads, size_t chunk_size)
+    : c(&c)
+    , threads(threads>0?threads:1)
+    , chunk_size(chunk_size>0?chunk_size:1)
+    , ok(true){
+  }
+
+  Container &get() const { return *c; }
+  int thread_num() const { return threads; }
+  size_t chunk() const { return chunk_size; }
+
+  // false if the last read stopped at a truncated or undecodable chunk
+  bool good() const { return ok; }
+  void set_good(bool b) const { ok=b; }
+
+private:
+  Container *c;
+  int threads;
+  size_t chunk_size;
+  mutable bool ok;
+};
+
+template <class Container>
+parallel_container<Container> parallel(Container &c, int threads,
+                                       size_t chunk_size=64*1024)
+{
+  return parallel_container<Container>(c, threads, chunk_size);
+}
+
+namespace detail{
+
+template <class T>
+struct parallel_value{
+  typedef T type;
+};
+
+template <class K, class V>
+struct parallel_value<std::pair<const K, V> >{
+  typedef std::pair<K, V> type;
+};
+
+template <class Iterator>
+void encode_chunk(Iterator b, Iterator e, std::vector<char> *out)
+{
+  typedef typename parallel_value<
+    typename std::iterator_traits<Iterator>::value_type>::type value_type;
+
+  buffer_oarchive oa(*out);
+  for (; b!=e; ++b){
+    value_type v(*b);
+    oa & v;
+  }
+  oa.flush();
+}
+
+template <class T>
+struct parallel_chunk{
+  parallel_chunk() : n(0), ok(false){}
+
+  uint64_t n;
+  std::vector<char> buf;
+  std::vector<T> vals;
+  bool ok;
+};
+
+// runs on a worker thread, so nothing may escape it
+template <class T>
+void decode_chunk(parallel_chunk<T> *ch)
+{
+  try{
+    buffer_iarchive ia(ch->buf);
+    ch->vals.resize(ch->n);
+    for (uint64_t i=0; i<ch->n && ia; i++)
+      ia & ch->vals[i];
+    ch->ok=ia && ia.position()==ch->buf.size();
+  }catch(...){
+    ch->ok=false;
+  }
+}
+
+// chunk bodies are read in steps of this size, so that a broken length
+// fails at the end of the stream instead of allocating it up front
+const uint64_t parallel_read_step=1<<20;
+
+template <class Archive>
+bool read_chunk_body(Archive &ar, uint64_t bytes, std::vector<char> &buf)
+{
+  if (bytes>buf.max_size())
+    return false;
+  for (uint64_t got=0; got<bytes; ){
+    size_t step=static_cast<size_t>(std::min(bytes-got, parallel_read_step));
+    buf.resize(got+step);
+    serialize_array(ar, &buf[got], step);
+    if (!ar)
+      return false;
+    got+=step;
+  }
+  return true;
+}
+
+template <class Archive, class Container>
+void write_parallel(Archive &ar, const parallel_container<Container> &pc)
+{
+  typedef typename Container::iterator iterator;
+
+  Container &c=pc.get();
+  uint64_t total=c.size();
+  ar & total;
+
+  iterator p=c.begin();
+  while(p!=c.end()){
+    std::vector<iterator> bounds(1, p);
+    std::vector<uint64_t> counts;
+    for (int i=0; i<pc.thread_num() && p!=c.end(); i++){
+      uint64_t n=0;
+      for (; p!=c.end() && n<pc.chunk(); ++p)
+        n++;
+      counts.push_back(n);
+      bounds.push_back(p);
+    }
+
+    std::vector<std::vector<char> > bufs(counts.size());
+    std::vector<pfi::lang::function<void()> > fs;
+    for (size_t i=0; i<counts.size(); i++)
+      fs.push_back(pfi::lang::bind(&encode_chunk<iterator>,
+                                   bounds[i], bounds[i+1], &bufs[i]));
+    pfi::concurrent::parallel_run(fs);
+
+    for (size_t i=0; i<bufs.size(); i++){
+      uint64_t bytes=bufs[i].size();
+      ar & counts[i] & bytes;
+      if (bytes>0)
+        serialize_array(ar, &bufs[i][0], bufs[i].size());
+    }
+  }
+
+  uint64_t end=0;
+  ar & end;
+}
+
+template <class Archive, class Container>
+void read_parallel(Archive &ar, const parallel_container<Container> &pc)
+{
+  typedef typename parallel_value<
+    typename Container::value_type>::type value_type;
+
+  Container &c=pc.get();
+  c.clear();
+  pc.set_good(false);
+
+  uint64_t total=0, read=0;
+  ar & total;
+  if (!ar) return;
+
+  for (bool done=false; !done; ){
+    std::vector<parallel_chunk<value_type> > chs;
+    chs.reserve(pc.thread_num());
+    uint64_t pending=0;
+    while(static_cast<int>(chs.size())<pc.thread_num()){
+      uint64_t n=0, bytes=0;
+      ar & n;
+      if (n!=0)
+        ar & bytes;
+      if (!ar)
+        return;
+      if (n==0){
+        done=true;
+        break;
+      }
+      // every element takes at least one byte, and chunks cannot hold
+      // more elements than the header announced
+      if (n>bytes || n>total-read-pending)
+        return;
+      chs.push_back(parallel_chunk<value_type>());
+      chs.back().n=n;
+      pending+=n;
+      if (!read_chunk_body(ar, bytes, chs.back().buf))
+        return;
+    }
+
+    std::vector<pfi::lang::function<void()> > fs;
+    for (size_t i=0; i<chs.size(); i++)
+      fs.push_back(pfi::lang::bind(&decode_chunk<value_type>, &chs[i]));
+    if (!fs.empty())
+      pfi::concurrent::parallel_run(fs);
+
+    for (size_t i=0; i<chs.size(); i++){
+      if (!chs[i].ok)
+        return;
+      std::vector<char>().swap(chs[i].buf);
+      for (size_t j=0; j<chs[i].vals.size(); j++)
+        c.insert(c.end(), chs[i].vals[j]);
+      std::vector<value_type>().swap(chs[i].vals);
+      read+=chs[i].n;
+    }
+  }
+
+  pc.set_good(read==total);
+}
+
+} // detail
+
+template <class Archive, class Container>
+void serialize(Archive &ar, const parallel_container<Container> &pc)
+{
+  if (ar.is_read)
+    detail::read_parallel(ar, pc);
+  else
+    detail::write_parallel(ar, pc);
+}
+
+template <class Archive, class Container>
+void serialize(Archive &ar, parallel_container<Container> &pc)
+{
+  serialize(ar, static_cast<const parallel_container<Container>&>(pc));
+}
+
+} // serialization
+} // data
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_DATA_SERIALIZATION_PARALLEL_H_
@@ -49,8 +49,8 @@ void serialize(Archive &ar, std::basic_string<CharType, Traits, Allocator> &s)
   ar & length;
 
   s.resize(length);
-  for (uint32_t i=0;i<length;i++)
-    ar & s[i];
+  if (length>0)
+    serialize_array(ar, &s[0], length);
 }
 
 class string_type : public type_rep {
@@ -35,18 +35,18 @@
 #include "base.h"
 
 #include <algorithm> // std::min
+#include <type_traits>
 #include <vector>
 
 namespace pfi{
 namespace data{
 namespace serialization{
 
+namespace detail {
+
 template <class Archive, class T, class Allocator>
-void serialize(Archive &ar, std::vector<T, Allocator> &v)
+void serialize_vector(Archive &ar, std::vector<T, Allocator> &v, uint32_t size, std::false_type)
 {
-  uint32_t size = v.size();
-  ar & size;
-
   if (ar.is_read) {
     v.reserve(size);
     v.resize(std::min<size_t>(size, v.size()));
@@ -65,6 +65,27 @@ void serialize(Archive &ar, std::vector<T, Allocator> &v)
   }
 }
 
+template <class Archive, class T, class Allocator>
+void serialize_vector(Archive &ar, std::vector<T, Allocator> &v, uint32_t size, std::true_type)
+{
+  if (ar.is_read)
+    v.resize(size);
+  if (!v.empty())
+    pfi::data::serialization::serialize_array(ar, &v[0], v.size());
+}
+
+} // detail
+
+template <class Archive, class T, class Allocator>
+void serialize(Archive &ar, std::vector<T, Allocator> &v)
+{
+  uint32_t size = v.size();
+  ar & size;
+
+  detail::serialize_vector(ar, v, size, std::integral_constant<bool,
+    is_binary_archive<Archive>::value && is_bulk_serializable<T>::value>());
+}
+
 class array_type : public type_rep {
 public:
   array_type(const pfi::lang::shared_ptr<type_rep>& type): type(type){}
@@ -44,6 +44,7 @@
 #include "./unordered_set.h"
 #include "./serialization/unordered_set.h"
 
+#include "../lang/cast.h"
 #include "../lang/shared_ptr.h"
 
 using namespace std;
@@ -426,6 +427,41 @@ TEST(serialization, stream){
   }
 }
 
+TEST(serialization, stream_large){
+  string data;
+  for (int i=0; i<200000; i++)
+    data+=static_cast<char>(i*7);
+
+  stringstream oss;
+  {
+    stringstream ss;
+    ss<<data;
+    binary_oarchive oa(oss);
+    oa<<stream<>(ss)<<123;
+  }
+  {
+    binary_iarchive ia(oss);
+    stream<path_cls> s;
+    int n=0;
+    ia>>s>>n;
+    ostringstream res;
+    res<<s.get().rdbuf();
+    EXPECT_TRUE(res.str()==data);
+    EXPECT_EQ(123, n);
+  }
+}
+
+TEST(serialization, stream_escaped){
+  // streams written in the former byte-escaped encoding
+  stringstream oss(string("a\xff\xff" "b\xff\x00", 6));
+  binary_iarchive ia(oss);
+  stream<path_cls> s;
+  ia>>s;
+  ostringstream res;
+  res<<s.get().rdbuf();
+  EXPECT_EQ(string("a\xff" "b"), res.str());
+}
+
 TEST(serialization, safe_bool) {
   {
     std::stringstream ss;
@@ -442,3 +478,509 @@ TEST(serialization, safe_bool) {
     EXPECT_FALSE(ia);
   }
 }
+
+TEST(serialization, buffer) {
+  map<string, vector<int> > m;
+  m["a"].push_back(1);
+  m["b"].push_back(INT_MIN);
+  m["b"].push_back(INT_MAX);
+  double d=3.25;
+
+  vector<char> buf(3, 'x');
+  {
+    buffer_oarchive oa(buf);
+    oa<<m<<d;
+    EXPECT_TRUE(oa);
+  }
+
+  // same bytes as binary_oarchive, appended to the original contents
+  stringstream ss;
+  {
+    binary_oarchive oa(ss);
+    oa<<m<<d;
+  }
+  EXPECT_EQ(string(3, 'x')+ss.str(), string(buf.begin(), buf.end()));
+
+  {
+    buffer_iarchive ia(&buf[3], buf.size()-3);
+    map<string, vector<int> > m2;
+    double d2=0;
+    ia>>m2>>d2;
+    EXPECT_TRUE(ia);
+    EXPECT_EQ(m, m2);
+    EXPECT_EQ(d, d2);
+    EXPECT_EQ(buf.size()-3, ia.position());
+
+    int extra=42;
+    ia>>extra;
+    EXPECT_FALSE(ia);
+    EXPECT_EQ(42, extra);
+  }
+}
+
+TEST(serialization, buffer_fixed_region) {
+  char region[10];
+  {
+    buffer_oarchive oa(region, sizeof(region));
+    oa<<static_cast<int32_t>(1)<<static_cast<int32_t>(2);
+    EXPECT_TRUE(oa);
+    EXPECT_EQ(8u, oa.size());
+    oa<<static_cast<int32_t>(3);
+    EXPECT_FALSE(oa);
+    oa<<static_cast<char>(4);
+    EXPECT_FALSE(oa);
+    EXPECT_EQ(8u, oa.size());
+  }
+  {
+    buffer_iarchive ia(region, 8);
+    int32_t a=0, b=0;
+    ia>>a>>b;
+    EXPECT_TRUE(ia);
+    EXPECT_EQ(1, a);
+    EXPECT_EQ(2, b);
+  }
+}
+
+TEST(serialization, buffer_mmap) {
+  vector<string> vs;
+  vs.push_back("hello");
+  vs.push_back("world");
+  {
+    ofstream ofs("./tmp");
+    binary_oarchive oa(ofs);
+    oa<<vs;
+  }
+  pfi::system::mmapper::mmapper m;
+  ASSERT_EQ(0, m.open("./tmp"));
+  buffer_iarchive ia(m);
+  vector<string> vs2;
+  ia>>vs2;
+  EXPECT_TRUE(ia);
+  EXPECT_EQ(vs, vs2);
+}
+
+struct bulk_pod {
+  int32_t a;
+  float b;
+
+  template <class Archive>
+  void serialize(Archive& ar) {
+    ar & a & b;
+  }
+
+  bool operator==(const bulk_pod& rhs) const {
+    return a == rhs.a && b == rhs.b;
+  }
+};
+
+namespace pfi {
+namespace data {
+namespace serialization {
+template <>
+struct is_bulk_serializable<bulk_pod> {
+  static const bool value = true;
+};
+} // serialization
+} // data
+} // pfi
+
+TEST(serialization, bulk_vector) {
+  vector<float> vf;
+  for (int i=0; i<10000; ++i)
+    vf.push_back(i*0.5f);
+  vector<int64_t> vi;
+  for (int i=0; i<1000; ++i)
+    vi.push_back(static_cast<int64_t>(i)*1000000007LL-(1LL<<40));
+  vector<bulk_pod> vp(3);
+  vp[0].a=1; vp[0].b=1.5f;
+  vp[1].a=-2; vp[1].b=2.5f;
+  vp[2].a=3; vp[2].b=-3.5f;
+
+  stringstream ss;
+  {
+    binary_oarchive oa(ss);
+    oa<<vf<<vi<<vp;
+  }
+
+  // element-wise encoding gives the same bytes
+  stringstream ref;
+  {
+    binary_oarchive oa(ref);
+    oa<<static_cast<uint32_t>(vf.size());
+    for (size_t i=0; i<vf.size(); ++i) oa<<vf[i];
+    oa<<static_cast<uint32_t>(vi.size());
+    for (size_t i=0; i<vi.size(); ++i) oa<<vi[i];
+    oa<<static_cast<uint32_t>(vp.size());
+    for (size_t i=0; i<vp.size(); ++i) oa<<vp[i].a<<vp[i].b;
+  }
+  EXPECT_EQ(ref.str(), ss.str());
+
+  {
+    binary_iarchive ia(ss);
+    vector<float> vf2(3, 1.0f);
+    vector<int64_t> vi2;
+    vector<bulk_pod> vp2;
+    ia>>vf2>>vi2>>vp2;
+    EXPECT_TRUE(ia);
+    EXPECT_EQ(vf, vf2);
+    EXPECT_EQ(vi, vi2);
+    EXPECT_TRUE(vp==vp2);
+  }
+  {
+    string s=ss.str();
+    buffer_iarchive ia(s.data(), s.size());
+    vector<float> vf2;
+    ia>>vf2;
+    EXPECT_TRUE(ia);
+    EXPECT_EQ(vf, vf2);
+  }
+}
+
+TEST(serialization, bulk_vector_truncated) {
+  vector<double> v(100, 1.0);
+  stringstream ss;
+  {
+    binary_oarchive oa(ss);
+    oa<<v;
+  }
+  string s=ss.str();
+  buffer_iarchive ia(s.data(), s.size()-1);
+  vector<double> v2;
+  ia>>v2;
+  EXPECT_FALSE(ia);
+}
+
+TEST(serialization, bulk_array) {
+  double a[5]={0.1, 0.2, 0.3, 0.4, 0.5};
+  int16_t b[2][3]={{1, 2, 3}, {-4, -5, -6}};
+  vector<char> buf;
+  {
+    buffer_oarchive oa(buf);
+    oa<<a<<b;
+  }
+  EXPECT_EQ(sizeof(a)+sizeof(b), buf.size());
+
+  double a2[5]={};
+  int16_t b2[2][3]={};
+  buffer_iarchive ia(buf);
+  ia>>a2>>b2;
+  EXPECT_TRUE(ia);
+  for (int i=0; i<5; ++i)
+    EXPECT_EQ(a[i], a2[i]);
+  for (int i=0; i<2; ++i)
+    for (int j=0; j<3; ++j)
+      EXPECT_EQ(b[i][j], b2[i][j]);
+}
+
+struct mapped_model {
+  string_ref name;
+  array_ref<float> weights;
+  array_ref<int32_t> ids;
+
+  template <class Archive>
+  void serialize(Archive& ar) {
+    ar & name & weights & ids;
+  }
+};
+
+TEST(serialization, array_ref_mmap) {
+  string name="model-v1";
+  vector<float> weights;
+  for (int i=0; i<1000; ++i)
+    weights.push_back(i*0.25f);
+  vector<int32_t> ids(3, 7);
+  {
+    ofstream ofs("./tmp");
+    binary_oarchive oa(ofs);
+    oa<<name<<weights<<ids;
+  }
+
+  mapped_model m;
+  {
+    pfi::lang::shared_ptr<pfi::system::mmapper::mmapper> mm(new pfi::system::mmapper::mmapper());
+    ASSERT_EQ(0, mm->open("./tmp"));
+    buffer_iarchive ia(mm);
+    ia>>m;
+    EXPECT_TRUE(ia);
+
+    EXPECT_TRUE(m.name.is_borrowed());
+    EXPECT_EQ(mm->begin()+4, m.name.data());
+    // the floats start at offset 4+8+4
+    EXPECT_TRUE(m.weights.is_borrowed());
+    EXPECT_EQ(reinterpret_cast<const float*>(mm->begin()+16), m.weights.data());
+  }
+  // the mapping outlives the archive and its shared_ptr
+  EXPECT_EQ(name, m.name);
+  EXPECT_EQ(weights, m.weights.to_vector());
+  EXPECT_EQ(ids, m.ids.to_vector());
+
+  // writing a loaded model gives back the original bytes
+  stringstream ss;
+  {
+    binary_oarchive oa(ss);
+    oa<<m;
+  }
+  ifstream ifs("./tmp");
+  stringstream orig;
+  orig<<ifs.rdbuf();
+  EXPECT_EQ(orig.str(), ss.str());
+}
+
+TEST(serialization, array_ref_alignment) {
+  vector<double> v(10, 1.5);
+  vector<char> buf;
+  {
+    buffer_oarchive oa(buf);
+    oa<<static_cast<uint32_t>(0)<<v<<static_cast<char>(0)<<v;
+  }
+  pfi::lang::shared_ptr<vector<char> > owner(new vector<char>(buf));
+  // first vector data is at offset 8, second at 8+80+1+4
+  buffer_iarchive ia(&(*owner)[0], owner->size(), owner);
+  uint32_t pad=1;
+  char c=1;
+  array_ref<double> a, b;
+  ia>>pad>>a>>c>>b;
+  EXPECT_TRUE(ia);
+  EXPECT_EQ(v, a.to_vector());
+  EXPECT_EQ(v, b.to_vector());
+  EXPECT_TRUE(a.is_borrowed());
+  EXPECT_EQ(reinterpret_cast<const double*>(&(*owner)[8]), a.data());
+  EXPECT_FALSE(b.is_borrowed());
+}
+
+TEST(serialization, array_ref_copy) {
+  vector<int> v(5, 3);
+  stringstream ss;
+  {
+    binary_oarchive oa(ss);
+    string abc="abc";
+    oa<<v<<abc;
+  }
+  binary_iarchive ia(ss);
+  array_ref<int> a;
+  string_ref s;
+  ia>>a>>s;
+  EXPECT_TRUE(ia);
+  EXPECT_FALSE(a.is_borrowed());
+  EXPECT_EQ(v, a.to_vector());
+  EXPECT_EQ("abc", s.str());
+
+  pfi::lang::shared_ptr<type_rep> t=get_type<array_ref<int32_t> >();
+  ostringstream oss;
+  t->print(oss);
+  EXPECT_EQ("array<int(4)>", oss.str());
+}
+
+struct compact_record {
+  int64_t id;
+  uint64_t count;
+  vector<int32_t> deltas;
+  map<string, int16_t> tags;
+  double score;
+
+  template <class Archive>
+  void serialize(Archive& ar) {
+    ar & id & count & deltas & tags & score;
+  }
+
+  bool operator==(const compact_record& rhs) const {
+    return id == rhs.id && count == rhs.count && deltas == rhs.deltas
+      && tags == rhs.tags && score == rhs.score;
+  }
+};
+
+template <class OArchive, class IArchive>
+compact_record compact_roundtrip(compact_record r, size_t& bytes)
+{
+  stringstream ss;
+  {
+    OArchive oa(ss);
+    oa<<r;
+  }
+  bytes=ss.str().size();
+  IArchive ia(ss);
+  compact_record ret;
+  ia>>ret;
+  EXPECT_TRUE(ia);
+  return ret;
+}
+
+TEST(serialization, compact) {
+  compact_record r;
+  r.id=-3;
+  r.count=100;
+  for (int i=-50; i<50; ++i)
+    r.deltas.push_back(i);
+  r.deltas.push_back(INT_MIN);
+  r.deltas.push_back(INT_MAX);
+  r.tags["a"]=-1;
+  r.tags["b"]=SHRT_MAX;
+  r.score=0.5;
+
+  size_t binary_bytes=0, compact_bytes=0;
+  EXPECT_TRUE(r==(compact_roundtrip<binary_oarchive, binary_iarchive>(r, binary_bytes)));
+  EXPECT_TRUE(r==(compact_roundtrip<compact_oarchive, compact_iarchive>(r, compact_bytes)));
+  EXPECT_LT(compact_bytes*2, binary_bytes);
+
+  vector<char> buf;
+  {
+    basic_compact_oarchive<buffer_oarchive> oa(buf);
+    oa<<r;
+  }
+  EXPECT_EQ(compact_bytes, buf.size());
+  basic_compact_iarchive<buffer_iarchive> ia(&buf[0], buf.size());
+  compact_record r2;
+  ia>>r2;
+  EXPECT_TRUE(ia);
+  EXPECT_TRUE(r==r2);
+}
+
+TEST(serialization, compact_varint_layout) {
+  stringstream ss;
+  {
+    compact_oarchive oa(ss);
+    oa<<0u<<127u<<128u<<-1<<1<<ULLONG_MAX<<LLONG_MIN;
+  }
+  string s=ss.str();
+  const char expected[]="\x00\x7f\x80\x01\x01\x02";
+  EXPECT_EQ(string(expected, 6), s.substr(0, 6));
+  EXPECT_EQ(6u+10u+10u, s.size());
+
+  unsigned int a=1, b=0, c=0;
+  int d=0, e=0;
+  unsigned long long f=0;
+  long long g=0;
+  stringstream ss2(s);
+  compact_iarchive ia2(ss2);
+  ia2>>a>>b>>c>>d>>e>>f>>g;
+  EXPECT_TRUE(ia2);
+  EXPECT_EQ(0u, a);
+  EXPECT_EQ(127u, b);
+  EXPECT_EQ(128u, c);
+  EXPECT_EQ(-1, d);
+  EXPECT_EQ(1, e);
+  EXPECT_EQ(ULLONG_MAX, f);
+  EXPECT_EQ(LLONG_MIN, g);
+}
+
+TEST(serialization, compact_out_of_range) {
+  stringstream ss;
+  {
+    compact_oarchive oa(ss);
+    oa<<static_cast<uint64_t>(USHRT_MAX)<<(static_cast<uint64_t>(1)<<20);
+  }
+  compact_iarchive ia(ss);
+  uint16_t a=0, b=7;
+  ia>>a;
+  EXPECT_TRUE(ia);
+  EXPECT_EQ(USHRT_MAX, a);
+  ia>>b;
+  EXPECT_FALSE(ia);
+  EXPECT_EQ(7, b);
+
+  stringstream big;
+  {
+    compact_oarchive oa(big);
+    oa<<static_cast<int64_t>(1)<<(static_cast<int64_t>(1)<<40);
+  }
+  compact_iarchive ib(big);
+  int32_t x=0, y=5;
+  ib>>x>>y;
+  EXPECT_FALSE(ib);
+  EXPECT_EQ(1, x);
+  EXPECT_EQ(5, y);
+}
+
+TEST(serialization, parallel_map) {
+  map<int, string> m;
+  for (int i = 0; i < 10000; ++i)
+    m[i * 3] = pfi::lang::lexical_cast<string>(i);
+
+  stringstream ss;
+  {
+    binary_oarchive oa(ss);
+    oa << parallel(m, 4, 100) << 42;
+  }
+  map<int, string> r;
+  int n = 0;
+  {
+    binary_iarchive ia(ss);
+    parallel_container<map<int, string> > pr = parallel(r, 3, 1);
+    ia >> pr >> n;
+    EXPECT_TRUE(ia);
+    EXPECT_TRUE(pr.good());
+  }
+  EXPECT_TRUE(m == r);
+  EXPECT_EQ(42, n);
+}
+
+TEST(serialization, parallel_unordered_map) {
+  pfi::data::unordered_map<string, vector<int> > m;
+  for (int i = 0; i < 1000; ++i)
+    m[pfi::lang::lexical_cast<string>(i)] = vector<int>(i % 7, i);
+
+  vector<char> buf;
+  {
+    buffer_oarchive oa(buf);
+    oa << parallel(m, 8, 10);
+  }
+  pfi::data::unordered_map<string, vector<int> > r;
+  r["stale"] = vector<int>();
+  {
+    buffer_iarchive ia(buf);
+    ia >> parallel(r, 2);
+    EXPECT_TRUE(ia);
+  }
+  EXPECT_TRUE(m == r);
+}
+
+TEST(serialization, parallel_truncated) {
+  vector<int> v;
+  for (int i = 0; i < 1000; ++i)
+    v.push_back(i);
+
+  vector<char> buf;
+  {
+    buffer_oarchive oa(buf);
+    oa << parallel(v, 4, 100);
+  }
+  buf.resize(buf.size() / 2);
+
+  vector<int> r;
+  buffer_iarchive ia(buf);
+  parallel_container<vector<int> > pr = parallel(r, 4);
+  ia >> pr;
+  EXPECT_FALSE(pr.good());
+  EXPECT_GT(v.size(), r.size());
+}
+
+TEST(serialization, parallel_corrupt_header) {
+  vector<int> v;
+  for (int i = 0; i < 1000; ++i)
+    v.push_back(i);
+
+  vector<char> buf;
+  {
+    buffer_oarchive oa(buf);
+    oa << parallel(v, 4, 100);
+  }
+
+  vector<char> huge;
+  {
+    buffer_oarchive oa(huge);
+    oa << (static_cast<uint64_t>(1) << 62);
+  }
+  ASSERT_EQ(sizeof(uint64_t), huge.size());
+
+  // layout: total, then count and bytes of the first chunk
+  for (size_t off = 0; off <= 2 * sizeof(uint64_t); off += sizeof(uint64_t)) {
+    vector<char> broken = buf;
+    copy(huge.begin(), huge.end(), broken.begin() + off);
+
+    vector<int> r;
+    buffer_iarchive ia(broken);
+    parallel_container<vector<int> > pr = parallel(r, 4);
+    ia >> pr;
+    EXPECT_FALSE(pr.good());
+  }
+}
@@ -0,0 +1,221 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "basic_sparse_matrix.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace pfi {
+namespace data {
+namespace sparse_matrix {
+namespace detail {
+
+  namespace {
+    const char matrix_magic[4]={'p','S','M','2'};
+    const char offsets_magic[4]={'p','S','O','2'};
+    const size_t matrix_header_size=16;
+    const size_t offsets_header_size=16;
+  }
+
+  ////////////////////////////////////////////////////////////////
+  //
+  // matrix_file_writer
+  //
+
+  matrix_file_writer::matrix_file_writer()
+  {
+  }
+
+  matrix_file_writer::~matrix_file_writer()
+  {
+    close();
+  }
+
+  int matrix_file_writer::open(const string& fnMat, uint32_t codec_id, const float params[2])
+  {
+    close();
+
+    ofs.open(fnMat.c_str(),ios::binary);
+    if (!ofs) {
+      fprintf(stderr,"matrix_file_writer::open: cannot open %s\n",fnMat.c_str());
+      return -1;
+    }
+    ofs.write(matrix_magic,sizeof(matrix_magic));
+    ofs.write((const char*)&codec_id,sizeof(codec_id));
+    ofs.write((const char*)params,2*sizeof(float));
+
+    fn=fnMat;
+    offsets.assign(1,matrix_header_size);
+    nums.clear();
+    return 0;
+  }
+
+  int matrix_file_writer::close()
+  {
+    if (!ofs.is_open()) return 0;
+
+    ofs.close();
+    bool ok=!ofs.fail();
+
+    ofstream ofo((fn+".offset").c_str(),ios::binary);
+    if (!ofo) {
+      fprintf(stderr,"matrix_file_writer::close: cannot open %s.offset\n",fn.c_str());
+      ok=false;
+    } else {
+      uint32_t zero=0;
+      uint64_t rows=nums.size();
+      ofo.write(offsets_magic,sizeof(offsets_magic));
+      ofo.write((const char*)&zero,sizeof(zero));
+      ofo.write((const char*)&rows,sizeof(rows));
+      ofo.write((const char*)&offsets[0],offsets.size()*sizeof(uint64_t));
+      if (rows>0) ofo.write((const char*)&nums[0],rows*sizeof(uint32_t));
+      ofo.close();
+      ok=ok&&!ofo.fail();
+    }
+
+    fn="";
+    vector<uint64_t>().swap(offsets);
+    vector<uint32_t>().swap(nums);
+    return ok?0:-1;
+  }
+
+  void matrix_file_writer::append_row(const vector<unsigned char>& bytes, uint32_t num)
+  {
+    if (!bytes.empty()) ofs.write((const char*)&bytes[0],bytes.size());
+    offsets.push_back(offsets.back()+bytes.size());
+    nums.push_back(num);
+  }
+
+  ////////////////////////////////////////////////////////////////
+  //
+  // mapped_matrix
+  //
+
+  mapped_matrix::mapped_matrix()
+    :rows(0),nnz(0),offsets(NULL),nums(NULL)
+  {
+  }
+
+  int mapped_matrix::open(const string& fnMat, uint32_t codec_id, float params[2])
+  {
+    close();
+
+    if (mat.open(fnMat)<0) {
+      fprintf(stderr,"mapped_matrix::open: cannot map %s\n",fnMat.c_str());
+      return -1;
+    }
+    if (off.open(fnMat+".offset")<0) {
+      fprintf(stderr,"mapped_matrix::open: cannot map %s.offset\n",fnMat.c_str());
+      close();
+      return -1;
+    }
+
+    uint32_t id=0;
+    if (mat.size()<matrix_header_size||
+        memcmp(mat.begin(),matrix_magic,sizeof(matrix_magic))!=0) {
+      fprintf(stderr,"mapped_matrix::open: %s is not a version 2 matrix\n",fnMat.c_str());
+      close();
+      return -1;
+    }
+    memcpy(&id,mat.begin()+4,sizeof(id));
+    if (id!=codec_id) {
+      fprintf(stderr,"mapped_matrix::open: %s has codec %u, but %u is requested\n",
+              fnMat.c_str(),id,codec_id);
+      close();
+      return -1;
+    }
+    memcpy(params,mat.begin()+8,2*sizeof(float));
+
+    uint64_t n=0;
+    if (off.size()>=offsets_header_size)
+      memcpy(&n,off.begin()+8,sizeof(n));
+    if (off.size()<offsets_header_size||
+        memcmp(off.begin(),offsets_magic,sizeof(offsets_magic))!=0||
+        off.size()!=offsets_header_size+(n+1)*sizeof(uint64_t)+n*sizeof(uint32_t)) {
+      fprintf(stderr,"mapped_matrix::open: broken offsets %s.offset\n",fnMat.c_str());
+      close();
+      return -1;
+    }
+
+    rows=n;
+    offsets=reinterpret_cast<const uint64_t*>(off.begin()+offsets_header_size);
+    nums=reinterpret_cast<const uint32_t*>(offsets+rows+1);
+    if (offsets[rows]>mat.size()) {
+      fprintf(stderr,"mapped_matrix::open: %s is truncated\n",fnMat.c_str());
+      close();
+      return -1;
+    }
+    nnz=0;
+    for (uint64_t i=0;i<rows;++i) nnz+=nums[i];
+    return 0;
+  }
+
+  void mapped_matrix::prefetch(const vector<uint64_t>& rs) const
+  {
+    const uintptr_t page=sysconf(_SC_PAGESIZE);
+    const uintptr_t base=reinterpret_cast<uintptr_t>(mat.begin());
+
+    // merge ranges on the same or adjacent pages into one call
+    uintptr_t st=0,en=0;
+    for (size_t i=0;i<rs.size();++i) {
+      if (rs[i]>=rows||offsets[rs[i]]==offsets[rs[i]+1]) continue;
+      uintptr_t s=(base+offsets[rs[i]])&~(page-1);
+      uintptr_t e=base+offsets[rs[i]+1];
+      if (en>0&&s<=en) {
+        en=max(en,e);
+        continue;
+      }
+      if (en>0) madvise(reinterpret_cast<void*>(st),en-st,MADV_WILLNEED);
+      st=s;
+      en=e;
+    }
+    if (en>0) madvise(reinterpret_cast<void*>(st),en-st,MADV_WILLNEED);
+  }
+
+  void mapped_matrix::close()
+  {
+    mat.close();
+    off.close();
+    rows=nnz=0;
+    offsets=NULL;
+    nums=NULL;
+  }
+
+} // detail
+} // sparse_matrix
+} // data
+} // pfi
@@ -0,0 +1,376 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INCLUDE_GUARD_PFI_DATA_SPARSE_MATRIX_BASIC_SPARSE_MATRIX_H_
+#define INCLUDE_GUARD_PFI_DATA_SPARSE_MATRIX_BASIC_SPARSE_MATRIX_H_
+
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../code/code.h"
+#include "../unordered_map.h"
+#include "../../lang/noncopyable.h"
+#include "../../system/mmapper.h"
+
+namespace pfi {
+namespace data {
+namespace sparse_matrix {
+
+  /*
+   * sparse matrix format version 2.
+   *
+   * like sparse_matrix_writer/reader, rows are compressed one by one,
+   * but offsets are 64 bit and values are encoded by a codec:
+   *
+   *   fn:        "pSM2", uint32 codec id, float codec params[2],
+   *              then rows of (prefix_code(column delta), value)
+   *   fn.offset: "pSO2", uint32 0, uint64 row num n,
+   *              uint64 offsets[n+1] (from the beginning of fn),
+   *              uint32 number of elements[n]
+   *
+   * the reader maps both files and decodes rows directly from the
+   * mapping, so opening a matrix does not read the rows. reading
+   * rows does not change the reader, and one reader may be shared
+   * by threads.
+   */
+
+  /**
+   * @brief value codecs
+   *
+   * a codec encodes one value after each column. codecs with
+   * parameters keep them in the matrix header.
+   */
+  struct value_codec_base {
+    void get_params(float p[2]) const { p[0]=p[1]=0; }
+    void set_params(const float /*p*/[2]) {}
+  };
+
+  struct uint8_codec : value_codec_base {
+    typedef unsigned char value_type;
+    static const uint32_t id=1;
+
+    void encode(code::encoder& ec, value_type v) const { ec.byte(v); }
+    value_type decode(code::decoder& dc) const { return dc.byte(); }
+  };
+
+  struct uint16_codec : value_codec_base {
+    typedef uint16_t value_type;
+    static const uint32_t id=2;
+
+    void encode(code::encoder& ec, value_type v) const { ec.prefix_code(v); }
+    value_type decode(code::decoder& dc) const { return dc.prefix_code(); }
+  };
+
+  struct uint32_codec : value_codec_base {
+    typedef uint32_t value_type;
+    static const uint32_t id=3;
+
+    void encode(code::encoder& ec, value_type v) const { ec.prefix_code(v); }
+    value_type decode(code::decoder& dc) const { return dc.prefix_code(); }
+  };
+
+  struct float_codec : value_codec_base {
+    typedef float value_type;
+    static const uint32_t id=4;
+
+    void encode(code::encoder& ec, value_type v) const {
+      uint32_t u;
+      std::memcpy(&u,&v,sizeof(u));
+      for (int i=0;i<4;++i) ec.byte((u>>(i*8))&0xff);
+    }
+    value_type decode(code::decoder& dc) const {
+      uint32_t u=0;
+      for (int i=0;i<4;++i) u|=static_cast<uint32_t>(dc.byte())<<(i*8);
+      value_type v;
+      std::memcpy(&v,&u,sizeof(v));
+      return v;
+    }
+  };
+
+  /**
+   * @brief float quantized to 256 levels in [lo, hi]
+   * values out of the range are clamped.
+   */
+  class quantized_float_codec {
+  public:
+    typedef float value_type;
+    static const uint32_t id=5;
+
+    explicit quantized_float_codec(float lo=0, float hi=1)
+      :lo(lo),hi(hi) {}
+
+    void encode(code::encoder& ec, value_type v) const {
+      float r=hi>lo?(v-lo)/(hi-lo):0;
+      r=r<0?0:r>1?1:r;
+      ec.byte(static_cast<unsigned char>(std::floor(r*255+0.5f)));
+    }
+    value_type decode(code::decoder& dc) const {
+      return lo+(hi-lo)*dc.byte()/255;
+    }
+
+    void get_params(float p[2]) const { p[0]=lo; p[1]=hi; }
+    void set_params(const float p[2]) { lo=p[0]; hi=p[1]; }
+
+  private:
+    float lo,hi;
+  };
+
+  namespace detail {
+
+    class matrix_file_writer : pfi::lang::noncopyable {
+    public:
+      matrix_file_writer();
+      ~matrix_file_writer();
+
+      int open(const std::string& fn, uint32_t codec_id, const float params[2]);
+      int close();
+      bool is_open() const { return ofs.is_open(); }
+
+      void append_row(const std::vector<unsigned char>& bytes, uint32_t num);
+      uint64_t row_num() const { return nums.size(); }
+
+    private:
+      std::string fn;
+      std::ofstream ofs;
+      std::vector<uint64_t> offsets;
+      std::vector<uint32_t> nums;
+    };
+
+    class mapped_matrix : pfi::lang::noncopyable {
+    public:
+      mapped_matrix();
+
+      int open(const std::string& fn, uint32_t codec_id, float params[2]);
+      void close();
+      bool is_open() const { return offsets!=NULL; }
+
+      uint64_t row_num() const { return rows; }
+      uint64_t nonzero_num() const { return nnz; }
+
+      /// number of elements in row, or -1 if row is out of range
+      int64_t num(uint64_t row) const {
+        return row<rows?static_cast<int64_t>(nums[row]):-1;
+      }
+      const unsigned char* row_data(uint64_t row) const {
+        return reinterpret_cast<const unsigned char*>(mat.begin())+offsets[row];
+      }
+
+      /// asks the kernel to read rows ahead. rows must be sorted.
+      void prefetch(const std::vector<uint64_t>& rows) const;
+
+    private:
+      pfi::system::mmapper::mmapper mat;
+      pfi::system::mmapper::mmapper off;
+      uint64_t rows;
+      uint64_t nnz;
+      const uint64_t* offsets;
+      const uint32_t* nums;
+    };
+
+  } // detail
+
+  /**
+   * @brief writer of the version 2 format
+   */
+  template <class Codec>
+  class basic_sparse_matrix_writer : pfi::lang::noncopyable {
+  public:
+    typedef typename Codec::value_type value_type;
+
+    explicit basic_sparse_matrix_writer(const Codec& codec=Codec())
+      :codec_(codec) {}
+
+    int open(const std::string& fn) {
+      float p[2];
+      codec_.get_params(p);
+      return file.open(fn,Codec::id,p);
+    }
+
+    /**
+     * @brief write offsets and close
+     * @return 0 for success, -1 for error
+     */
+    int close() { return file.close(); }
+
+    /**
+     * @brief add row
+     * columns must be >=0, sorted and not duplicated.
+     */
+    void append_row(const std::map<int,value_type>& row) {
+      append_row(row.begin(),row.end());
+    }
+    void append_row(const std::vector<std::pair<int,value_type> >& row) {
+      append_row(row.begin(),row.end());
+    }
+
+    template <class Iterator>
+    void append_row(Iterator begin, Iterator end) {
+      if (!file.is_open()) return;
+
+      code::encoder ec;
+      uint32_t num=0;
+      int prev=-1;
+      for (;begin!=end;++begin) {
+        ec.prefix_code(begin->first-prev);
+        codec_.encode(ec,begin->second);
+        prev=begin->first;
+        ++num;
+      }
+      file.append_row(ec.get_bytes(),num);
+    }
+
+    uint64_t row_num() const { return file.row_num(); }
+
+  private:
+    detail::matrix_file_writer file;
+    Codec codec_;
+  };
+
+  /**
+   * @brief reader of the version 2 format
+   */
+  template <class Codec>
+  class basic_sparse_matrix_reader : pfi::lang::noncopyable {
+  public:
+    typedef typename Codec::value_type value_type;
+
+    basic_sparse_matrix_reader() {}
+
+    /**
+     * @return 0 for success, -1 if files cannot be mapped or
+     * were written with another codec
+     */
+    int open(const std::string& fn) {
+      float p[2];
+      if (mm.open(fn,Codec::id,p)<0) return -1;
+      codec_.set_params(p);
+      return 0;
+    }
+    void close() { mm.close(); }
+    bool is_open() const { return mm.is_open(); }
+
+    const Codec& codec() const { return codec_; }
+
+    uint64_t row_num() const { return mm.row_num(); }
+
+    /**
+     * @brief number of non-zero elements in specified row.
+     */
+    int64_t get_row_size(uint64_t row) const { return mm.num(row); }
+
+    /**
+     * @brief number of non-zero elements in whole matrix
+     */
+    uint64_t nonzero_num() const { return mm.nonzero_num(); }
+
+    /**
+     * @brief get row
+     */
+    void get_row(uint64_t row, std::vector<std::pair<int,value_type> >& data) const {
+      data.clear();
+      code::decoder dc;
+      int64_t num=start(row,dc);
+      data.resize(num>0?num:0);
+      int col=-1;
+      for (int64_t i=0;i<num;++i) {
+        col+=dc.prefix_code();
+        data[i].first=col;
+        data[i].second=codec_.decode(dc);
+      }
+    }
+    /**
+     * @brief get rows
+     * data[i] is set to the row rows[i]. rows are read in file order
+     * after asking the kernel to prefetch them, and vectors in data
+     * are reused.
+     */
+    void get_rows(const std::vector<uint64_t>& rows,
+                  std::vector<std::vector<std::pair<int,value_type> > >& data) const {
+      std::vector<std::pair<uint64_t,size_t> > order(rows.size());
+      for (size_t i=0;i<rows.size();++i) order[i]=std::make_pair(rows[i],i);
+      std::sort(order.begin(),order.end());
+
+      std::vector<uint64_t> sorted(order.size());
+      for (size_t i=0;i<order.size();++i) sorted[i]=order[i].first;
+      if (mm.is_open()) mm.prefetch(sorted);
+
+      data.resize(rows.size());
+      for (size_t i=0;i<order.size();++i)
+        get_row(order[i].first,data[order[i].second]);
+    }
+
+    void get_row(uint64_t row, std::map<int,value_type>& data) const {
+      decode_into(row,data);
+    }
+    void get_row(uint64_t row, pfi::data::unordered_map<int,value_type>& data) const {
+      decode_into(row,data);
+    }
+
+  private:
+    int64_t start(uint64_t row, code::decoder& dc) const {
+      if (!mm.is_open()) return 0;
+      int64_t num=mm.num(row);
+      if (num<0) {
+        fprintf(stderr,"basic_sparse_matrix_reader::get_row: row %llu out of range\n",
+                static_cast<unsigned long long>(row));
+        return 0;
+      }
+      dc.attach(mm.row_data(row));
+      return num;
+    }
+
+    template <class Map>
+    void decode_into(uint64_t row, Map& data) const {
+      code::decoder dc;
+      int64_t num=start(row,dc);
+      int col=-1;
+      for (int64_t i=0;i<num;++i) {
+        col+=dc.prefix_code();
+        data[col]=codec_.decode(dc);
+      }
+    }
+
+    detail::mapped_matrix mm;
+    Codec codec_;
+  };
+
+} // sparse_matrix
+} // data
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_DATA_SPARSE_MATRIX_BASIC_SPARSE_MATRIX_H_
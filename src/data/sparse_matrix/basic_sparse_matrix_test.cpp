@@ -0,0 +1,245 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include "./basic_sparse_matrix.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <vector>
+
+#include <unistd.h>
+
+#include "../../concurrent/thread.h"
+#include "../../lang/bind.h"
+#include "../../lang/shared_ptr.h"
+
+using namespace std;
+using namespace pfi::data::sparse_matrix;
+
+static const string tmp_file="./tmp_basic_sparse_matrix";
+
+static void clean() {
+  unlink(tmp_file.c_str());
+  unlink((tmp_file+".offset").c_str());
+}
+
+template <class Codec>
+static vector<vector<pair<int,typename Codec::value_type> > >
+random_matrix(int rows, int range)
+{
+  vector<vector<pair<int,typename Codec::value_type> > > mat(rows);
+  for (int i=0;i<rows;++i) {
+    int num=random()%50;
+    int c=-1;
+    for (int j=0;j<num;++j) {
+      c+=random()%1000+1;
+      mat[i].push_back(make_pair(c,typename Codec::value_type(random()%range+1)));
+    }
+  }
+  return mat;
+}
+
+template <class Codec>
+static void check_roundtrip(int range)
+{
+  typedef typename Codec::value_type value_type;
+  vector<vector<pair<int,value_type> > > mat=random_matrix<Codec>(200,range);
+
+  clean();
+  {
+    basic_sparse_matrix_writer<Codec> w;
+    ASSERT_EQ(0,w.open(tmp_file));
+    for (size_t i=0;i<mat.size();++i) w.append_row(mat[i]);
+    EXPECT_EQ(mat.size(),w.row_num());
+    ASSERT_EQ(0,w.close());
+  }
+  {
+    basic_sparse_matrix_reader<Codec> r;
+    ASSERT_EQ(0,r.open(tmp_file));
+    ASSERT_EQ(mat.size(),r.row_num());
+    uint64_t nnz=0;
+    for (size_t i=0;i<mat.size();++i) {
+      EXPECT_EQ((int64_t)mat[i].size(),r.get_row_size(i));
+      nnz+=mat[i].size();
+
+      vector<pair<int,value_type> > row;
+      r.get_row(i,row);
+      EXPECT_TRUE(mat[i]==row);
+
+      map<int,value_type> m;
+      r.get_row(i,m);
+      map<int,value_type> expected(mat[i].begin(),mat[i].end());
+      EXPECT_TRUE(expected==m);
+    }
+    EXPECT_EQ(nnz,r.nonzero_num());
+  }
+  clean();
+}
+
+TEST(basic_sparse_matrix, uint8) {
+  check_roundtrip<uint8_codec>(255);
+}
+
+TEST(basic_sparse_matrix, uint16) {
+  check_roundtrip<uint16_codec>(65535);
+}
+
+TEST(basic_sparse_matrix, uint32) {
+  check_roundtrip<uint32_codec>(1<<30);
+}
+
+TEST(basic_sparse_matrix, float_value) {
+  check_roundtrip<float_codec>(1000000);
+}
+
+TEST(basic_sparse_matrix, quantized_float) {
+  clean();
+  {
+    basic_sparse_matrix_writer<quantized_float_codec> w(quantized_float_codec(-1,1));
+    ASSERT_EQ(0,w.open(tmp_file));
+    vector<pair<int,float> > row;
+    row.push_back(make_pair(0,-1.0f));
+    row.push_back(make_pair(3,0.25f));
+    row.push_back(make_pair(10,5.0f));
+    w.append_row(row);
+    w.append_row(vector<pair<int,float> >());
+    ASSERT_EQ(0,w.close());
+  }
+  {
+    basic_sparse_matrix_reader<quantized_float_codec> r;
+    ASSERT_EQ(0,r.open(tmp_file));
+    ASSERT_EQ(2U,r.row_num());
+    vector<pair<int,float> > row;
+    r.get_row(0,row);
+    ASSERT_EQ(3U,row.size());
+    EXPECT_EQ(3,row[1].first);
+    EXPECT_FLOAT_EQ(-1.0f,row[0].second);
+    EXPECT_NEAR(0.25f,row[1].second,1.0f/255);
+    EXPECT_FLOAT_EQ(1.0f,row[2].second);
+    r.get_row(1,row);
+    EXPECT_TRUE(row.empty());
+  }
+  clean();
+}
+
+TEST(basic_sparse_matrix, codec_mismatch) {
+  clean();
+  {
+    basic_sparse_matrix_writer<uint16_codec> w;
+    ASSERT_EQ(0,w.open(tmp_file));
+    ASSERT_EQ(0,w.close());
+  }
+  {
+    basic_sparse_matrix_reader<float_codec> r;
+    EXPECT_EQ(-1,r.open(tmp_file));
+    EXPECT_FALSE(r.is_open());
+  }
+  {
+    basic_sparse_matrix_reader<uint16_codec> r;
+    EXPECT_EQ(0,r.open(tmp_file));
+    EXPECT_EQ(0U,r.row_num());
+    vector<pair<int,uint16_t> > row;
+    r.get_row(5,row);
+    EXPECT_TRUE(row.empty());
+  }
+  clean();
+}
+
+namespace {
+
+struct batch_reader {
+  const basic_sparse_matrix_reader<uint32_codec>* r;
+  const vector<vector<pair<int,uint32_t> > >* mat;
+  int seed;
+  bool ok;
+
+  void run() {
+    ok=true;
+    unsigned int s=seed;
+    vector<vector<pair<int,uint32_t> > > data;
+    for (int k=0;k<50;++k) {
+      vector<uint64_t> rows;
+      for (int j=0;j<20;++j) rows.push_back(rand_r(&s)%mat->size());
+      r->get_rows(rows,data);
+      if (data.size()!=rows.size()) ok=false;
+      for (size_t j=0;j<rows.size()&&ok;++j)
+        if (data[j]!=(*mat)[rows[j]]) ok=false;
+    }
+  }
+};
+
+}
+
+TEST(basic_sparse_matrix, get_rows_from_threads) {
+  vector<vector<pair<int,uint32_t> > > mat=random_matrix<uint32_codec>(500,100000);
+
+  clean();
+  {
+    basic_sparse_matrix_writer<uint32_codec> w;
+    ASSERT_EQ(0,w.open(tmp_file));
+    for (size_t i=0;i<mat.size();++i) w.append_row(mat[i]);
+    ASSERT_EQ(0,w.close());
+  }
+  {
+    basic_sparse_matrix_reader<uint32_codec> r;
+    ASSERT_EQ(0,r.open(tmp_file));
+
+    vector<batch_reader> readers(4);
+    vector<pfi::lang::shared_ptr<pfi::concurrent::thread> > ths;
+    for (size_t i=0;i<readers.size();++i) {
+      readers[i].r=&r;
+      readers[i].mat=&mat;
+      readers[i].seed=i+1;
+      ths.push_back(pfi::lang::shared_ptr<pfi::concurrent::thread>(
+        new pfi::concurrent::thread(pfi::lang::bind(&batch_reader::run,&readers[i]))));
+      ASSERT_TRUE(ths.back()->start());
+    }
+    for (size_t i=0;i<ths.size();++i) {
+      ths[i]->join();
+      EXPECT_TRUE(readers[i].ok);
+    }
+
+    vector<uint64_t> rows;
+    rows.push_back(7);
+    rows.push_back(3);
+    rows.push_back(7);
+    vector<vector<pair<int,uint32_t> > > data(10);
+    r.get_rows(rows,data);
+    ASSERT_EQ(3U,data.size());
+    EXPECT_TRUE(data[0]==mat[7]);
+    EXPECT_TRUE(data[1]==mat[3]);
+    EXPECT_TRUE(data[2]==mat[7]);
+  }
+  clean();
+}
@@ -0,0 +1,346 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INCLUDE_GUARD_PFI_DATA_SPARSE_MATRIX_CSR_MATRIX_H_
+#define INCLUDE_GUARD_PFI_DATA_SPARSE_MATRIX_CSR_MATRIX_H_
+
+#include <stdint.h>
+#include <climits>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "../../concurrent/parallel.h"
+#include "../../lang/bind.h"
+#include "../../lang/noncopyable.h"
+
+namespace pfi {
+namespace data {
+namespace sparse_matrix {
+
+  /**
+   * @brief in-memory compressed sparse row matrix
+   *
+   * rows are stored one after another in flat arrays, so they can be
+   * scanned without pointer chasing. the transposed matrix is the
+   * compressed sparse column form of the same matrix.
+   */
+  template <class V>
+  class csr_matrix {
+  public:
+    typedef V value_type;
+
+    csr_matrix():ptr_(1,0),cols_(0) {}
+
+    /**
+     * @brief load all rows from sparse_matrix_reader or basic_sparse_matrix_reader
+     * @return 0 on success, -1 if a row cannot be added (see append_row)
+     */
+    template <class Reader>
+    int load(const Reader& r) {
+      clear();
+      uint64_t n=r.row_num();
+      uint64_t nnz=0;
+      for (uint64_t i=0;i<n;++i) nnz+=std::max<int64_t>(r.get_row_size(i),0);
+      ptr_.reserve(n+1);
+      idx_.reserve(nnz);
+      val_.reserve(nnz);
+
+      std::vector<std::pair<int,typename Reader::value_type> > row;
+      for (uint64_t i=0;i<n;++i) {
+        r.get_row(i,row);
+        if (append_row(row.begin(),row.end())<0) return -1;
+      }
+      return 0;
+    }
+
+    /**
+     * @brief add row
+     * columns must be >=0, sorted and not duplicated.
+     * @return 0 on success. -1 if the matrix already has INT_MAX rows or
+     * a column is not in [0, INT_MAX), so that both the matrix and its
+     * transpose index with int. the matrix is unchanged on failure.
+     */
+    template <class Iterator>
+    int append_row(Iterator begin, Iterator end) {
+      if (row_num()>=static_cast<uint64_t>(INT_MAX)) return -1;
+      size_t n=idx_.size();
+      int cols=cols_;
+      for (;begin!=end;++begin) {
+        if (begin->first<0||begin->first==INT_MAX) {
+          idx_.resize(n);
+          val_.resize(n);
+          cols_=cols;
+          return -1;
+        }
+        idx_.push_back(begin->first);
+        val_.push_back(begin->second);
+        cols_=std::max(cols_,begin->first+1);
+      }
+      ptr_.push_back(idx_.size());
+      return 0;
+    }
+
+    void clear() {
+      ptr_.assign(1,0);
+      idx_.clear();
+      val_.clear();
+      cols_=0;
+    }
+
+    uint64_t row_num() const { return ptr_.size()-1; }
+    int col_num() const { return cols_; }
+    uint64_t nonzero_num() const { return idx_.size(); }
+
+    uint64_t row_size(uint64_t r) const { return ptr_[r+1]-ptr_[r]; }
+    const int* row_cols(uint64_t r) const { return idx_.empty()?NULL:&idx_[0]+ptr_[r]; }
+    const V* row_vals(uint64_t r) const { return val_.empty()?NULL:&val_[0]+ptr_[r]; }
+
+    /**
+     * @brief transposed matrix, i.e. the compressed sparse column form
+     * append_row keeps row_num() within int, so rows fit as columns.
+     */
+    csr_matrix transpose() const {
+      csr_matrix t;
+      t.cols_=static_cast<int>(row_num());
+      t.ptr_.assign(cols_+1,0);
+      for (uint64_t i=0;i<idx_.size();++i) ++t.ptr_[idx_[i]+1];
+      for (int c=0;c<cols_;++c) t.ptr_[c+1]+=t.ptr_[c];
+
+      t.idx_.resize(idx_.size());
+      t.val_.resize(val_.size());
+      std::vector<uint64_t> pos(t.ptr_.begin(),t.ptr_.end()-1);
+      for (uint64_t r=0;r<row_num();++r) {
+        for (uint64_t i=ptr_[r];i<ptr_[r+1];++i) {
+          uint64_t p=pos[idx_[i]]++;
+          t.idx_[p]=r;
+          t.val_[p]=val_[i];
+        }
+      }
+      return t;
+    }
+
+    /**
+     * @brief y = this * x
+     * x must have col_num() elements. rows are split into threads
+     * ranges with about the same number of non-zero elements.
+     */
+    void multiply(const std::vector<double>& x, std::vector<double>& y, int threads=1) const {
+      y.resize(row_num());
+      threads=std::max(threads,1);
+      if (threads==1||row_num()<static_cast<uint64_t>(threads)) {
+        multiply_rows(&x,&y,0,row_num());
+        return;
+      }
+      std::vector<uint64_t> bounds(threads+1,row_num());
+      bounds[0]=0;
+      for (int i=1;i<threads;++i)
+        bounds[i]=std::upper_bound(ptr_.begin(),ptr_.end(),nonzero_num()*i/threads)-ptr_.begin()-1;
+      pfi::concurrent::parallel_run(threads,pfi::lang::bind(&csr_matrix::multiply_part,this,&x,&y,&bounds,pfi::lang::_1));
+    }
+
+    /**
+     * @brief dot product of rows i and j
+     */
+    double dot(uint64_t i, uint64_t j) const {
+      return dot(i,*this,j);
+    }
+
+    /**
+     * @brief dot product of row i and row j of b
+     */
+    template <class W>
+    double dot(uint64_t i, const csr_matrix<W>& b, uint64_t j) const {
+      const int *p=row_cols(i),*pe=p+row_size(i);
+      const int *q=b.row_cols(j),*qe=q+b.row_size(j);
+      const V* pv=row_vals(i);
+      const W* qv=b.row_vals(j);
+      double s=0;
+      while (p<pe&&q<qe) {
+        if (*p<*q) {
+          ++p;
+          ++pv;
+        } else if (*q<*p) {
+          ++q;
+          ++qv;
+        } else {
+          s+=static_cast<double>(*pv++)*static_cast<double>(*qv++);
+          ++p;
+          ++q;
+        }
+      }
+      return s;
+    }
+
+    /**
+     * @brief euclidean norm of row i
+     */
+    double norm(uint64_t i) const {
+      double s=0;
+      for (uint64_t k=ptr_[i];k<ptr_[i+1];++k) s+=static_cast<double>(val_[k])*val_[k];
+      return std::sqrt(s);
+    }
+
+  private:
+    void multiply_rows(const std::vector<double>* x, std::vector<double>* y,
+                       uint64_t st, uint64_t en) const {
+      const double* xs=x->empty()?NULL:&(*x)[0];
+      for (uint64_t r=st;r<en;++r) {
+        uint64_t k=ptr_[r],ke=ptr_[r+1];
+        // independent sums keep several loads in flight
+        double s0=0,s1=0,s2=0,s3=0;
+        for (;k+4<=ke;k+=4) {
+          s0+=val_[k]*xs[idx_[k]];
+          s1+=val_[k+1]*xs[idx_[k+1]];
+          s2+=val_[k+2]*xs[idx_[k+2]];
+          s3+=val_[k+3]*xs[idx_[k+3]];
+        }
+        for (;k<ke;++k) s0+=val_[k]*xs[idx_[k]];
+        (*y)[r]=(s0+s1)+(s2+s3);
+      }
+    }
+
+    void multiply_part(const std::vector<double>* x, std::vector<double>* y,
+                       const std::vector<uint64_t>* bounds, int i) const {
+      multiply_rows(x,y,(*bounds)[i],(*bounds)[i+1]);
+    }
+
+    std::vector<uint64_t> ptr_;
+    std::vector<int> idx_;
+    std::vector<V> val_;
+    int cols_;
+  };
+
+  /**
+   * @brief top-k similar rows of a csr_matrix
+   *
+   * keeps the transposed matrix, so a query only visits rows that share
+   * a column with the query row. queries are const and may run from
+   * several threads. the matrix must outlive this object.
+   */
+  template <class V>
+  class row_similarity : pfi::lang::noncopyable {
+  public:
+    typedef std::vector<std::pair<uint64_t,double> > result_type;
+
+    /**
+     * @param cosine rank by cosine similarity instead of dot product
+     */
+    explicit row_similarity(const csr_matrix<V>& m, bool cosine=true)
+      :m(m),t(m.transpose()),cosine(cosine) {
+      if (cosine) {
+        norms.resize(m.row_num());
+        for (uint64_t i=0;i<m.row_num();++i) norms[i]=m.norm(i);
+      }
+    }
+
+    /**
+     * @brief k rows with the largest positive similarity to row,
+     * in descending order of similarity. row itself is not included.
+     */
+    void top_k(uint64_t row, size_t k, result_type& out) const {
+      std::vector<double> acc(m.row_num());
+      std::vector<uint64_t> touched;
+      query(row,k,out,acc,touched);
+    }
+
+    /**
+     * @brief top_k for each of rows, using threads threads
+     */
+    void top_k(const std::vector<uint64_t>& rows, size_t k,
+               std::vector<result_type>& out, int threads=1) const {
+      out.resize(rows.size());
+      threads=std::max(1,std::min<int>(threads,rows.size()));
+      if (threads<=1) {
+        query_part(&rows,k,&out,1,0);
+        return;
+      }
+      pfi::concurrent::parallel_run(threads,pfi::lang::bind(&row_similarity::query_part,this,
+                                                   &rows,k,&out,threads,pfi::lang::_1));
+    }
+
+  private:
+    void query_part(const std::vector<uint64_t>* rows, size_t k,
+                    std::vector<result_type>* out, int parts, int part) const {
+      std::vector<double> acc(m.row_num());
+      std::vector<uint64_t> touched;
+      size_t st=rows->size()*part/parts,en=rows->size()*(part+1)/parts;
+      for (size_t i=st;i<en;++i) query((*rows)[i],k,(*out)[i],acc,touched);
+    }
+
+    void query(uint64_t row, size_t k, result_type& out,
+               std::vector<double>& acc, std::vector<uint64_t>& touched) const {
+      out.clear();
+      if (row>=m.row_num()) return;
+
+      // accumulate scores of rows sharing columns with row
+      const int* cs=m.row_cols(row);
+      const V* vs=m.row_vals(row);
+      for (uint64_t i=0;i<m.row_size(row);++i) {
+        int c=cs[i];
+        const int* rs=t.row_cols(c);
+        const V* ws=t.row_vals(c);
+        for (uint64_t j=0;j<t.row_size(c);++j) {
+          if (acc[rs[j]]==0) touched.push_back(rs[j]);
+          acc[rs[j]]+=static_cast<double>(vs[i])*ws[j];
+        }
+      }
+
+      std::vector<std::pair<double,uint64_t> > cand;
+      cand.reserve(touched.size());
+      double n=cosine?norms[row]:1;
+      for (size_t i=0;i<touched.size();++i) {
+        uint64_t r=touched[i];
+        double s=acc[r];
+        acc[r]=0;
+        if (r==row||s<=0) continue;
+        if (cosine) s/=n*norms[r];
+        cand.push_back(std::make_pair(-s,r));
+      }
+      touched.clear();
+
+      size_t kk=std::min(k,cand.size());
+      std::partial_sort(cand.begin(),cand.begin()+kk,cand.end());
+      out.resize(kk);
+      for (size_t i=0;i<kk;++i) out[i]=std::make_pair(cand[i].second,-cand[i].first);
+    }
+
+    const csr_matrix<V>& m;
+    csr_matrix<V> t;
+    std::vector<double> norms;
+    bool cosine;
+  };
+
+} // sparse_matrix
+} // data
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_DATA_SPARSE_MATRIX_CSR_MATRIX_H_
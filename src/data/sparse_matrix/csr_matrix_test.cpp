@@ -0,0 +1,231 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include "./csr_matrix.h"
+#include "./sparse_matrix.h"
+#include "./basic_sparse_matrix.h"
+
+#include <climits>
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace std;
+using namespace pfi::data::sparse_matrix;
+
+static const string tmp_file="./tmp_csr_matrix";
+
+static void clean() {
+  unlink(tmp_file.c_str());
+  unlink((tmp_file+".offset").c_str());
+}
+
+static vector<map<int,unsigned char> > random_rows(int rows, int cols, int num)
+{
+  vector<map<int,unsigned char> > mat(rows);
+  for (int i=0;i<rows;++i) {
+    int n=random()%num;
+    for (int j=0;j<n;++j) mat[i][random()%cols]=random()%255+1;
+  }
+  return mat;
+}
+
+static csr_matrix<float> to_csr(const vector<map<int,unsigned char> >& mat)
+{
+  csr_matrix<float> m;
+  for (size_t i=0;i<mat.size();++i) m.append_row(mat[i].begin(),mat[i].end());
+  return m;
+}
+
+static double naive_dot(const map<int,unsigned char>& a, const map<int,unsigned char>& b)
+{
+  double s=0;
+  for (map<int,unsigned char>::const_iterator it=a.begin();it!=a.end();++it) {
+    map<int,unsigned char>::const_iterator jt=b.find(it->first);
+    if (jt!=b.end()) s+=double(it->second)*jt->second;
+  }
+  return s;
+}
+
+TEST(csr_matrix, load) {
+  vector<map<int,unsigned char> > mat=random_rows(100,500,30);
+  clean();
+  {
+    sparse_matrix_writer w;
+    ASSERT_EQ(0,w.open(tmp_file));
+    for (size_t i=0;i<mat.size();++i) w.append_row(mat[i]);
+    w.close();
+  }
+  {
+    sparse_matrix_reader r;
+    ASSERT_EQ(0,r.open(tmp_file));
+    csr_matrix<unsigned char> m;
+    m.load(r);
+    ASSERT_EQ(mat.size(),m.row_num());
+    for (size_t i=0;i<mat.size();++i) {
+      ASSERT_EQ(mat[i].size(),m.row_size(i));
+      map<int,unsigned char>::iterator it=mat[i].begin();
+      for (uint64_t j=0;j<m.row_size(i);++j,++it) {
+        EXPECT_EQ(it->first,m.row_cols(i)[j]);
+        EXPECT_EQ(it->second,m.row_vals(i)[j]);
+      }
+    }
+  }
+  clean();
+  {
+    basic_sparse_matrix_writer<float_codec> w;
+    ASSERT_EQ(0,w.open(tmp_file));
+    for (size_t i=0;i<mat.size();++i) {
+      map<int,float> row(mat[i].begin(),mat[i].end());
+      w.append_row(row);
+    }
+    ASSERT_EQ(0,w.close());
+  }
+  {
+    basic_sparse_matrix_reader<float_codec> r;
+    ASSERT_EQ(0,r.open(tmp_file));
+    csr_matrix<float> m;
+    m.load(r);
+    ASSERT_EQ(mat.size(),m.row_num());
+    uint64_t nnz=0;
+    for (size_t i=0;i<mat.size();++i) nnz+=mat[i].size();
+    EXPECT_EQ(nnz,m.nonzero_num());
+    for (size_t i=0;i<mat.size();++i)
+      EXPECT_DOUBLE_EQ(naive_dot(mat[i],mat[i]),m.dot(i,i));
+  }
+  clean();
+}
+
+TEST(csr_matrix, transpose) {
+  vector<map<int,unsigned char> > mat=random_rows(80,60,20);
+  csr_matrix<float> m=to_csr(mat);
+  csr_matrix<float> t=m.transpose();
+  ASSERT_EQ((uint64_t)m.col_num(),t.row_num());
+  EXPECT_EQ(m.nonzero_num(),t.nonzero_num());
+  for (uint64_t c=0;c<t.row_num();++c) {
+    for (uint64_t j=0;j<t.row_size(c);++j) {
+      int r=t.row_cols(c)[j];
+      if (j>0) { EXPECT_LT(t.row_cols(c)[j-1],r); }
+      EXPECT_EQ(mat[r].find(c)->second,t.row_vals(c)[j]);
+    }
+  }
+}
+
+TEST(csr_matrix, append_row_range) {
+  csr_matrix<float> m;
+  vector<pair<int,float> > row;
+  row.push_back(make_pair(3,1.0f));
+  EXPECT_EQ(0,m.append_row(row.begin(),row.end()));
+
+  row.push_back(make_pair(INT_MAX,2.0f));
+  EXPECT_EQ(-1,m.append_row(row.begin(),row.end()));
+  row[1].first=-1;
+  EXPECT_EQ(-1,m.append_row(row.begin(),row.end()));
+  EXPECT_EQ(1u,m.row_num());
+  EXPECT_EQ(1u,m.nonzero_num());
+  EXPECT_EQ(4,m.col_num());
+
+  row[1].first=INT_MAX-1;
+  EXPECT_EQ(0,m.append_row(row.begin(),row.end()));
+  EXPECT_EQ(INT_MAX,m.col_num());
+}
+
+TEST(csr_matrix, multiply) {
+  vector<map<int,unsigned char> > mat=random_rows(1000,300,40);
+  csr_matrix<float> m=to_csr(mat);
+  vector<double> x(m.col_num());
+  for (size_t i=0;i<x.size();++i) x[i]=double(random()%1000)/100;
+
+  vector<double> y1,y4;
+  m.multiply(x,y1);
+  m.multiply(x,y4,4);
+  ASSERT_EQ(mat.size(),y1.size());
+  ASSERT_EQ(mat.size(),y4.size());
+  for (size_t i=0;i<mat.size();++i) {
+    double s=0;
+    for (map<int,unsigned char>::iterator it=mat[i].begin();it!=mat[i].end();++it)
+      s+=it->second*x[it->first];
+    EXPECT_NEAR(s,y1[i],1e-6*max(1.0,s));
+    EXPECT_DOUBLE_EQ(y1[i],y4[i]);
+  }
+}
+
+TEST(csr_matrix, dot) {
+  vector<map<int,unsigned char> > mat=random_rows(50,100,40);
+  csr_matrix<float> m=to_csr(mat);
+  csr_matrix<unsigned char> m8;
+  for (size_t i=0;i<mat.size();++i) m8.append_row(mat[i].begin(),mat[i].end());
+  for (size_t i=0;i<mat.size();++i)
+    for (size_t j=0;j<mat.size();++j) {
+      EXPECT_DOUBLE_EQ(naive_dot(mat[i],mat[j]),m.dot(i,j));
+      EXPECT_DOUBLE_EQ(naive_dot(mat[i],mat[j]),m.dot(i,m8,j));
+    }
+}
+
+TEST(csr_matrix, top_k) {
+  vector<map<int,unsigned char> > mat=random_rows(300,200,15);
+  csr_matrix<float> m=to_csr(mat);
+
+  for (int cosine=0;cosine<2;++cosine) {
+    row_similarity<float> sim(m,cosine);
+    vector<uint64_t> rows;
+    for (uint64_t i=0;i<m.row_num();++i) rows.push_back(i);
+    vector<row_similarity<float>::result_type> res;
+    sim.top_k(rows,5,res,3);
+    ASSERT_EQ(rows.size(),res.size());
+
+    for (size_t i=0;i<rows.size();++i) {
+      vector<double> expected;
+      for (size_t j=0;j<mat.size();++j) {
+        if (j==i) continue;
+        double s=naive_dot(mat[i],mat[j]);
+        if (s<=0) continue;
+        if (cosine) s/=sqrt(naive_dot(mat[i],mat[i])*naive_dot(mat[j],mat[j]));
+        expected.push_back(s);
+      }
+      sort(expected.rbegin(),expected.rend());
+      expected.resize(min<size_t>(5,expected.size()));
+
+      row_similarity<float>::result_type one;
+      sim.top_k(i,5,one);
+      EXPECT_TRUE(one==res[i]);
+      ASSERT_EQ(expected.size(),res[i].size());
+      for (size_t j=0;j<expected.size();++j) {
+        EXPECT_NE(rows[i],res[i][j].first);
+        EXPECT_NEAR(expected[j],res[i][j].second,1e-9);
+      }
+    }
+  }
+}
@@ -37,6 +37,11 @@
 #include <sstream>
 #include <iostream>
 
+#include <unistd.h>
+
+#include "../../concurrent/thread.h"
+#include "../../lang/bind.h"
+#include "../../lang/shared_ptr.h"
 #include "../../system/file.h"
 #include "../../system/sysstat.h"
 
@@ -292,7 +297,16 @@ namespace sparse_matrix {
   int sparse_matrix_reader::open(const string& fnMat)
   {
     close();
-    dc.attach(fnMat);
+
+    // padded for word reads of the decoder
+    ifstream ifs(fnMat.c_str());
+    if (ifs) {
+      ssize_t size=get_file_size(fnMat);
+      if (size>=0) {
+        bytes.assign(size+sizeof(long long),0);
+        ifs.read((char*)&bytes[0],size);
+      }
+    }
 
     offsets=new matrix_offsets;
     if (offsets->open(fnMat+".offset",MATRIX_IO_READ)<0){
@@ -304,7 +318,7 @@ namespace sparse_matrix {
 
   void sparse_matrix_reader::close()
   {
-    dc.detach();
+    vector<unsigned char>().swap(bytes);
     if (offsets) {
       delete offsets;
       offsets=NULL;
@@ -323,19 +337,27 @@ namespace sparse_matrix {
     return offsets->num(row);
   }
 
-  void sparse_matrix_reader::get_row(int row, vector<pair<int,unsigned char> >& data)
+  int sparse_matrix_reader::start(int row, decoder& dc) const
   {
-    if (!dc.is_open()||!offsets) return;
+    if (bytes.empty()||!offsets) return 0;
 
     int num=offsets->num(row);
     if (num<0){
       fprintf(stderr,"sparse_matrix_reader::get_row: offsets.Num error\n");
-      return;
+      return 0;
     }
+    dc.attach(&bytes[0]);
     dc.seek(offsets->offset(row));
+    return num;
+  }
+
+  void sparse_matrix_reader::get_row(int row, vector<pair<int,unsigned char> >& data) const
+  {
+    decoder dc;
+    int num=start(row,dc);
   
     int col=-1;
-    data=vector<pair<int,unsigned char> >(num);
+    data.resize(num);
     for (int i=0;i<num;++i) {
       col+=dc.prefix_code();
       data[i].first=col;
@@ -343,16 +365,10 @@ namespace sparse_matrix {
     }
   }
 
-  void sparse_matrix_reader::get_row(int row, std::map<int,unsigned char>& data)
+  void sparse_matrix_reader::get_row(int row, std::map<int,unsigned char>& data) const
   {
-    if (!dc.is_open()||!offsets) return;
-
-    int num=offsets->num(row);
-    if (num<0){
-      fprintf(stderr,"sparse_matrix_reader::get_row: offsets.Num error\n");
-      return;
-    }
-    dc.seek(offsets->offset(row));
+    decoder dc;
+    int num=start(row,dc);
   
     int col=-1;
     for (int i=0;i<num;++i) {
@@ -361,16 +377,10 @@ namespace sparse_matrix {
     }
   }
 
-  void sparse_matrix_reader::get_row(int row, pfi::data::unordered_map<int,unsigned char>& data)
+  void sparse_matrix_reader::get_row(int row, pfi::data::unordered_map<int,unsigned char>& data) const
   {
-    if (!dc.is_open()||!offsets) return;
-
-    int num=offsets->num(row);
-    if (num<0){
-      fprintf(stderr,"sparse_matrix_reader::get_row: offsets.Num error\n");
-      return;
-    }
-    dc.seek(offsets->offset(row));
+    decoder dc;
+    int num=start(row,dc);
   
     int col=-1;
     for (int i=0;i<num;++i) {
@@ -379,6 +389,13 @@ namespace sparse_matrix {
     }
   }
 
+  void sparse_matrix_reader::get_rows(const vector<int>& rows,
+                                      vector<vector<pair<int,unsigned char> > >& data) const
+  {
+    data.resize(rows.size());
+    for (size_t i=0;i<rows.size();++i) get_row(rows[i],data[i]);
+  }
+
   int sparse_matrix_reader::get_row_nonzero_value_num(int row) const
   {
     if (!offsets) return 0;
@@ -391,30 +408,100 @@ namespace sparse_matrix {
   // MatrixTranspose
   //
 
-  int matrix_transpose(const string& fnMat, const string& fnMatT)
-  {
-    fputs("transpose start\n",stderr);
-    vector<std::map<int,unsigned char> > hash;
+  namespace {
+
+    // columns [st,en) of the transposed matrix. entries are spilled to
+    // fn as (column, row, value) records in row order, so a counting
+    // sort by column leaves each column sorted by row.
+    struct transpose_bucket {
+      string fn;
+      int st,en;
+      vector<uint64_t> begin;                 // en-st+1 prefix sums
+      vector<pair<int,unsigned char> > rows;  // loaded entries
+      bool ok;
+    };
+
+    const size_t transpose_record_size=9;
+    const size_t max_open_buckets=256;
+
+    void encode_record(char* p, int col, int row, unsigned char val)
+    {
+      memcpy(p,&col,4);
+      memcpy(p+4,&row,4);
+      p[8]=val;
+    }
 
+    void load_bucket(transpose_bucket* b)
+    {
+      b->ok=false;
+      ifstream ifs(b->fn.c_str(),ios::binary);
+      if (!ifs) return;
+
+      uint64_t n=b->begin.back();
+      b->rows.resize(n);
+      vector<uint64_t> pos(b->begin.begin(),b->begin.end()-1);
+      vector<char> buf(transpose_record_size*4096);
+      for (uint64_t i=0;i<n;) {
+        uint64_t m=min<uint64_t>(n-i,buf.size()/transpose_record_size);
+        if (!ifs.read(&buf[0],m*transpose_record_size)) return;
+        for (uint64_t j=0;j<m;++j) {
+          const char* p=&buf[j*transpose_record_size];
+          int col,row;
+          memcpy(&col,p,4);
+          memcpy(&row,p+4,4);
+          if (col<b->st||col>=b->en||pos[col-b->st]>=b->begin[col-b->st+1]) return;
+          b->rows[pos[col-b->st]++]=make_pair(row,(unsigned char)p[8]);
+        }
+        i+=m;
+      }
+      b->ok=true;
+    }
+
+    void load_buckets(vector<transpose_bucket>& buckets, size_t st, size_t en)
+    {
+      using pfi::concurrent::thread;
+
+      vector<pfi::lang::shared_ptr<thread> > ths;
+      for (size_t i=st+1;i<en;++i) {
+        pfi::lang::shared_ptr<thread> th(new thread(pfi::lang::bind(&load_bucket,&buckets[i])));
+        if (th->start()) ths.push_back(th);
+        else load_bucket(&buckets[i]);
+      }
+      load_bucket(&buckets[st]);
+      for (size_t i=0;i<ths.size();++i) ths[i]->join();
+    }
+
+    void remove_buckets(const vector<transpose_bucket>& buckets)
+    {
+      for (size_t i=0;i<buckets.size();++i) unlink(buckets[i].fn.c_str());
+    }
+
+    bool bucket_less(int col, const transpose_bucket& b)
+    {
+      return col<b.st;
+    }
+
+  }
+
+  int matrix_transpose(const string& fnMat, const string& fnMatT,
+                       uint64_t memory_limit, int threads)
+  {
     sparse_matrix_reader index;
-    fprintf(stderr,"index.open(%s)\n",fnMat.c_str());
     if (index.open(fnMat)<0){
       fprintf(stderr,"MatrixTranspose cannot open %s\n",fnMat.c_str());
       return -1;
     }
     sparse_matrix_writer indexT;
-    fputs("indexT.open()\n",stderr);
     if (indexT.open(fnMatT)<0){
       fprintf(stderr,"MatrixTranspose cannot open %s\n",fnMatT.c_str());
       return -1;
     }
     int docNum=index.row_num();
-    fprintf(stderr,"index.row_num() = %d\n",docNum);
 
     // count how much number of element not equal to zero contains for each column
-    vector<int> termCount;
+    vector<uint64_t> termCount;
+    vector<pair<int,unsigned char> > docs;
     for (int i=0;i<docNum;++i) {
-      vector<pair<int,unsigned char> > docs;
       index.get_row(i,docs);
       for (int j=0;j<(int)docs.size();++j) {
         int term=docs[j].first;
@@ -424,54 +511,93 @@ namespace sparse_matrix {
     }
     int termNum=termCount.size();
 
-    fputs("term count finished\n",stderr);
-
-    // for memory usage, split columns to small pieces
-    uint64_t sum=0;
-    vector<int> boundary;
-    pfi::system::sysstat::sysstat_ret stat;
-    int stat_ret = pfi::system::sysstat::get_sysstat(stat);
-    if (stat_ret<0){
-      fprintf(stderr,"get_sysstat failed\n");
-      return -1;
-    }
-    uint64_t limit=stat.free_memory/20;
-
-    for (int i=0;i<(int)termCount.size();++i) {
-      sum+=termCount[i];
-      if (sum>=limit) {
-        fprintf(stderr,"boundary: %d\n",i);
-        boundary.push_back(i+1);
-        sum=0;
+    if (memory_limit==0) {
+      pfi::system::sysstat::sysstat_ret stat;
+      if (pfi::system::sysstat::get_sysstat(stat)<0){
+        fprintf(stderr,"get_sysstat failed\n");
+        return -1;
       }
+      memory_limit=stat.free_memory/4;
     }
-    if (sum>0) {
-      fprintf(stderr,"boundary: %d\n",termNum);
-      boundary.push_back(termNum);
+    threads=max(threads,1);
+
+    // split columns to buckets, threads of them must fit in memory_limit
+    uint64_t bucket_limit=memory_limit/threads;
+    vector<transpose_bucket> buckets;
+    for (int i=0;i<termNum;) {
+      transpose_bucket b;
+      b.st=i;
+      b.begin.push_back(0);
+      uint64_t bytes=0;
+      do {
+        b.begin.push_back(b.begin.back()+termCount[i]);
+        bytes+=termCount[i]*sizeof(pair<int,unsigned char>)+sizeof(uint64_t);
+        ++i;
+      } while (i<termNum&&bytes+termCount[i]*sizeof(pair<int,unsigned char>)+sizeof(uint64_t)<=bucket_limit);
+      b.en=i;
+      ostringstream oss;
+      oss<<fnMatT<<".bucket."<<buckets.size();
+      b.fn=oss.str();
+      b.ok=false;
+      buckets.push_back(b);
     }
+    vector<uint64_t>().swap(termCount);
+
+    // spill entries to bucket files, max_open_buckets files per pass
+    for (size_t g=0;g<buckets.size();g+=max_open_buckets) {
+      size_t ge=min(buckets.size(),g+max_open_buckets);
+      vector<pfi::lang::shared_ptr<ofstream> > outs;
+      for (size_t i=g;i<ge;++i)
+        outs.push_back(pfi::lang::shared_ptr<ofstream>(new ofstream(buckets[i].fn.c_str(),ios::binary)));
+
+      int st=buckets[g].st,en=buckets[ge-1].en;
+      char rec[transpose_record_size];
+      for (int i=0;i<docNum;++i) {
+        index.get_row(i,docs);
+        for (int j=0;j<(int)docs.size();++j) {
+          int col=docs[j].first;
+          if (col<st||col>=en) continue;
+          size_t k=upper_bound(buckets.begin()+g,buckets.begin()+ge,col,bucket_less)-buckets.begin()-1;
+          encode_record(rec,col,i,docs[j].second);
+          outs[k-g]->write(rec,sizeof(rec));
+        }
+      }
 
-    fputs("split rows finished\n",stderr);
-
-    // transpose for each column sets
-    int st=0;
-    for (int i=0;i<(int)boundary.size();++i) {
-      fprintf(stderr,"transpose: %d / %d\n",i,(int)boundary.size());
-
-      int en=boundary[i];
-      vector<std::map<int,unsigned char> > hash(en-st);
+      bool ok=true;
+      for (size_t i=0;i<outs.size();++i) {
+        outs[i]->close();
+        ok=ok&&!outs[i]->fail();
+      }
+      if (!ok) {
+        fprintf(stderr,"MatrixTranspose cannot write buckets of %s\n",fnMatT.c_str());
+        remove_buckets(buckets);
+        return -1;
+      }
+    }
+    index.close();
 
-      for (int j=0;j<docNum;++j) {
-        vector<pair<int,unsigned char> > docs;
-        index.get_row(j,docs);
-        for (int k=0;k<(int)docs.size();++k) 
-          if (st<=(int)docs[k].first&&(int)docs[k].first<en) 
-            hash[docs[k].first-st][j]=docs[k].second;
+    // sort threads buckets at a time and write their columns in order
+    for (size_t g=0;g<buckets.size();g+=threads) {
+      fprintf(stderr,"transpose: %d / %d\n",(int)g,(int)buckets.size());
+
+      size_t ge=min(buckets.size(),g+threads);
+      load_buckets(buckets,g,ge);
+      for (size_t i=g;i<ge;++i) {
+        transpose_bucket& b=buckets[i];
+        if (!b.ok) {
+          fprintf(stderr,"MatrixTranspose cannot read %s\n",b.fn.c_str());
+          remove_buckets(buckets);
+          return -1;
+        }
+        for (int c=b.st;c<b.en;++c) {
+          docs.assign(b.rows.begin()+b.begin[c-b.st],b.rows.begin()+b.begin[c-b.st+1]);
+          indexT.append_row(docs);
+        }
+        vector<pair<int,unsigned char> >().swap(b.rows);
+        unlink(b.fn.c_str());
       }
-      for (int i=st;i<en;++i) indexT.append_row(hash[i-st]);
-      st=en;
     }
 
-    index.close();
     indexT.close();
     return 0;
   }
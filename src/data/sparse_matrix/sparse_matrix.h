@@ -32,6 +32,7 @@
 #ifndef INCLUDE_GUARD_PFI_DATA_SPARSE_MATRIX_SPARSE_MATRIX_H_
 #define INCLUDE_GUARD_PFI_DATA_SPARSE_MATRIX_SPARSE_MATRIX_H_
 
+#include <stdint.h>
 #include <cstdio>
 #include <vector>
 #include <string>
@@ -82,6 +83,8 @@ namespace sparse_matrix {
   class sparse_matrix_reader
   {
   public:
+    typedef unsigned char value_type;
+
     sparse_matrix_reader();
     ~sparse_matrix_reader();
 
@@ -101,24 +104,43 @@ namespace sparse_matrix {
 
     /**
      * @brief get row
+     * rows are decoded from the loaded matrix without shared state,
+     * so several threads may read rows of one reader at a time.
      */
-    void get_row(int row, std::vector<std::pair<int,unsigned char> >& data);
-    void get_row(int row, std::map<int,unsigned char>& data);
-    void get_row(int row, pfi::data::unordered_map<int,unsigned char>& data);
+    void get_row(int row, std::vector<std::pair<int,unsigned char> >& data) const;
+    void get_row(int row, std::map<int,unsigned char>& data) const;
+    void get_row(int row, pfi::data::unordered_map<int,unsigned char>& data) const;
+
+    /**
+     * @brief get rows
+     * data[i] is set to the row rows[i]. vectors in data are reused.
+     */
+    void get_rows(const std::vector<int>& rows,
+                  std::vector<std::vector<std::pair<int,unsigned char> > >& data) const;
 
     /**
      * @brief number of non-zero elements in whole matrix
      */
     int get_row_nonzero_value_num(int row) const;
   private:
-    pfi::data::code::decoder dc;
+    int start(int row, pfi::data::code::decoder& dc) const;
+
+    std::vector<unsigned char> bytes;
     matrix_offsets* offsets;
   };
 
   /**
    * @brief transpose matrix
+   * @param memory_limit bytes of memory for sorting, 0 for a quarter of free memory
+   * @param threads number of column buckets sorted at the same time
+   *
+   * columns are partitioned into buckets and spilled to temporary files
+   * named fnT.bucket.N. then buckets are sorted in parallel and written
+   * in order. memory use is bounded by memory_limit, except for buckets
+   * holding a single column.
    */
-  int matrix_transpose(const std::string& fn, const std::string& fnT);
+  int matrix_transpose(const std::string& fn, const std::string& fnT,
+                       uint64_t memory_limit=0, int threads=1);
 } // sparse_matrix
 } // data
 } // pfi
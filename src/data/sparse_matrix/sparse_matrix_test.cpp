@@ -132,6 +132,65 @@ TEST(sparse_matrix_test, index) {
     }
   }
 
+  {
+    sparse_matrix_reader smr;
+    smr.open(tmp_file);
+    vector<int> rows;
+    rows.push_back(42);
+    rows.push_back(0);
+    rows.push_back(99);
+    vector<vector<pair<int,unsigned char> > > data;
+    smr.get_rows(rows,data);
+    ASSERT_EQ(rows.size(),data.size());
+    for (int i=0;i<(int)rows.size();++i)
+      EXPECT_TRUE(mat[rows[i]]==data[i]);
+  }
+
   clean();
 }
 
+TEST(sparse_matrix_test, transpose) {
+  clean();
+  const string tmp_file_t=tmp_file+"T";
+
+  vector<map<int,unsigned char> > mat(300);
+  for (int i=0;i<(int)mat.size();++i) {
+    int num=random()%50;
+    for (int j=0;j<num;++j)
+      mat[i][random()%2000]=random()%255+1;
+  }
+  mat[10].clear();
+
+  {
+    sparse_matrix_writer smw;
+    smw.open(tmp_file);
+    for (int i=0;i<(int)mat.size();++i) smw.append_row(mat[i]);
+    smw.close();
+  }
+
+  // small limit: hundreds of buckets, spilled in several passes
+  ASSERT_EQ(0,matrix_transpose(tmp_file,tmp_file_t,600,3));
+
+  {
+    vector<map<int,unsigned char> > expected;
+    for (int i=0;i<(int)mat.size();++i)
+      for (map<int,unsigned char>::iterator it=mat[i].begin();it!=mat[i].end();++it) {
+        if (it->first>=(int)expected.size()) expected.resize(it->first+1);
+        expected[it->first][i]=it->second;
+      }
+
+    sparse_matrix_reader smr;
+    ASSERT_EQ(0,smr.open(tmp_file_t));
+    ASSERT_EQ(expected.size(),size_t(smr.row_num()));
+    for (int i=0;i<(int)expected.size();++i) {
+      map<int,unsigned char> row;
+      smr.get_row(i,row);
+      EXPECT_TRUE(expected[i]==row);
+    }
+  }
+
+  EXPECT_NE(0,access((tmp_file_t+".bucket.0").c_str(),F_OK));
+  unlink(tmp_file_t.c_str());
+  unlink((tmp_file_t+".offset").c_str());
+  clean();
+}
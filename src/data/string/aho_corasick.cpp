@@ -31,132 +31,422 @@
 
 #include "aho_corasick.h"
 
-#include <stack>
-#include <algorithm>
+#include <climits>
+#include <cstdio>
 #include <cstring>
+#include <fstream>
+#include <queue>
+#include <algorithm>
+
+#include "../../concurrent/parallel.h"
+#include "../../lang/bind.h"
 
 using namespace std;
+using pfi::concurrent::parallel_run;
 
 namespace pfi{
 namespace data{
 namespace string{
 
-aho_corasick::aho_corasick(const vector<std::string> &words)
+namespace{
+
+struct word_less{
+  explicit word_less(const vector<std::string> &words): words(words) {}
+  bool operator()(int a, int b) const {
+    int c=words[a].compare(words[b]);
+    return c<0 || (c==0 && a<b);
+  }
+  const vector<std::string> &words;
+};
+
+// order[bounds[k],bounds[k+1]) is sorted by thread k, then sorted
+// ranges are merged pairwise, each round in parallel
+void sort_part(int k, const vector<size_t> *bounds, vector<int> *order,
+               const vector<std::string> *words)
+{
+  sort(order->begin()+(*bounds)[k], order->begin()+(*bounds)[k+1], word_less(*words));
+}
+
+void merge_part(int k, int width, const vector<size_t> *bounds, vector<int> *order,
+                const vector<std::string> *words)
+{
+  int n=bounds->size()-1;
+  int b=k*2*width, m=min(b+width, n), e=min(b+2*width, n);
+  inplace_merge(order->begin()+(*bounds)[b], order->begin()+(*bounds)[m],
+                order->begin()+(*bounds)[e], word_less(*words));
+}
+
+void parallel_sort(vector<int> &order, const vector<std::string> &words, int threads)
+{
+  int n=max(1, min<int>(threads, order.size()/65536));
+  vector<size_t> bounds(n+1);
+  for (int k=0;k<=n;k++)
+    bounds[k]=order.size()*k/n;
+
+  parallel_run(n, pfi::lang::bind(&sort_part, pfi::lang::_1, &bounds, &order, &words));
+  for (int width=1;width<n;width*=2)
+    parallel_run((n+2*width-1)/(2*width),
+                 pfi::lang::bind(&merge_part, pfi::lang::_1, width, &bounds, &order, &words));
+}
+
+const char file_magic[4]={'p','A','C','1'};
+const uint32_t byte_order_mark=0x01020304;
+
+// levels smaller than this are linked by a single thread
+const size_t parallel_level_size=4096;
+
+} // anonymous namespace
+
+aho_corasick::aho_corasick()
+  : mapped_nodes(NULL), mapped_depth(NULL), mapped_size(0)
 {
-  vector<pair<std::string, int> > ixwords;
+}
+
+aho_corasick::aho_corasick(const vector<std::string> &words, int threads)
+  : mapped_nodes(NULL), mapped_depth(NULL), mapped_size(0)
+{
+  vector<int> order(words.size());
   for (size_t i=0;i<words.size();i++)
-    ixwords.push_back(make_pair(words[i], i));
-  sort(ixwords.begin(), ixwords.end());
-  construct(ixwords);
+    order[i]=i;
+  parallel_sort(order, words, threads);
+  construct(words, order, threads);
 }
 
-void aho_corasick::construct(const vector<pair<std::string, int> > &words)
+// empty slots of the double array, in index order
+struct aho_corasick::free_list{
+  free_list(): head(-1), tail(-1) {}
+
+  void extend(int from, int to){
+    next.resize(to);
+    prev.resize(to);
+    trials.resize(to);
+    for (int p=from;p<to;p++){
+      prev[p]=tail;
+      next[p]=-1;
+      if (tail>=0) next[tail]=p;
+      else head=p;
+      tail=p;
+    }
+  }
+
+  void erase(int p){
+    if (trials[p]>max_trials) return;
+    trials[p]=max_trials+1;
+    if (prev[p]>=0) next[prev[p]]=next[p];
+    else head=next[p];
+    if (next[p]>=0) prev[next[p]]=prev[p];
+    else tail=prev[p];
+  }
+
+  // slots that failed this many times are left for non-first children only
+  static const int max_trials=16;
+
+  std::vector<int> next, prev;
+  std::vector<unsigned char> trials;
+  int head, tail;
+};
+
+void aho_corasick::reserve(int size, free_list &fl)
 {
-  if (words.empty()) return;
+  if (size<=(int)nodes.size()) return;
+  int old=nodes.size();
+  nodes.resize(max(size, old*2));
+  fl.extend(old, nodes.size());
+}
 
-  // create double array trie
-  int tbl[256]={};
-  int children[256]={};
-  int children_num=0;
-
-  int bef_base=1;
-
-  stack<pair<pair<int, int>, pair<int,int> > > ss;
-  ss.push(make_pair(make_pair(0,0), make_pair(0,words.size())));
-
-  nodes.resize(257);
-
-  while(!ss.empty()){
-    int pos=ss.top().first.first;
-    int dep=ss.top().first.second;
-    int ix=ss.top().second.first;
-    int n=ss.top().second.second;
-    ss.pop();
-
-    memset(tbl, 0, sizeof(tbl));
-    children_num=0;
-    
-    if ((int)words[ix].first.length()==dep)
-      nodes[pos].output=words[ix].second;
-    
-    for (int i=0;i<n;i++){
-      int c=dep<(int)words[ix+i].first.length()?(unsigned char)words[ix+i].first[dep]:0;
-      if (tbl[c]++==0)
-        children[children_num++]=c;
+int aho_corasick::find_base(const int *labels, int num, free_list &fl)
+{
+  // the tail of the array is always free, so this terminates
+  for (int p=fl.head, next;;p=next){
+    reserve(p+257, fl);
+    next=fl.next[p];
+
+    int base=p-labels[0];
+    bool ok=base>=1;
+    for (int i=1;ok && i<num;i++)
+      ok=nodes[base+labels[i]].check<0;
+    if (ok) return base;
+
+    if (++fl.trials[p]==free_list::max_trials){
+      fl.erase(p);
+      next=fl.next[p];
     }
+  }
+}
+
+void aho_corasick::construct(const vector<std::string> &words, const vector<int> &order, int threads)
+{
+  if (order.empty()) return;
 
-    int base=max(1, bef_base-32);
-    for (;;base++){
-      bool ok=true;
-      for (int ci=children[0]==0?1:0;ci<children_num;ci++){
-        int i=children[ci];
-        if (nodes[base+i].check>=0){
-          ok=false;
-          break;
+  // create double array trie
+  struct range{
+    int pos, dep, ix, n;
+  };
+
+  // children of each node as first-child / next-sibling slots,
+  // used to build failure links without scanning all 256 labels
+  vector<int> child, sibling;
+
+  // nodes are placed in breadth first order, which keeps the
+  // frequently visited shallow part of the trie close together
+  {
+    int labels[256];
+    int counts[256];
+    free_list fl;
+
+    nodes.resize(1);
+    reserve(512, fl);
+    queue<range> que;
+    range root={0, 0, 0, (int)order.size()};
+    que.push(root);
+
+    while(!que.empty()){
+      range r=que.front();
+      que.pop();
+
+      // words ending here sort first; the smallest id wins among duplicates.
+      // the empty word is never reported
+      int ix=r.ix, end=r.ix+r.n;
+      if ((int)words[order[ix]].length()==r.dep){
+        if (r.dep>0) nodes[r.pos].output=order[ix];
+        while(ix<end && (int)words[order[ix]].length()==r.dep) ix++;
+      }
+
+      int num=0;
+      for (int i=ix;i<end;i++){
+        int c=(unsigned char)words[order[i]][r.dep];
+        if (num==0 || labels[num-1]!=c){
+          labels[num]=c;
+          counts[num++]=0;
         }
+        counts[num-1]++;
       }
-      if (ok) break;
-    }
+      if (num==0) continue; // leaf: base 0 never matches
 
-    nodes[pos].base=base;
-    for (int cur=0, ci=0;ci<children_num;ci++){
-      int i=children[ci];
-      if (i>0 && tbl[i]>0){
-        int nix=nodes[pos].base+i;
-        if (nix+256>=(int)nodes.size()) nodes.resize(nix+256);
-        nodes[nix].check=pos;
-        ss.push(make_pair(make_pair(nix, dep+1), make_pair(ix+cur, tbl[i])));
+      int base=find_base(labels, num, fl);
+      nodes[r.pos].base=base;
+      if (nodes.size()>child.size()){
+        child.resize(nodes.size(), 0);
+        sibling.resize(nodes.size(), 0);
       }
-      cur+=tbl[i];
-    }
 
-    bef_base=base;
-  }
-
-  // create failure link
-  vector<int> q(nodes.size());
-  int qh=0,qt=0;
-  q[qt++]=0;
-  while (qh!=qt) {
-    int pos=q[qh++];
-    if (pos>0 && nodes[nodes[pos].fail].output!=-1 && nodes[pos].output==-1)
-      nodes[pos].output=-2;
-    
-    for (int i=0;i<256;++i) {
-      if (nodes[nodes[pos].base+i].check!=pos)
-        continue;
-
-      int m=nodes[pos].fail;
-      while (m>=0 && nodes[nodes[m].base+i].check!=m) m=nodes[m].fail;
-      if (m>=0) nodes[nodes[pos].base+i].fail=nodes[m].base+i;
-      else nodes[nodes[pos].base+i].fail=0;
-      q[qt++]=nodes[pos].base+i;
+      child[r.pos]=base+labels[0];
+      for (int i=0;i<num;i++){
+        int nix=base+labels[i];
+        nodes[nix].check=r.pos;
+        fl.erase(nix);
+        if (i+1<num) sibling[nix]=base+labels[i+1];
+        range next={nix, r.dep+1, ix, counts[i]};
+        que.push(next);
+        ix+=counts[i];
+      }
     }
   }
+
+  // trim unused tail, leaving room for every base+255
+  int size=1;
+  for (int i=0;i<(int)nodes.size();i++){
+    if (nodes[i].check>=0 || i==0)
+      size=max(size, max(i, nodes[i].base)+256);
+  }
+  nodes.resize(size);
+  child.resize(size, 0);
+  sibling.resize(size, 0);
+
+  link(child, sibling, threads);
   vector<node>(nodes).swap(nodes);
 }
 
-void aho_corasick::search(const std::string& s, vector<pair<int,int> >& res) const
+void aho_corasick::link(const vector<int> &child, const vector<int> &sibling, int threads)
 {
-  if (nodes.empty()) return;
+  // create failure link, one level at a time. a node only reads links
+  // of shallower nodes, so each level can be split among threads
+  depth.assign(nodes.size(), 0);
+  vector<int> level(1, 0);
+  while (!level.empty()){
+    int n=level.size()<parallel_level_size?1:max(threads, 1);
+    vector<vector<int> > next(n);
+    parallel_run(n, pfi::lang::bind(&aho_corasick::link_part, this, pfi::lang::_1, n,
+                                    &child, &sibling, &level, &next));
+    level.clear();
+    for (int k=0;k<n;k++)
+      level.insert(level.end(), next[k].begin(), next[k].end());
+  }
+}
 
-  int pos=0;
-  for (size_t i=0;i<s.size();++i) {
-    int c=(unsigned char)s[i];
-    while(pos>0 && nodes[nodes[pos].base+c].check!=pos) pos=nodes[pos].fail;
-    if (nodes[nodes[pos].base+c].check!=pos) continue;
-    pos=nodes[pos].base+c;
+void aho_corasick::link_part(int k, int n, const vector<int> *child, const vector<int> *sibling,
+                             const vector<int> *level, vector<vector<int> > *next)
+{
+  node *u=&nodes[0];
+  size_t from=level->size()*k/n, to=level->size()*(k+1)/n;
+  for (size_t i=from;i<to;i++){
+    int pos=(*level)[i];
+    for (int x=(*child)[pos];x!=0;x=(*sibling)[x]){
+      int c=x-u[pos].base;
+      int m=u[pos].fail;
+      while (m>=0 && u[u[m].base+c].check!=m) m=u[m].fail;
+      u[x].fail=m>=0?u[m].base+c:0;
+      depth[x]=depth[pos]+1;
 
-    if (nodes[pos].output!=-1) {
-      int cur=pos;
-      while(cur!=0) {
-        if (nodes[cur].output>=0) {
-          res.push_back(make_pair(nodes[cur].output,i+1)); // word ID and end word pos
-        }
-        cur=nodes[cur].fail;
+      if (u[x].output<0){
+        int h=next_output(u, u[x].fail);
+        u[x].output=h>0?-2-h:-1;
       }
+      (*next)[k].push_back(x);
+    }
+  }
+}
+
+int aho_corasick::save(const std::string &fn) const
+{
+  ofstream ofs(fn.c_str(), ios::binary);
+  if (!ofs){
+    fprintf(stderr, "aho_corasick::save: cannot open %s\n", fn.c_str());
+    return -1;
+  }
+
+  uint64_t size=mm?mapped_size:nodes.size();
+  ofs.write(file_magic, sizeof(file_magic));
+  ofs.write((const char*)&byte_order_mark, sizeof(byte_order_mark));
+  ofs.write((const char*)&size, sizeof(size));
+  if (size>0){
+    ofs.write((const char*)node_data(), size*sizeof(node));
+    ofs.write((const char*)depth_data(), size*sizeof(int));
+  }
+  if (!ofs){
+    fprintf(stderr, "aho_corasick::save: cannot write %s\n", fn.c_str());
+    return -1;
+  }
+  return 0;
+}
+
+int aho_corasick::open(const std::string &fn)
+{
+  pfi::lang::shared_ptr<pfi::system::mmapper::mmapper> m(new pfi::system::mmapper::mmapper());
+  if (m->open(fn)<0){
+    fprintf(stderr, "aho_corasick::open: cannot map %s\n", fn.c_str());
+    return -1;
+  }
+
+  const size_t header=sizeof(file_magic)+sizeof(uint32_t)+sizeof(uint64_t);
+  const uint64_t record=sizeof(node)+sizeof(int);
+  uint64_t size=0;
+  uint32_t mark=0;
+  if (m->size()>=header){
+    memcpy(&mark, m->begin()+4, sizeof(mark));
+    memcpy(&size, m->begin()+8, sizeof(size));
+  }
+  if (m->size()<header || memcmp(m->begin(), file_magic, sizeof(file_magic))!=0 ||
+      (m->size()-header)%record!=0 || size!=(m->size()-header)/record){
+    fprintf(stderr, "aho_corasick::open: %s is not an automaton file\n", fn.c_str());
+    return -1;
+  }
+  if (mark!=byte_order_mark){
+    fprintf(stderr, "aho_corasick::open: %s was saved with another byte order\n", fn.c_str());
+    return -1;
+  }
+  const node *u=(const node*)(m->begin()+header);
+  const int *d=(const int*)(m->begin()+header+size*sizeof(node));
+  if (size>0 && !valid(u, d, size)){
+    fprintf(stderr, "aho_corasick::open: %s is broken\n", fn.c_str());
+    return -1;
+  }
+
+  vector<node>().swap(nodes);
+  vector<int>().swap(depth);
+  mm.reset();
+  mapped_nodes=NULL;
+  mapped_depth=NULL;
+  mapped_size=0;
+  if (size==0) return 0;
+
+  mm=m;
+  mapped_nodes=u;
+  mapped_depth=d;
+  mapped_size=size;
+  return 0;
+}
+
+// every index search follows must stay inside the automaton, parents
+// and failure links must lead to the root, and outputs must be words
+bool aho_corasick::valid(const node *u, const int *depth, uint64_t size)
+{
+  if (size<256 || size>uint64_t(INT_MAX) || depth[0]!=0)
+    return false;
+  const int n=size;
+  for (int i=0;i<n;i++){
+    if (u[i].base<0 || u[i].base>n-256 || u[i].check<-1)
+      return false;
+    if (i==0 || u[i].check<0)
+      continue;
+
+    int p=u[i].check, f=u[i].fail, o=u[i].output;
+    if (p>=n || (p!=0 && u[p].check<0) || i-u[p].base<0 || i-u[p].base>255 ||
+        depth[i]<1 || depth[i]-1!=depth[p])
+      return false;
+    if (f<0 || f>=n || (f!=0 && u[f].check<0) || depth[f]>=depth[i])
+      return false;
+    if (o<=-2){
+      int h=-2-o;
+      if (h<=0 || h>=n || u[h].check<0 || u[h].output<0 || depth[h]>=depth[i])
+        return false;
     }
   }
+  return true;
+}
+
+aho_corasick::state::state(match_type type)
+  : type(type)
+{
+  reset();
+}
+
+void aho_corasick::state::reset()
+{
+  node=0;
+  pos=0;
+  cand_id=-1;
+  cand_begin=cand_end=0;
+  replay.clear();
+  replay_pos=0;
+}
+
+void aho_corasick::restart(state &st, int last, int c) const
+{
+  // text after the candidate is the tail of the path to last, followed by c
+  size_t len=st.pos-st.cand_end;
+  st.buf.resize(len);
+  const node *u=node_data();
+  for (size_t i=len;i>0 && last>0;i--) {
+    int parent=u[last].check;
+    st.buf[i-1]=last-u[parent].base;
+    last=parent;
+  }
+  if (c>=0) st.buf+=(char)c;
+  st.buf.append(st.replay, st.replay_pos, std::string::npos);
+  st.replay.swap(st.buf);
+  st.replay_pos=0;
+
+  st.node=0;
+  st.pos=st.cand_end;
+  st.cand_id=-1;
+}
+
+namespace{
+
+struct collect_end{
+  explicit collect_end(vector<pair<int,int> > &res): res(res) {}
+  void operator()(int id, uint64_t, uint64_t end) {
+    res.push_back(make_pair(id, (int)end)); // word ID and end word pos
+  }
+  vector<pair<int,int> > &res;
+};
+
+} // anonymous namespace
+
+void aho_corasick::search(const std::string& s, vector<pair<int,int> >& res) const
+{
+  search(s.data(), s.size(), collect_end(res));
 }
 
 } // string
@@ -34,6 +34,11 @@
 
 #include <vector>
 #include <string>
+#include <istream>
+#include <stdint.h>
+
+#include "../../lang/shared_ptr.h"
+#include "../../system/mmapper.h"
 
 namespace pfi{
 namespace data{
@@ -41,14 +46,66 @@ namespace string{
 
 class aho_corasick{
 public:
-  explicit aho_corasick(const std::vector<std::string> &words);
+  aho_corasick();
+  explicit aho_corasick(const std::vector<std::string> &words, int threads=1);
+
+  // build once with save(), then open() maps the file without rebuilding.
+  // the file is "pAC1", a uint32 byte order mark, the uint64 node count,
+  // then the nodes and depths as raw host structs, so it is only portable
+  // between hosts of the same byte order; open() rejects the other one
+  // and files whose links point outside of the automaton.
+  int save(const std::string &fn) const;
+  int open(const std::string &fn);
+
+  enum match_type{
+    all_matches,      // every occurrence, possibly overlapping
+    non_overlapping,  // the longest match ending first, then restart after it
+    leftmost_longest  // the longest match starting first, then restart after it
+  };
+
+  // automaton state carried over chunks of a stream
+  class state{
+  public:
+    explicit state(match_type type=all_matches);
+
+    void reset();
+    uint64_t offset() const { return pos; }
+
+  private:
+    friend class aho_corasick;
+
+    match_type type;
+    int node;
+    uint64_t pos;
+
+    // leftmost_longest: match not yet known to be final, and text to rescan
+    int cand_id;
+    uint64_t cand_begin, cand_end;
+    std::string replay, buf;
+    size_t replay_pos;
+  };
 
   // res: vector of pair ("word id",  pos of end of word)
   void search(const std::string& s, std::vector<std::pair<int,int> >& res) const;
 
-private:
-  void construct(const std::vector<std::pair<std::string, int> > &words);
+  // f(int id, uint64_t begin, uint64_t end) is called for each match.
+  // Offsets count from the beginning of the stream.
+  template <class F>
+  void search(const char *s, size_t n, F f, match_type type=all_matches) const;
+  template <class F>
+  void search(std::istream &is, F f, match_type type=all_matches) const;
 
+  // feed the next chunk of a stream. f is copied, so keep its results
+  // outside of it. finish() reports a pending match and resets st.
+  template <class F>
+  void search(state &st, const char *s, size_t n, F f) const;
+  template <class F>
+  void finish(state &st, F f) const;
+
+private:
+  // pos --c--> base+c iff nodes[base+c].check==pos.
+  // output >=0: word id, -1: no output on the failure chain,
+  // <=-2: -2-(nearest node with an output on the failure chain)
   struct node{
     node(): base(0), check(-1), fail(-1), output(-1) {}
     int base;
@@ -57,9 +114,165 @@ private:
     int fail;
     int output;
   };
+
+  void construct(const std::vector<std::string> &words, const std::vector<int> &order, int threads);
+  struct free_list;
+  void reserve(int size, free_list &fl);
+  int find_base(const int *labels, int num, free_list &fl);
+
+  void link(const std::vector<int> &child, const std::vector<int> &sibling, int threads);
+  void link_part(int k, int n, const std::vector<int> *child, const std::vector<int> *sibling,
+                 const std::vector<int> *level, std::vector<std::vector<int> > *next);
+
+  const node *node_data() const;
+  const int *depth_data() const;
+  static int transition(const node *u, int pos, unsigned char c);
+  static int next_output(const node *u, int pos);
+  static bool valid(const node *u, const int *depth, uint64_t size);
+
+  template <class F>
+  void step_leftmost(state &st, unsigned char c, F &f) const;
+  void restart(state &st, int last, int c) const;
+
   std::vector<node> nodes;
+  std::vector<int> depth;
+
+  // set when the automaton is opened from a file
+  pfi::lang::shared_ptr<pfi::system::mmapper::mmapper> mm;
+  const node *mapped_nodes;
+  const int *mapped_depth;
+  uint64_t mapped_size;
 };
 
+inline const aho_corasick::node *aho_corasick::node_data() const
+{
+  if (mm) return mapped_nodes;
+  return nodes.empty()?NULL:&nodes[0];
+}
+
+inline const int *aho_corasick::depth_data() const
+{
+  if (mm) return mapped_depth;
+  return depth.empty()?NULL:&depth[0];
+}
+
+inline int aho_corasick::transition(const node *u, int pos, unsigned char c)
+{
+  for (;;) {
+    int nix=u[pos].base+c;
+    if (u[nix].check==pos) return nix;
+    if (pos==0) return 0;
+    pos=u[pos].fail;
+  }
+}
+
+inline int aho_corasick::next_output(const node *u, int pos)
+{
+  if (pos<=0) return 0;
+  int o=u[pos].output;
+  if (o>=0) return pos;
+  if (o==-1) return 0;
+  return -2-o;
+}
+
+template <class F>
+void aho_corasick::search(const char *s, size_t n, F f, match_type type) const
+{
+  state st(type);
+  search(st, s, n, f);
+  finish(st, f);
+}
+
+template <class F>
+void aho_corasick::search(std::istream &is, F f, match_type type) const
+{
+  state st(type);
+  char buf[64*1024];
+  while (is) {
+    is.read(buf, sizeof(buf));
+    search(st, buf, is.gcount(), f);
+  }
+  finish(st, f);
+}
+
+template <class F>
+void aho_corasick::search(state &st, const char *s, size_t n, F f) const
+{
+  const node *u=node_data();
+  const int *depth=depth_data();
+  if (u==NULL) {
+    st.pos+=n;
+    return;
+  }
+
+  if (st.type==leftmost_longest) {
+    for (size_t i=0;i<n;++i) {
+      step_leftmost(st, s[i], f);
+      while (st.replay_pos<st.replay.size())
+        step_leftmost(st, st.replay[st.replay_pos++], f);
+    }
+    return;
+  }
+
+  int pos=st.node;
+  for (size_t i=0;i<n;++i) {
+    pos=transition(u, pos, s[i]);
+    if (u[pos].output==-1) continue;
+
+    uint64_t end=st.pos+i+1;
+    if (st.type==all_matches) {
+      for (int cur=next_output(u, pos);cur>0;cur=next_output(u, u[cur].fail))
+        f(u[cur].output, end-depth[cur], end);
+    } else {
+      int cur=next_output(u, pos);
+      f(u[cur].output, end-depth[cur], end);
+      pos=0;
+    }
+  }
+  st.node=pos;
+  st.pos+=n;
+}
+
+template <class F>
+void aho_corasick::finish(state &st, F f) const
+{
+  while (st.cand_id>=0) {
+    f(st.cand_id, st.cand_begin, st.cand_end);
+    restart(st, st.node, -1);
+    while (st.replay_pos<st.replay.size())
+      step_leftmost(st, st.replay[st.replay_pos++], f);
+  }
+  st.reset();
+}
+
+template <class F>
+void aho_corasick::step_leftmost(state &st, unsigned char c, F &f) const
+{
+  const node *u=node_data();
+  const int *depth=depth_data();
+  int pos=transition(u, st.node, c);
+  uint64_t end=st.pos+1;
+
+  // no later match can start at or before the candidate
+  if (st.cand_id>=0 && end-depth[pos]>st.cand_begin) {
+    f(st.cand_id, st.cand_begin, st.cand_end);
+    restart(st, st.node, c);
+    return;
+  }
+
+  st.node=pos;
+  st.pos=end;
+  int cur=next_output(u, pos);
+  if (cur>0) {
+    uint64_t begin=end-depth[cur];
+    if (st.cand_id<0 || begin<=st.cand_begin) {
+      st.cand_id=u[cur].output;
+      st.cand_begin=begin;
+      st.cand_end=end;
+    }
+  }
+}
+
 } // string
 } // data
 } // pficommon
@@ -34,7 +34,12 @@
 #include "aho_corasick.h"
 
 #include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <iterator>
+#include <sstream>
+
+#include <unistd.h>
 
 using namespace std;
 using namespace pfi::data::string;
@@ -82,6 +87,325 @@ TEST(aho_corasick_test, test)
   EXPECT_EQ(8, ret[3].second);
 }
 
+namespace{
+
+vector<pair<int,int> > naive_search(const vector<string>& dict, const string& s)
+{
+  // the smallest id is reported for duplicated words
+  vector<pair<int,int> > ret;
+  for (size_t i=0;i<dict.size();i++){
+    if (dict[i].empty() || find(dict.begin(), dict.end(), dict[i])-dict.begin()!=(int)i)
+      continue;
+    for (size_t p=s.find(dict[i]);p!=string::npos;p=s.find(dict[i], p+1))
+      ret.push_back(make_pair((int)i, (int)(p+dict[i].size())));
+  }
+  sort(ret.begin(), ret.end());
+  return ret;
+}
+
+// id of the word s[b,e), -1 if none
+int find_word(const vector<string>& dict, const string& s, size_t b, size_t e)
+{
+  for (size_t i=0;i<dict.size();i++)
+    if (!dict[i].empty() && s.compare(b, e-b, dict[i])==0) return i;
+  return -1;
+}
+
+typedef pair<int,pair<uint64_t,uint64_t> > match;
+
+vector<match> naive_search(const vector<string>& dict, const string& s,
+                           aho_corasick::match_type type)
+{
+  vector<match> ret;
+  for (size_t i=0;i<s.size();){
+    bool found=false;
+    if (type==aho_corasick::non_overlapping){
+      for (size_t e=i+1;e<=s.size() && !found;e++){
+        for (size_t b=i;b<e && !found;b++){
+          int id=find_word(dict, s, b, e);
+          if (id<0) continue;
+          ret.push_back(make_pair(id, make_pair((uint64_t)b, (uint64_t)e)));
+          i=e;
+          found=true;
+        }
+      }
+    } else {
+      for (size_t b=i;b<s.size() && !found;b++){
+        for (size_t e=s.size();e>b && !found;e--){
+          int id=find_word(dict, s, b, e);
+          if (id<0) continue;
+          ret.push_back(make_pair(id, make_pair((uint64_t)b, (uint64_t)e)));
+          i=e;
+          found=true;
+        }
+      }
+    }
+    if (!found) break;
+  }
+  return ret;
+}
+
+struct collect{
+  explicit collect(vector<match>& ret): ret(ret) {}
+  void operator()(int id, uint64_t b, uint64_t e){
+    ret.push_back(make_pair(id, make_pair(b, e)));
+  }
+  vector<match>& ret;
+};
+
+} // namespace
+
+TEST(aho_corasick_test, random)
+{
+  srandom(time(NULL));
+  for (int t=0;t<20;t++){
+    vector<string> dict;
+    int n=random()%200+1;
+    for (int i=0;i<n;i++){
+      string w;
+      int len=random()%6;
+      for (int j=0;j<len;j++) w+=(char)(random()%(t%2?4:256));
+      dict.push_back(w);
+    }
+    if (n>2) dict.push_back(dict[n/2]);
+
+    string s;
+    for (int j=0;j<1000;j++) s+=(char)(random()%(t%2?4:256));
+
+    aho_corasick ac(dict);
+    vector<pair<int,int> > ret;
+    ac.search(s, ret);
+    sort(ret.begin(), ret.end());
+    vector<pair<int,int> > expect=naive_search(dict, s);
+    EXPECT_TRUE(expect==ret);
+  }
+}
+
+TEST(aho_corasick_test, match_type)
+{
+  vector<string> dict;
+  dict.push_back("abcd");
+  dict.push_back("bc");
+  dict.push_back("cdef");
+  dict.push_back("ab");
+  aho_corasick ac(dict);
+
+  string s="abcdefg";
+  vector<match> ret;
+  ac.search(s.data(), s.size(), collect(ret), aho_corasick::leftmost_longest);
+  ASSERT_EQ(1U, ret.size());
+  EXPECT_EQ(0, ret[0].first);
+  EXPECT_EQ(0U, ret[0].second.first);
+  EXPECT_EQ(4U, ret[0].second.second);
+
+  ret.clear();
+  ac.search(s.data(), s.size(), collect(ret), aho_corasick::non_overlapping);
+  ASSERT_EQ(2U, ret.size());
+  EXPECT_EQ(3, ret[0].first);
+  EXPECT_EQ(2U, ret[0].second.second);
+  EXPECT_EQ(2, ret[1].first);
+  EXPECT_EQ(6U, ret[1].second.second);
+
+  ret.clear();
+  ac.search(s.data(), s.size(), collect(ret));
+  EXPECT_EQ(4U, ret.size());
+}
+
+TEST(aho_corasick_test, stream)
+{
+  srandom(time(NULL));
+  for (int t=0;t<50;t++){
+    vector<string> dict;
+    int n=random()%50+1;
+    for (int i=0;i<n;i++){
+      string w;
+      int len=random()%6;
+      for (int j=0;j<len;j++) w+=(char)('a'+random()%3);
+      dict.push_back(w);
+    }
+    string s;
+    for (int j=0;j<300;j++) s+=(char)('a'+random()%3);
+    aho_corasick ac(dict);
+
+    for (int type=0;type<3;type++){
+      aho_corasick::match_type mt=(aho_corasick::match_type)type;
+      vector<match> whole;
+      ac.search(s.data(), s.size(), collect(whole), mt);
+
+      // random chunk boundaries give the same matches
+      vector<match> chunked;
+      aho_corasick::state st(mt);
+      for (size_t b=0;b<s.size();){
+        size_t len=min<size_t>(random()%8, s.size()-b);
+        ac.search(st, s.data()+b, len, collect(chunked));
+        b+=len;
+      }
+      ac.finish(st, collect(chunked));
+      EXPECT_TRUE(whole==chunked);
+
+      if (mt!=aho_corasick::all_matches){
+        vector<match> expect=naive_search(dict, s, mt);
+        EXPECT_TRUE(expect==whole);
+      } else {
+        vector<pair<int,int> > ends, expect=naive_search(dict, s);
+        for (size_t i=0;i<whole.size();i++){
+          ends.push_back(make_pair(whole[i].first, (int)whole[i].second.second));
+          EXPECT_EQ(dict[whole[i].first].size(), whole[i].second.second-whole[i].second.first);
+        }
+        sort(ends.begin(), ends.end());
+        EXPECT_TRUE(expect==ends);
+      }
+    }
+
+    istringstream is(s);
+    vector<match> from_stream, whole;
+    ac.search(is, collect(from_stream), aho_corasick::leftmost_longest);
+    ac.search(s.data(), s.size(), collect(whole), aho_corasick::leftmost_longest);
+    EXPECT_TRUE(whole==from_stream);
+  }
+}
+
+TEST(aho_corasick_test, save_open)
+{
+  const char* fn="./tmp_aho_corasick";
+
+  srandom(time(NULL));
+  vector<string> dict;
+  for (int i=0;i<200000;i++){
+    string w;
+    int len=random()%8+1;
+    for (int j=0;j<len;j++) w+=(char)('a'+random()%4);
+    dict.push_back(w);
+  }
+  string s;
+  for (int j=0;j<10000;j++) s+=(char)('a'+random()%4);
+
+  aho_corasick ac(dict);
+  vector<pair<int,int> > expect;
+  ac.search(s, expect);
+
+  // parallel failure links give the same automaton
+  aho_corasick pac(dict, 4);
+  vector<pair<int,int> > ret;
+  pac.search(s, ret);
+  EXPECT_TRUE(expect==ret);
+
+  ASSERT_EQ(0, ac.save(fn));
+  aho_corasick mac;
+  ASSERT_EQ(0, mac.open(fn));
+  ret.clear();
+  mac.search(s, ret);
+  EXPECT_TRUE(expect==ret);
+
+  // a copy shares the mapping
+  aho_corasick cac(mac);
+  mac=aho_corasick();
+  vector<match> lm, expect_lm;
+  cac.search(s.data(), s.size(), collect(lm), aho_corasick::leftmost_longest);
+  ac.search(s.data(), s.size(), collect(expect_lm), aho_corasick::leftmost_longest);
+  EXPECT_TRUE(expect_lm==lm);
+
+  {
+    ofstream ofs(fn);
+    ofs<<"broken";
+  }
+  EXPECT_EQ(-1, mac.open(fn));
+
+  // empty automaton
+  ASSERT_EQ(0, aho_corasick(vector<string>()).save(fn));
+  ASSERT_EQ(0, mac.open(fn));
+  ret.clear();
+  mac.search(s, ret);
+  EXPECT_TRUE(ret.empty());
+
+  unlink(fn);
+}
+
+namespace {
+
+void write_file(const char *fn, const string &data)
+{
+  ofstream ofs(fn, ios::binary);
+  ofs<<data;
+}
+
+} // namespace
+
+TEST(aho_corasick_test, open_corrupt)
+{
+  const char* fn="./tmp_aho_corasick_corrupt";
+  vector<string> dict;
+  dict.push_back("he");
+  dict.push_back("she");
+  dict.push_back("his");
+  dict.push_back("hers");
+  ASSERT_EQ(0, aho_corasick(dict).save(fn));
+
+  string data;
+  {
+    ifstream ifs(fn, ios::binary);
+    data.assign(istreambuf_iterator<char>(ifs), istreambuf_iterator<char>());
+  }
+  // "pAC1", byte order mark, size, nodes {base, check, fail, output}, depths
+  const size_t header=16, node_size=4*sizeof(int);
+  uint64_t size;
+  memcpy(&size, &data[8], sizeof(size));
+  ASSERT_EQ(header+size*(node_size+sizeof(int)), data.size());
+
+  aho_corasick ac;
+  write_file(fn, data);
+  EXPECT_EQ(0, ac.open(fn));
+
+  {
+    string d=data;
+    reverse(d.begin()+4, d.begin()+8);
+    write_file(fn, d);
+    EXPECT_EQ(-1, ac.open(fn));
+  }
+  {
+    // the old size*record check wrapped around for this size
+    string d=data;
+    uint64_t wrapped=size+(uint64_t(1)<<62);
+    memcpy(&d[8], &wrapped, sizeof(wrapped));
+    write_file(fn, d);
+    EXPECT_EQ(-1, ac.open(fn));
+  }
+  {
+    write_file(fn, data.substr(0, data.size()-1));
+    EXPECT_EQ(-1, ac.open(fn));
+  }
+  for (int field=0;field<4;field++){
+    // the first used node other than the root gets an out of range link
+    string d=data;
+    for (size_t i=1;i<size;i++){
+      int check;
+      memcpy(&check, &d[header+i*node_size+sizeof(int)], sizeof(check));
+      if (check<0) continue;
+      int bad=field==3 ? -2-(1<<30) : 1<<30;
+      memcpy(&d[header+i*node_size+field*sizeof(int)], &bad, sizeof(bad));
+      break;
+    }
+    write_file(fn, d);
+    EXPECT_EQ(-1, ac.open(fn)) << field;
+  }
+  {
+    // a failure link to itself would never reach the root
+    string d=data;
+    for (size_t i=1;i<size;i++){
+      int check;
+      memcpy(&check, &d[header+i*node_size+sizeof(int)], sizeof(check));
+      if (check<0) continue;
+      int self=i;
+      memcpy(&d[header+i*node_size+2*sizeof(int)], &self, sizeof(self));
+      break;
+    }
+    write_file(fn, d);
+    EXPECT_EQ(-1, ac.open(fn));
+  }
+
+  unlink(fn);
+}
+
 TEST(aho_corasick_test, bench)
 {
   ifstream ifs("/usr/share/dict/words");
@@ -35,33 +35,294 @@
 #include <vector>
 #include <algorithm>
 #include <climits>
+#include <type_traits>
+
+#include <stdint.h>
 
 namespace pfi {
 namespace data {
 namespace string {
 
+namespace detail {
+
+  // common prefix and suffix are removed before the measures below,
+  // since they change neither of them.
   template<typename A>
-    int edit_distance(const A& a, const A& b){
-    std::vector<std::vector<int> > tbl(a.size()+1,std::vector<int>(b.size()+1));
-    for (size_t i=0;i<=a.size();++i) tbl[i][0]=i;
-    for (size_t i=0;i<=b.size();++i) tbl[0][i]=i;
-    for (size_t i=1;i<=a.size();++i)
-      for (size_t j=1;j<=b.size();++j) {
-        tbl[i][j]=tbl[i-1][j-1]+(a[i-1]!=b[j-1]);
-        tbl[i][j]=std::min(tbl[i][j],std::min(tbl[i-1][j],tbl[i][j-1])+1);
+  size_t trim_common(const A& a, const A& b, size_t& n, size_t& m) {
+    size_t off=0;
+    n=a.size(); m=b.size();
+    while (off<n && off<m && a[off]==b[off]) ++off;
+    n-=off; m-=off;
+    while (n>0 && m>0 && a[off+n-1]==b[off+m-1]) --n, --m;
+    return off;
+  }
+
+  // match bit vectors of a pattern, in 64 bit words per symbol.
+  // symbols absent from the pattern get an all-zero vector.
+  template<typename T>
+  class match_table {
+  public:
+    template<typename A>
+    match_table(const A& p, size_t off, size_t m)
+      : w((m+63)/64), syms(sym_local), bits(bit_local) {
+      if (sizeof(T)!=1 && m>local_size) {
+        sym_vec.resize(m);
+        syms=&sym_vec[0];
       }
-    return tbl[a.size()][b.size()];
+      if (sizeof(T)==1) {
+        // bytes are numbered in order of appearance, without sorting
+        std::fill(index,index+256,absent);
+        num=0;
+        for (size_t i=0;i<m;++i) {
+          unsigned short& ix=index[static_cast<unsigned char>(p[off+i])];
+          if (ix==absent) ix=num++;
+        }
+      } else {
+        for (size_t i=0;i<m;++i) syms[i]=p[off+i];
+        std::sort(syms,syms+m);
+        num=std::unique(syms,syms+m)-syms;
+      }
+
+      size_t nbits=(num+1)*w;
+      if (nbits>local_size+1) {
+        bit_vec.resize(nbits);
+        bits=&bit_vec[0];
+      } else {
+        std::fill(bits,bits+nbits,0);
+      }
+      for (size_t i=0;i<m;++i)
+        bits[id(p[off+i])*w+i/64]|=uint64_t(1)<<(i%64);
+    }
+
+    const uint64_t* operator()(const T& c) const { return bits+id(c)*w; }
+    size_t words() const { return w; }
+
+  private:
+    match_table(const match_table&);
+    match_table& operator=(const match_table&);
+
+    size_t id(const T& c) const {
+      if (sizeof(T)==1) return std::min<size_t>(index[static_cast<unsigned char>(c)],num);
+      size_t i=std::lower_bound(syms,syms+num,c)-syms;
+      return i<num && syms[i]==c ? i : num;
+    }
+
+    static const size_t local_size=64;
+    static const unsigned short absent=0xffff;
+
+    size_t w, num;
+    T* syms;
+    uint64_t* bits;
+    T sym_local[local_size];
+    uint64_t bit_local[local_size+1];
+    std::vector<T> sym_vec;
+    std::vector<uint64_t> bit_vec;
+    unsigned short index[256];
+  };
+
+  // Ukkonen's band of width 2k+1 with a single row over the shorter
+  // string p. values are capped at k+1, which is returned as soon as a
+  // whole row exceeds k.
+  template<typename A>
+  int banded_edit_distance(const A& p, const A& t, size_t off, size_t m, size_t n, int k) {
+    const int inf=k+1;
+    const size_t band=k;
+    std::vector<int> row(m+1);
+    for (size_t j=0;j<=m;++j) row[j]=j<=band ? int(j) : inf;
+    for (size_t i=1;i<=n;++i) {
+      size_t lo=i>band ? i-band : 1, hi=std::min(m,i+band);
+      int diag=row[lo-1];
+      row[lo-1]=lo==1 && i<=band ? int(i) : inf;
+      int best=row[lo-1];
+      for (size_t j=lo;j<=hi;++j) {
+        int v=std::min(diag+(t[off+i-1]!=p[off+j-1]),std::min(row[j],row[j-1])+1);
+        diag=row[j];
+        row[j]=std::min(v,inf);
+        best=std::min(best,row[j]);
+      }
+      if (best>k) return inf;
+    }
+    return std::min(row[m],inf);
   }
 
+  // Myers' bit-parallel algorithm for a pattern p of at most 64 symbols.
+  // gives up with k+1 once the remaining text cannot bring the score to k.
   template<typename A>
-    int longest_common_subsequence(const A& a, const A& b) {
-    std::vector<std::vector<int> > tbl(a.size()+1,std::vector<int>(b.size()+1));
-    for (size_t i=1;i<=a.size();++i)
-      for (size_t j=1;j<=b.size();++j) {
-        tbl[i][j]=tbl[i-1][j-1]+(a[i-1]==b[j-1]);
-        tbl[i][j]=std::max(tbl[i][j],std::max(tbl[i-1][j],tbl[i][j-1]));
+  int myers_edit_distance(const A& p, const A& t, size_t off, size_t m, size_t n, int k) {
+    typedef typename A::value_type T;
+    match_table<T> peq(p,off,m);
+    const uint64_t top=uint64_t(1)<<(m-1);
+    uint64_t pv=~uint64_t(0), mv=0;
+    int score=m;
+    for (size_t j=0;j<n;++j) {
+      uint64_t eq=*peq(t[off+j]);
+      uint64_t xv=eq|mv;
+      uint64_t xh=(((eq&pv)+pv)^pv)|eq;
+      uint64_t ph=mv|~(xh|pv);
+      uint64_t mh=pv&xh;
+      if (ph&top) ++score;
+      else if (mh&top) --score;
+      ph=(ph<<1)|1;
+      mh<<=1;
+      pv=mh|~(xv|ph);
+      mv=ph&xv;
+      if (score-int(n-j-1)>k) return k+1;
+    }
+    return std::min(score,k+1);
+  }
+
+  // Myers' algorithm over 64 symbol blocks of a longer pattern,
+  // passing the horizontal delta of each block to the one below.
+  template<typename A>
+  int block_edit_distance(const A& p, const A& t, size_t off, size_t m, size_t n, int k) {
+    typedef typename A::value_type T;
+    match_table<T> peq(p,off,m);
+    const size_t w=peq.words();
+    const uint64_t last=uint64_t(1)<<((m-1)%64), top=uint64_t(1)<<63;
+    std::vector<uint64_t> pvs(w,~uint64_t(0)), mvs(w,0);
+    int score=m;
+    for (size_t j=0;j<n;++j) {
+      const uint64_t* eqs=peq(t[off+j]);
+      int hin=1;
+      for (size_t b=0;b<w;++b) {
+        uint64_t pv=pvs[b], mv=mvs[b], eq=eqs[b];
+        uint64_t xv=eq|mv;
+        if (hin<0) eq|=1;
+        uint64_t xh=(((eq&pv)+pv)^pv)|eq;
+        uint64_t ph=mv|~(xh|pv);
+        uint64_t mh=pv&xh;
+        const uint64_t hb=b+1==w ? last : top;
+        int hout=(ph&hb) ? 1 : (mh&hb) ? -1 : 0;
+        ph<<=1;
+        mh<<=1;
+        if (hin<0) mh|=1;
+        else if (hin>0) ph|=1;
+        pvs[b]=mh|~(xv|ph);
+        mvs[b]=ph&xv;
+        hin=hout;
+      }
+      score+=hin;
+      if (score-int(n-j-1)>k) return k+1;
+    }
+    return std::min(score,k+1);
+  }
+
+  template<typename A>
+  int edit_distance_kernel(const A& p, const A& t, size_t off, size_t m, size_t n, int k,
+                           std::false_type) {
+    return banded_edit_distance(p,t,off,m,n,k);
+  }
+
+  template<typename A>
+  int edit_distance_kernel(const A& p, const A& t, size_t off, size_t m, size_t n, int k,
+                           std::true_type) {
+    if (m<=64) return myers_edit_distance(p,t,off,m,n,k);
+    // a narrow band does fewer cell updates than all the blocks
+    if (size_t(2*k+1)<16*((m+63)/64)) return banded_edit_distance(p,t,off,m,n,k);
+    return block_edit_distance(p,t,off,m,n,k);
+  }
+
+  template<typename A>
+  int bounded_edit_distance(const A& a, const A& b, int k) {
+    size_t n, m;
+    size_t off=trim_common(a,b,n,m);
+    const A* t=&a;
+    const A* p=&b;
+    if (n<m) {
+      std::swap(n,m);
+      std::swap(t,p);
+    }
+    if (n-m>size_t(k)) return k+1;
+    if (m==0) return n;
+    return edit_distance_kernel(*p,*t,off,m,n,k,
+                                std::is_arithmetic<typename A::value_type>());
+  }
+
+
+  // bit-parallel LCS by Allison and Dix, with carries across words
+  template<typename A>
+  int bit_parallel_lcs(const A& p, const A& t, size_t off, size_t m, size_t n) {
+    typedef typename A::value_type T;
+    match_table<T> peq(p,off,m);
+    const size_t w=peq.words();
+    std::vector<uint64_t> v(w,~uint64_t(0));
+    for (size_t j=0;j<n;++j) {
+      const uint64_t* eqs=peq(t[off+j]);
+      uint64_t carry=0;
+      for (size_t b=0;b<w;++b) {
+        uint64_t u=v[b]&eqs[b];
+        uint64_t s=v[b]+u;
+        uint64_t c=s<v[b];
+        s+=carry;
+        carry=c|(s<carry);
+        v[b]=s|(v[b]&~eqs[b]);
       }
-    return tbl[a.size()][b.size()];
+    }
+    int ones=0;
+    for (size_t b=0;b<w;++b) {
+      uint64_t x=v[b];
+      if (b+1==w && m%64) x&=(uint64_t(1)<<(m%64))-1;
+      ones+=__builtin_popcountll(x);
+    }
+    return m-ones;
+  }
+
+  // single row over the shorter string p
+  template<typename A>
+  int row_lcs(const A& p, const A& t, size_t off, size_t m, size_t n) {
+    std::vector<int> row(m+1);
+    for (size_t i=1;i<=n;++i) {
+      int diag=0;
+      for (size_t j=1;j<=m;++j) {
+        int up=row[j];
+        row[j]=t[off+i-1]==p[off+j-1] ? diag+1 : std::max(up,row[j-1]);
+        diag=up;
+      }
+    }
+    return row[m];
+  }
+
+  template<typename A>
+  int lcs_kernel(const A& p, const A& t, size_t off, size_t m, size_t n, std::false_type) {
+    return row_lcs(p,t,off,m,n);
+  }
+
+  template<typename A>
+  int lcs_kernel(const A& p, const A& t, size_t off, size_t m, size_t n, std::true_type) {
+    return bit_parallel_lcs(p,t,off,m,n);
+  }
+
+} // detail
+
+  // sequences of arithmetic types (char, uchar, int, ...) use the
+  // bit-parallel algorithms; others fall back to O(min(n,m)) memory DP.
+  template<typename A>
+    int edit_distance(const A& a, const A& b){
+    return detail::bounded_edit_distance(a,b,std::max(a.size(),b.size()));
+  }
+
+  // edit distance if it is at most k, k+1 otherwise.
+  // much faster than edit_distance for a small k.
+  template<typename A>
+  int edit_distance_within(const A& a, const A& b, int k){
+    if (k<0) return 0;
+    return detail::bounded_edit_distance(a,b,std::min<size_t>(k,std::max(a.size(),b.size())));
+  }
+
+  template<typename A>
+    int longest_common_subsequence(const A& a, const A& b) {
+    size_t n, m;
+    size_t off=detail::trim_common(a,b,n,m);
+    int common=a.size()-n;
+    const A* t=&a;
+    const A* p=&b;
+    if (n<m) {
+      std::swap(n,m);
+      std::swap(t,p);
+    }
+    if (m==0) return common;
+    return common+detail::lcs_kernel(*p,*t,off,m,n,
+                                     std::is_arithmetic<typename A::value_type>());
   }
 
   template<typename A>
@@ -34,6 +34,8 @@
 #include "./algorithm.h"
 
 #include <algorithm>
+#include <cstdlib>
+#include <string>
 #include <vector>
 
 using namespace std;
@@ -77,6 +79,99 @@ TEST(algorithm_test, longest_common_subsequence) {
   }
 }
 
+namespace {
+
+template<typename A>
+int edit_distance_reference(const A& a, const A& b) {
+  vector<vector<int> > tbl(a.size()+1,vector<int>(b.size()+1));
+  for (size_t i=0;i<=a.size();++i) tbl[i][0]=i;
+  for (size_t i=0;i<=b.size();++i) tbl[0][i]=i;
+  for (size_t i=1;i<=a.size();++i)
+    for (size_t j=1;j<=b.size();++j)
+      tbl[i][j]=min(tbl[i-1][j-1]+(a[i-1]!=b[j-1]),min(tbl[i-1][j],tbl[i][j-1])+1);
+  return tbl[a.size()][b.size()];
+}
+
+template<typename A>
+int lcs_reference(const A& a, const A& b) {
+  vector<vector<int> > tbl(a.size()+1,vector<int>(b.size()+1));
+  for (size_t i=1;i<=a.size();++i)
+    for (size_t j=1;j<=b.size();++j)
+      tbl[i][j]=max(tbl[i-1][j-1]+(a[i-1]==b[j-1]),max(tbl[i-1][j],tbl[i][j-1]));
+  return tbl[a.size()][b.size()];
+}
+
+// a random string, or a random edit of base
+string random_string(const string& base, int alpha) {
+  string ret;
+  if (base.empty() || rand()%4==0) {
+    int n=rand()%200;
+    for (int i=0;i<n;++i) ret+=char('a'+rand()%alpha);
+    return ret;
+  }
+  ret=base;
+  int edits=rand()%10;
+  for (int i=0;i<edits;++i) {
+    size_t pos=rand()%(ret.size()+1);
+    switch (rand()%3) {
+    case 0: ret.insert(pos,1,char('a'+rand()%alpha)); break;
+    case 1: if (pos<ret.size()) ret.erase(pos,1); break;
+    default: if (pos<ret.size()) ret[pos]=char('a'+rand()%alpha); break;
+    }
+  }
+  return ret;
+}
+
+} // namespace
+
+TEST(algorithm_test, edit_distance_random) {
+  srand(1);
+  string prev;
+  for (int t=0;t<3000;++t) {
+    string s=random_string(prev,1+t%8), u=random_string(s,1+t%8);
+    prev=s;
+    int d=edit_distance_reference(s,u);
+    ASSERT_EQ(d,edit_distance(s,u)) << s << " " << u;
+    ASSERT_EQ(d,edit_distance(u,s));
+    for (int k=0;k<=12;k+=3)
+      ASSERT_EQ(min(d,k+1),edit_distance_within(s,u,k)) << s << " " << u << " " << k;
+    ASSERT_EQ(lcs_reference(s,u),longest_common_subsequence(s,u)) << s << " " << u;
+
+    // wider symbols use a sorted table, others the row DP
+    vector<int> vs(s.begin(),s.end()), vu(u.begin(),u.end());
+    ASSERT_EQ(d,edit_distance(vs,vu));
+    ASSERT_EQ(min(d,5),edit_distance_within(vs,vu,4));
+    vector<string> ss(s.size()), su(u.size());
+    for (size_t i=0;i<s.size();++i) ss[i]=string(1,s[i]);
+    for (size_t i=0;i<u.size();++i) su[i]=string(1,u[i]);
+    ASSERT_EQ(d,edit_distance(ss,su));
+    ASSERT_EQ(min(d,3),edit_distance_within(ss,su,2));
+    ASSERT_EQ(lcs_reference(s,u),longest_common_subsequence(ss,su));
+  }
+}
+
+TEST(algorithm_test, edit_distance_long) {
+  srand(2);
+  string s;
+  for (int i=0;i<10000;++i) s+=char('a'+rand()%26);
+  string u=s;
+  u[100]='#';
+  u.erase(5000,3);
+  u.insert(9000,"##");
+  EXPECT_EQ(6,edit_distance(s,u));
+  EXPECT_EQ(6,edit_distance_within(s,u,10));
+  EXPECT_EQ(6,edit_distance_within(s,u,1000));
+  EXPECT_EQ(4,edit_distance_within(s,u,3));
+  EXPECT_EQ(9996,longest_common_subsequence(s,u));
+
+  string r;
+  for (int i=0;i<3000;++i) r+=char('a'+rand()%26);
+  string q;
+  for (int i=0;i<2000;++i) q+=char('a'+rand()%26);
+  EXPECT_EQ(edit_distance_reference(r,q),edit_distance(r,q));
+  EXPECT_EQ(lcs_reference(r,q),longest_common_subsequence(r,q));
+}
+
 TEST(algorithm_test, longest_increasing_subsequence) {
   {
     string s="";
@@ -0,0 +1,296 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "similarity_search.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "algorithm.h"
+#include "../functional_hash.h"
+#include "../../concurrent/parallel.h"
+#include "../../lang/bind.h"
+
+using namespace std;
+using pfi::concurrent::parallel_run;
+
+namespace pfi{
+namespace data{
+namespace string{
+
+namespace{
+
+// (distance, id) order of results
+bool match_less(const pair<int,int> &a, const pair<int,int> &b)
+{
+  if (a.second!=b.second) return a.second<b.second;
+  return a.first<b.first;
+}
+
+// queries are interleaved over threads, since their costs vary with length
+void search_part(int t, int threads, const edit_distance_index *ix,
+                 const vector<std::string> *qs, int k,
+                 vector<vector<pair<int,int> > > *res)
+{
+  for (size_t i=t;i<qs->size();i+=threads)
+    ix->search((*qs)[i], k, (*res)[i]);
+}
+
+void nearest_part(int t, int threads, const edit_distance_index *ix,
+                  const vector<std::string> *qs, size_t n,
+                  vector<vector<pair<int,int> > > *res)
+{
+  for (size_t i=t;i<qs->size();i+=threads)
+    ix->nearest((*qs)[i], n, (*res)[i]);
+}
+
+} // anonymous namespace
+
+edit_distance_index::edit_distance_index()
+  : tau(0)
+{
+}
+
+edit_distance_index::edit_distance_index(const vector<std::string> &strs, int max_distance)
+  : strs(strs), tau(max(max_distance, 0)), short_ids(tau+1)
+{
+  vector<pair<uint64_t, int> > segs;
+  for (size_t id=0;id<strs.size();++id) {
+    const std::string &s=strs[id];
+    if (s.size()<=size_t(tau)) {
+      short_ids[s.size()].push_back(id);
+      continue;
+    }
+    for (int i=0;i<=tau;++i) {
+      size_t pos, n;
+      segment(s.size(), i, pos, n);
+      segs.push_back(make_pair(segment_key(s.size(), i, s.data()+pos, n), int(id)));
+    }
+  }
+  sort(segs.begin(), segs.end());
+
+  ids.resize(segs.size());
+  for (size_t i=0;i<segs.size();++i) {
+    if (i==0 || segs[i].first!=segs[i-1].first) {
+      keys.push_back(segs[i].first);
+      starts.push_back(i);
+    }
+    ids[i]=segs[i].second;
+  }
+  starts.push_back(segs.size());
+
+  size_t cap=16;
+  while (cap<2*keys.size()) cap*=2;
+  slots.assign(cap, -1);
+  for (size_t i=0;i<keys.size();++i) {
+    size_t h=keys[i]&(cap-1);
+    while (slots[h]>=0) h=(h+1)&(cap-1);
+    slots[h]=i;
+  }
+}
+
+// len is split into tau+1 segments, the last len%(tau+1) of them one longer
+void edit_distance_index::segment(size_t len, int seg, size_t &pos, size_t &n) const
+{
+  const size_t parts=tau+1, base=len/parts, longer=len%parts, shorter=parts-longer;
+  pos=seg*base+(size_t(seg)>shorter ? seg-shorter : 0);
+  n=base+(size_t(seg)>=shorter ? 1 : 0);
+}
+
+uint64_t edit_distance_index::segment_key(size_t len, int seg, const char *p, size_t n) const
+{
+  return hash_bytes(p, n, uint64_t(len)*(tau+1)+seg);
+}
+
+const int *edit_distance_index::postings(uint64_t key, const int *&end) const
+{
+  const size_t mask=slots.size()-1;
+  for (size_t h=key&mask;slots[h]>=0;h=(h+1)&mask) {
+    int i=slots[h];
+    if (keys[i]==key) {
+      end=&ids[0]+starts[i+1];
+      return &ids[0]+starts[i];
+    }
+  }
+  end=NULL;
+  return NULL;
+}
+
+void edit_distance_index::candidates(const std::string &q, int k, vector<int> &res) const
+{
+  res.clear();
+  const int m=q.size();
+  for (int len=max(m-k, 0);len<=m+k;++len) {
+    if (len<=tau) {
+      res.insert(res.end(), short_ids[len].begin(), short_ids[len].end());
+      continue;
+    }
+    if (slots.empty()) continue;
+
+    // multi-match-aware window: segment i of a string within tau starts
+    // at most i before or after its own position, and the edits left for
+    // the other segments bound the shift by the length difference
+    const int delta=m-len;
+    for (int i=0;i<=tau;++i) {
+      size_t pos, n;
+      segment(len, i, pos, n);
+      int lo=max(int(pos)-i, int(pos)+delta-(tau-i));
+      int hi=min(int(pos)+i, int(pos)+delta+(tau-i));
+      lo=max(lo, 0);
+      hi=min(hi, m-int(n));
+      for (int s=lo;s<=hi;++s) {
+        const int *end;
+        const int *p=postings(segment_key(len, i, q.data()+s, n), end);
+        if (p) res.insert(res.end(), p, end);
+      }
+    }
+  }
+}
+
+void edit_distance_index::search(const std::string &q, int k, vector<pair<int,int> > &res) const
+{
+  res.clear();
+  k=min(k, tau);
+  if (k<0) return;
+
+  vector<int> cand;
+  candidates(q, k, cand);
+  sort(cand.begin(), cand.end());
+  cand.erase(unique(cand.begin(), cand.end()), cand.end());
+
+  for (size_t i=0;i<cand.size();++i) {
+    int d=edit_distance_within(q, strs[cand[i]], k);
+    if (d<=k) res.push_back(make_pair(cand[i], d));
+  }
+  sort(res.begin(), res.end(), match_less);
+}
+
+void edit_distance_index::nearest(const std::string &q, size_t n, vector<pair<int,int> > &res) const
+{
+  res.clear();
+  if (n==0) return;
+
+  vector<int> cand;
+  candidates(q, tau, cand);
+
+  // the length difference bounds the distance from below, so the
+  // candidates are verified in its order and the search stops once it
+  // exceeds the n-th best distance so far
+  vector<pair<int,int> > order;
+  order.reserve(cand.size());
+  for (size_t i=0;i<cand.size();++i)
+    order.push_back(make_pair(abs(int(strs[cand[i]].size())-int(q.size())), cand[i]));
+  sort(order.begin(), order.end());
+  order.erase(unique(order.begin(), order.end()), order.end());
+
+  // max heap of (distance, id) of the best n
+  vector<pair<int,int> > best;
+  int bound=tau;
+  for (size_t i=0;i<order.size() && order[i].first<=bound;++i) {
+    int id=order[i].second;
+    int d=edit_distance_within(q, strs[id], bound);
+    if (d>bound) continue;
+    pair<int,int> m(d, id);
+    if (best.size()==n) {
+      if (!(m<best.front())) continue;
+      pop_heap(best.begin(), best.end());
+      best.pop_back();
+    }
+    best.push_back(m);
+    push_heap(best.begin(), best.end());
+    if (best.size()==n) bound=best.front().first;
+  }
+
+  sort(best.begin(), best.end());
+  for (size_t i=0;i<best.size();++i)
+    res.push_back(make_pair(best[i].second, best[i].first));
+}
+
+void edit_distance_index::search(const vector<std::string> &qs, int k,
+                                 vector<vector<pair<int,int> > > &res, int threads) const
+{
+  res.assign(qs.size(), vector<pair<int,int> >());
+  threads=max(threads, 1);
+  parallel_run(threads, pfi::lang::bind(&search_part, pfi::lang::_1, threads, this, &qs, k, &res));
+}
+
+void edit_distance_index::nearest(const vector<std::string> &qs, size_t n,
+                                  vector<vector<pair<int,int> > > &res, int threads) const
+{
+  res.assign(qs.size(), vector<pair<int,int> >());
+  threads=max(threads, 1);
+  parallel_run(threads, pfi::lang::bind(&nearest_part, pfi::lang::_1, threads, this, &qs, n, &res));
+}
+
+void edit_distance_index::join_part(int t, int threads, int k,
+                                    vector<vector<similar_pair> > *parts) const
+{
+  vector<similar_pair> &out=(*parts)[t];
+  vector<int> cand;
+  for (size_t i=t;i<strs.size();i+=threads) {
+    candidates(strs[i], k, cand);
+    // each pair is verified once, from its first string
+    cand.erase(remove_if(cand.begin(), cand.end(),
+                         pfi::lang::bind(less_equal<int>(), pfi::lang::_1, int(i))),
+               cand.end());
+    sort(cand.begin(), cand.end());
+    cand.erase(unique(cand.begin(), cand.end()), cand.end());
+    for (size_t j=0;j<cand.size();++j) {
+      int d=edit_distance_within(strs[i], strs[cand[j]], k);
+      if (d<=k) out.push_back(similar_pair(i, cand[j], d));
+    }
+  }
+}
+
+void edit_distance_index::self_join(int k, vector<similar_pair> &res, int threads) const
+{
+  res.clear();
+  k=min(k, tau);
+  if (k<0) return;
+  threads=max(threads, 1);
+
+  vector<vector<similar_pair> > parts(threads);
+  parallel_run(threads, pfi::lang::bind(&edit_distance_index::join_part, this,
+                                        pfi::lang::_1, threads, k, &parts));
+  for (int t=0;t<threads;++t)
+    res.insert(res.end(), parts[t].begin(), parts[t].end());
+  sort(res.begin(), res.end());
+}
+
+void similarity_join(const vector<std::string> &strs, int k,
+                     vector<similar_pair> &res, int threads)
+{
+  edit_distance_index(strs, k).self_join(k, res, threads);
+}
+
+} // string
+} // data
+} // pfi
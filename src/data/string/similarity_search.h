@@ -0,0 +1,126 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INCLUDE_GUARD_PFI_DATA_STRING_SIMILARITY_SEARCH_H_
+#define INCLUDE_GUARD_PFI_DATA_STRING_SIMILARITY_SEARCH_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+namespace pfi{
+namespace data{
+namespace string{
+
+// a pair of strings (first<second) within some edit distance
+struct similar_pair{
+  similar_pair(): first(0), second(0), distance(0) {}
+  similar_pair(int first, int second, int distance)
+    : first(first), second(second), distance(distance) {}
+
+  bool operator==(const similar_pair &p) const {
+    return first==p.first && second==p.second && distance==p.distance;
+  }
+  bool operator<(const similar_pair &p) const {
+    if (first!=p.first) return first<p.first;
+    return second<p.second;
+  }
+
+  int first, second;
+  int distance;
+};
+
+// edit distance search over a fixed list of strings.
+//
+// strings longer than max_distance are split into max_distance+1
+// segments (Pass-Join). a string within max_distance of a query shares
+// one of its segments with the query near the same position, so only
+// strings sharing a segment are verified, with edit_distance_within.
+// segments are indexed by hash; collisions only add candidates.
+class edit_distance_index{
+public:
+  edit_distance_index();
+  edit_distance_index(const std::vector<std::string> &strs, int max_distance);
+
+  int max_distance() const { return tau; }
+  size_t size() const { return strs.size(); }
+  const std::string &operator[](int id) const { return strs[id]; }
+
+  // res: (id, distance) of strings within distance k<=max_distance of q,
+  // sorted by distance, then id
+  void search(const std::string &q, int k, std::vector<std::pair<int,int> > &res) const;
+
+  // res: (id, distance) of the n nearest strings within max_distance of q,
+  // nearest first, ties broken by id
+  void nearest(const std::string &q, size_t n, std::vector<std::pair<int,int> > &res) const;
+
+  // the same for many queries, verified by the given number of threads
+  void search(const std::vector<std::string> &qs, int k,
+              std::vector<std::vector<std::pair<int,int> > > &res, int threads=1) const;
+  void nearest(const std::vector<std::string> &qs, size_t n,
+               std::vector<std::vector<std::pair<int,int> > > &res, int threads=1) const;
+
+  // all pairs of indexed strings within distance k<=max_distance,
+  // sorted by (first, second)
+  void self_join(int k, std::vector<similar_pair> &res, int threads=1) const;
+
+private:
+  uint64_t segment_key(size_t len, int seg, const char *p, size_t n) const;
+  void segment(size_t len, int seg, size_t &pos, size_t &n) const;
+  const int *postings(uint64_t key, const int *&end) const;
+
+  // ids of strings that may be within k of q, unsorted and with duplicates
+  void candidates(const std::string &q, int k, std::vector<int> &res) const;
+  void join_part(int t, int threads, int k, std::vector<std::vector<similar_pair> > *parts) const;
+
+  std::vector<std::string> strs;
+  int tau;
+
+  // strings of length <= tau, by length
+  std::vector<std::vector<int> > short_ids;
+
+  // ids[starts[i], starts[i+1]) have a segment of key keys[i].
+  // slots is an open addressing table of i, indexed by the key.
+  std::vector<uint64_t> keys;
+  std::vector<uint32_t> starts;
+  std::vector<int> ids;
+  std::vector<int> slots;
+};
+
+// all pairs of strs within edit distance k
+void similarity_join(const std::vector<std::string> &strs, int k,
+                     std::vector<similar_pair> &res, int threads=1);
+
+} // string
+} // data
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_DATA_STRING_SIMILARITY_SEARCH_H_
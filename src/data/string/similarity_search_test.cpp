@@ -0,0 +1,161 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include "similarity_search.h"
+#include "algorithm.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace pfi::data::string;
+
+namespace {
+
+vector<string> random_strings(size_t n, int alpha, int max_len)
+{
+  vector<string> ret;
+  for (size_t i=0;i<n;++i) {
+    if (!ret.empty() && rand()%2) {
+      // a few edits of an earlier string, so that there are close pairs
+      string s=ret[rand()%ret.size()];
+      for (int e=rand()%4;e>0;--e) {
+        size_t pos=rand()%(s.size()+1);
+        switch (rand()%3) {
+        case 0: s.insert(pos, 1, char('a'+rand()%alpha)); break;
+        case 1: if (pos<s.size()) s.erase(pos, 1); break;
+        default: if (pos<s.size()) s[pos]=char('a'+rand()%alpha); break;
+        }
+      }
+      ret.push_back(s);
+      continue;
+    }
+    string s;
+    for (int j=rand()%(max_len+1);j>0;--j) s+=char('a'+rand()%alpha);
+    ret.push_back(s);
+  }
+  return ret;
+}
+
+} // namespace
+
+TEST(similarity_search_test, search)
+{
+  vector<string> strs;
+  strs.push_back("hello");
+  strs.push_back("help");
+  strs.push_back("yellow");
+  strs.push_back("hell");
+  strs.push_back("");
+  strs.push_back("a");
+  edit_distance_index ix(strs, 2);
+  EXPECT_EQ(6u, ix.size());
+  EXPECT_EQ(2, ix.max_distance());
+
+  vector<pair<int,int> > res;
+  ix.search("hello", 1, res);
+  ASSERT_EQ(2u, res.size());
+  EXPECT_EQ(make_pair(0, 0), res[0]);
+  EXPECT_EQ(make_pair(3, 1), res[1]);
+
+  ix.search("b", 1, res);
+  ASSERT_EQ(2u, res.size());
+  EXPECT_EQ(make_pair(4, 1), res[0]);
+  EXPECT_EQ(make_pair(5, 1), res[1]);
+
+  ix.nearest("hellp", 2, res);
+  ASSERT_EQ(2u, res.size());
+  EXPECT_EQ(make_pair(0, 1), res[0]);
+  EXPECT_EQ(make_pair(1, 1), res[1]);
+
+  ix.nearest("zzzzzzzz", 3, res);
+  EXPECT_TRUE(res.empty());
+
+  vector<similar_pair> pairs;
+  similarity_join(strs, 1, pairs);
+  ASSERT_EQ(3u, pairs.size());
+  EXPECT_TRUE(similar_pair(0, 3, 1)==pairs[0]);
+  EXPECT_TRUE(similar_pair(1, 3, 1)==pairs[1]);
+  EXPECT_TRUE(similar_pair(4, 5, 1)==pairs[2]);
+}
+
+TEST(similarity_search_test, random)
+{
+  srand(1);
+  for (int t=0;t<20;++t) {
+    int tau=t%4;
+    vector<string> strs=random_strings(300, 2+t%5, 2+t%20);
+    vector<string> qs=random_strings(50, 2+t%5, 2+t%20);
+    qs.insert(qs.end(), strs.begin(), strs.begin()+20);
+    edit_distance_index ix(strs, tau);
+
+    vector<vector<pair<int,int> > > found, near;
+    ix.search(qs, tau, found, 3);
+    ix.nearest(qs, 5, near, 2);
+    for (size_t i=0;i<qs.size();++i) {
+      vector<pair<int,int> > exp;
+      for (size_t j=0;j<strs.size();++j) {
+        int d=edit_distance(qs[i], strs[j]);
+        if (d<=tau) exp.push_back(make_pair(d, int(j)));
+      }
+      sort(exp.begin(), exp.end());
+      ASSERT_EQ(exp.size(), found[i].size());
+      for (size_t j=0;j<exp.size();++j)
+        ASSERT_EQ(make_pair(exp[j].second, exp[j].first), found[i][j]);
+
+      exp.resize(min<size_t>(exp.size(), 5));
+      ASSERT_EQ(exp.size(), near[i].size());
+      for (size_t j=0;j<exp.size();++j)
+        ASSERT_EQ(make_pair(exp[j].second, exp[j].first), near[i][j]);
+
+      if (tau>0) {
+        vector<pair<int,int> > res;
+        ix.search(qs[i], tau-1, res);
+        size_t n=0;
+        while (n<found[i].size() && found[i][n].second<=tau-1) ++n;
+        ASSERT_EQ(n, res.size());
+      }
+    }
+
+    vector<similar_pair> pairs, exp_pairs;
+    ix.self_join(tau, pairs, 4);
+    for (size_t i=0;i<strs.size();++i)
+      for (size_t j=i+1;j<strs.size();++j) {
+        int d=edit_distance(strs[i], strs[j]);
+        if (d<=tau) exp_pairs.push_back(similar_pair(i, j, d));
+      }
+    ASSERT_TRUE(exp_pairs==pairs) << tau << " " << exp_pairs.size() << " " << pairs.size();
+  }
+}
@@ -0,0 +1,150 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INCLUDE_GUARD_PFI_DATA_STRING_STRING_VIEW_H_
+#define INCLUDE_GUARD_PFI_DATA_STRING_STRING_VIEW_H_
+
+#include <stddef.h>
+#include <algorithm>
+#include <ostream>
+#include <string>
+
+namespace pfi{
+namespace data{
+namespace string{
+
+// non-owning reference to a range of characters.
+// the referred string must outlive the view.
+template <class Char>
+class basic_string_view{
+public:
+  typedef Char value_type;
+  typedef const Char* iterator;
+  typedef const Char* const_iterator;
+  typedef size_t size_type;
+
+  static const size_type npos = static_cast<size_type>(-1);
+
+  basic_string_view(): p(NULL), n(0) {}
+  basic_string_view(const Char *p, size_type n): p(p), n(n) {}
+  basic_string_view(const Char *b, const Char *e): p(b), n(e-b) {}
+  basic_string_view(const Char *s): p(s), n(std::char_traits<Char>::length(s)) {}
+  basic_string_view(const std::basic_string<Char> &s): p(s.data()), n(s.size()) {}
+
+  const Char *data() const { return p; }
+  size_type size() const { return n; }
+  size_type length() const { return n; }
+  bool empty() const { return n==0; }
+
+  const Char *begin() const { return p; }
+  const Char *end() const { return p+n; }
+  const Char &operator[](size_type i) const { return p[i]; }
+  const Char &front() const { return p[0]; }
+  const Char &back() const { return p[n-1]; }
+
+  basic_string_view substr(size_type pos, size_type len=npos) const {
+    pos=std::min(pos, n);
+    return basic_string_view(p+pos, std::min(len, n-pos));
+  }
+
+  std::basic_string<Char> str() const { return std::basic_string<Char>(p, n); }
+
+  // for String types with a (begin, end) constructor, such as ustring
+  template <class String>
+  String to() const { return String(begin(), end()); }
+
+  int compare(basic_string_view s) const {
+    int c=std::char_traits<Char>::compare(p, s.p, std::min(n, s.n));
+    if (c!=0) return c;
+    return n<s.n?-1:n>s.n?1:0;
+  }
+
+private:
+  const Char *p;
+  size_type n;
+};
+
+template <class Char>
+const typename basic_string_view<Char>::size_type basic_string_view<Char>::npos;
+
+typedef basic_string_view<char> string_view;
+
+template <class Char>
+inline bool operator==(basic_string_view<Char> a, basic_string_view<Char> b)
+{
+  return a.size()==b.size() && std::char_traits<Char>::compare(a.data(), b.data(), a.size())==0;
+}
+
+template <class Char>
+inline bool operator!=(basic_string_view<Char> a, basic_string_view<Char> b)
+{
+  return !(a==b);
+}
+
+template <class Char>
+inline bool operator<(basic_string_view<Char> a, basic_string_view<Char> b)
+{
+  return a.compare(b)<0;
+}
+
+template <class Char>
+inline bool operator==(basic_string_view<Char> a, const std::basic_string<Char> &b)
+{
+  return a==basic_string_view<Char>(b);
+}
+
+template <class Char>
+inline bool operator==(const std::basic_string<Char> &a, basic_string_view<Char> b)
+{
+  return basic_string_view<Char>(a)==b;
+}
+
+template <class Char>
+inline bool operator!=(basic_string_view<Char> a, const std::basic_string<Char> &b)
+{
+  return !(a==b);
+}
+
+template <class Char>
+inline bool operator!=(const std::basic_string<Char> &a, basic_string_view<Char> b)
+{
+  return !(a==b);
+}
+
+inline std::ostream &operator<<(std::ostream &os, string_view s)
+{
+  return os.write(s.data(), s.size());
+}
+
+} // string
+} // data
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_DATA_STRING_STRING_VIEW_H_
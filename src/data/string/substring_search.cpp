@@ -0,0 +1,406 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "substring_search.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#define PFI_SUBSTRING_SEARCH_X86
+#endif
+
+using namespace std;
+
+namespace pfi{
+namespace data{
+namespace string{
+
+namespace{
+
+const size_t max_first_last=32;
+const size_t max_fingerprint=3;
+const int num_buckets=8;
+
+#ifdef PFI_SUBSTRING_SEARCH_X86
+bool detect_ssse3()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("ssse3");
+}
+
+const bool has_ssse3=detect_ssse3();
+
+// start of the first 16 byte window in [i, end) having a position whose
+// fingerprint may belong to some bucket, or the first window not scanned.
+// the bucket bits of each position of the window are stored to cand.
+__attribute__((target("ssse3")))
+size_t teddy_scan(const unsigned char *masks, size_t fp_len,
+                  const unsigned char *s, size_t i, size_t end,
+                  unsigned char *cand, unsigned int &bits)
+{
+  const __m128i low=_mm_set1_epi8(0x0f);
+  const __m128i zero=_mm_setzero_si128();
+  __m128i lo[max_fingerprint], hi[max_fingerprint];
+  for (size_t k=0;k<fp_len;++k) {
+    lo[k]=_mm_loadu_si128(reinterpret_cast<const __m128i*>(masks+32*k));
+    hi[k]=_mm_loadu_si128(reinterpret_cast<const __m128i*>(masks+32*k+16));
+  }
+
+  for (;i+16<=end;i+=16) {
+    __m128i res=_mm_set1_epi8(-1);
+    for (size_t k=0;k<fp_len;++k) {
+      const __m128i c=_mm_loadu_si128(reinterpret_cast<const __m128i*>(s+i+k));
+      const __m128i l=_mm_shuffle_epi8(lo[k], _mm_and_si128(c, low));
+      const __m128i h=_mm_shuffle_epi8(hi[k], _mm_and_si128(_mm_srli_epi16(c, 4), low));
+      res=_mm_and_si128(res, _mm_and_si128(l, h));
+    }
+    bits=~_mm_movemask_epi8(_mm_cmpeq_epi8(res, zero))&0xffff;
+    if (bits) {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(cand), res);
+      return i;
+    }
+  }
+  bits=0;
+  return i;
+}
+#endif
+
+struct prefix_less{
+  prefix_less(const vector<std::string> &needles, size_t len): needles(needles), len(len) {}
+  bool operator()(int a, int b) const {
+    int c=needles[a].compare(0, len, needles[b], 0, len);
+    return c<0 || (c==0 && a<b);
+  }
+  const vector<std::string> &needles;
+  size_t len;
+};
+
+struct longer_first{
+  explicit longer_first(const vector<std::string> &needles): needles(needles) {}
+  bool operator()(int a, int b) const {
+    if (needles[a].size()!=needles[b].size())
+      return needles[a].size()>needles[b].size();
+    return a<b;
+  }
+  const vector<std::string> &needles;
+};
+
+} // namespace
+
+substring_searcher::substring_searcher()
+  : algo(none), suffix(0), period(0), periodic(false), fp_len(0), min_len(0)
+{
+}
+
+substring_searcher::substring_searcher(const std::string &needle)
+  : needles(1, needle), algo(none), suffix(0), period(0), periodic(false),
+    fp_len(0), min_len(needle.size())
+{
+  if (needle.empty()) algo=empty_needle;
+  else if (needle.size()==1) algo=single_byte;
+  else if (needle.size()<=max_first_last) algo=first_last;
+  else init_two_way();
+}
+
+substring_searcher::substring_searcher(const std::vector<std::string> &needles)
+  : needles(needles), algo(none), suffix(0), period(0), periodic(false),
+    fp_len(0), min_len(0)
+{
+  if (needles.size()==1) *this=substring_searcher(needles[0]);
+  else if (needles.size()>1) init_multi();
+}
+
+void substring_searcher::init_two_way()
+{
+  // critical factorization of Crochemore and Perrin: the larger of the
+  // maximal suffixes for both orders of bytes
+  const unsigned char *p=reinterpret_cast<const unsigned char*>(needles[0].data());
+  const size_t m=needles[0].size();
+
+  size_t ms=size_t(-1), j=0, k=1, p1=1;
+  while (j+k<m) {
+    unsigned char a=p[j+k], b=p[ms+k];
+    if (a<b) { j+=k; k=1; p1=j-ms; }
+    else if (a==b) { if (k!=p1) ++k; else { j+=p1; k=1; } }
+    else { ms=j++; k=p1=1; }
+  }
+
+  size_t ms_rev=size_t(-1), p2=1;
+  j=0; k=1;
+  while (j+k<m) {
+    unsigned char a=p[j+k], b=p[ms_rev+k];
+    if (b<a) { j+=k; k=1; p2=j-ms_rev; }
+    else if (a==b) { if (k!=p2) ++k; else { j+=p2; k=1; } }
+    else { ms_rev=j++; k=p2=1; }
+  }
+
+  if (ms_rev+1<ms+1) {
+    suffix=ms+1;
+    period=p1;
+  } else {
+    suffix=ms_rev+1;
+    period=p2;
+  }
+
+  periodic=memcmp(p, p+period, suffix)==0;
+  if (!periodic) period=max(suffix, m-suffix)+1;
+
+  shift.assign(256, m);
+  for (size_t i=0;i<m;++i) shift[p[i]]=m-i-1;
+  algo=two_way;
+}
+
+void substring_searcher::init_multi()
+{
+  algo=multi;
+  min_len=needles[0].size();
+  for (size_t i=1;i<needles.size();++i) min_len=min(min_len, needles[i].size());
+  if (min_len==0) return;
+  fp_len=min(min_len, max_fingerprint);
+
+  // needles sharing a fingerprint go to the same bucket
+  vector<int> order(needles.size());
+  for (size_t i=0;i<order.size();++i) order[i]=i;
+  sort(order.begin(), order.end(), prefix_less(needles, fp_len));
+
+  buckets.assign(num_buckets, vector<int>());
+  nibble_mask.assign(32*fp_len, 0);
+  byte_mask.assign(256*fp_len, 0);
+  for (size_t r=0;r<order.size();++r) {
+    int b=r*num_buckets/order.size();
+    const std::string &s=needles[order[r]];
+    buckets[b].push_back(order[r]);
+    for (size_t k=0;k<fp_len;++k) {
+      unsigned char c=s[k];
+      nibble_mask[32*k+(c&15)]|=1<<b;
+      nibble_mask[32*k+16+(c>>4)]|=1<<b;
+      byte_mask[256*k+c]|=1<<b;
+    }
+  }
+  for (int b=0;b<num_buckets;++b)
+    sort(buckets[b].begin(), buckets[b].end(), longer_first(needles));
+}
+
+size_t substring_searcher::find(const char *s, size_t n, size_t offset, int *id) const
+{
+  if (offset>n) return std::string::npos;
+
+  size_t pos=std::string::npos;
+  switch (algo) {
+  case none:
+    return std::string::npos;
+  case empty_needle:
+    pos=offset;
+    break;
+  case single_byte: {
+    const void *p=memchr(s+offset, needles[0][0], n-offset);
+    if (p) pos=static_cast<const char*>(p)-s;
+    break;
+  }
+  case first_last:
+    pos=find_first_last(s, n, offset);
+    break;
+  case two_way:
+    pos=find_two_way(s, n, offset);
+    break;
+  case multi:
+    return find_multi(s, n, offset, id);
+  }
+  if (id && pos!=std::string::npos) *id=0;
+  return pos;
+}
+
+size_t substring_searcher::find_first_last(const char *s, size_t n, size_t offset) const
+{
+  const std::string &p=needles[0];
+  const size_t m=p.size();
+  if (n-offset<m) return std::string::npos;
+
+  const char *h=s+offset;
+  const size_t last=n-offset-m;
+  size_t i=0;
+
+#ifdef PFI_SUBSTRING_SEARCH_X86
+  const __m128i first_byte=_mm_set1_epi8(p[0]);
+  const __m128i last_byte=_mm_set1_epi8(p[m-1]);
+  for (;i+16<=last+1;i+=16) {
+    const __m128i a=_mm_loadu_si128(reinterpret_cast<const __m128i*>(h+i));
+    const __m128i b=_mm_loadu_si128(reinterpret_cast<const __m128i*>(h+i+m-1));
+    unsigned int mask=_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first_byte),
+                                                      _mm_cmpeq_epi8(b, last_byte)));
+    while (mask) {
+      size_t j=i+__builtin_ctz(mask);
+      if (memcmp(h+j+1, p.data()+1, m-2)==0) return offset+j;
+      mask&=mask-1;
+    }
+  }
+#endif
+
+  while (i<=last) {
+    const void *q=memchr(h+i, p[0], last-i+1);
+    if (!q) break;
+    i=static_cast<const char*>(q)-h;
+    if (h[i+m-1]==p[m-1] && memcmp(h+i+1, p.data()+1, m-2)==0) return offset+i;
+    ++i;
+  }
+  return std::string::npos;
+}
+
+size_t substring_searcher::find_two_way(const char *s, size_t n, size_t offset) const
+{
+  const unsigned char *p=reinterpret_cast<const unsigned char*>(needles[0].data());
+  const unsigned char *h=reinterpret_cast<const unsigned char*>(s+offset);
+  const size_t m=needles[0].size(), len=n-offset;
+  if (len<m) return std::string::npos;
+
+  size_t j=0;
+  if (periodic) {
+    // memory: bytes of the left part already known to match
+    size_t memory=0;
+    while (j<=len-m) {
+      size_t sh=shift[h[j+m-1]];
+      if (sh>0) {
+        if (memory && sh<period) sh=m-period;
+        memory=0;
+        j+=sh;
+        continue;
+      }
+      size_t i=max(suffix, memory);
+      while (i<m-1 && p[i]==h[i+j]) ++i;
+      if (m-1<=i) {
+        i=suffix-1;
+        while (memory<i+1 && p[i]==h[i+j]) --i;
+        if (i+1<memory+1) return offset+j;
+        j+=period;
+        memory=m-period;
+      } else {
+        j+=i-suffix+1;
+        memory=0;
+      }
+    }
+  } else {
+    while (j<=len-m) {
+      size_t sh=shift[h[j+m-1]];
+      if (sh>0) {
+        j+=sh;
+        continue;
+      }
+      size_t i=suffix;
+      while (i<m-1 && p[i]==h[i+j]) ++i;
+      if (m-1<=i) {
+        i=suffix-1;
+        while (i!=size_t(-1) && p[i]==h[i+j]) --i;
+        if (i==size_t(-1)) return offset+j;
+        j+=period;
+      } else {
+        j+=i-suffix+1;
+      }
+    }
+  }
+  return std::string::npos;
+}
+
+bool substring_searcher::verify(const unsigned char *s, size_t n, size_t pos,
+                                unsigned int bucket_bits, int *id) const
+{
+  int best=-1;
+  for (;bucket_bits;bucket_bits&=bucket_bits-1) {
+    const vector<int> &b=buckets[__builtin_ctz(bucket_bits)];
+    for (size_t i=0;i<b.size();++i) {
+      const std::string &w=needles[b[i]];
+      if (best>=0 && w.size()<needles[best].size()) break;
+      if (w.size()>n-pos || memcmp(s+pos, w.data(), w.size())!=0) continue;
+      if (best<0 || w.size()>needles[best].size() || b[i]<best) best=b[i];
+      break;
+    }
+  }
+  if (best<0) return false;
+  if (id) *id=best;
+  return true;
+}
+
+size_t substring_searcher::find_multi(const char *s, size_t n, size_t offset, int *id) const
+{
+  const unsigned char *u=reinterpret_cast<const unsigned char*>(s);
+
+  if (min_len==0) {
+    // the empty needle matches right away; prefer a longer one there
+    int best=-1;
+    for (size_t i=0;i<needles.size();++i) {
+      const std::string &w=needles[i];
+      if (w.size()>n-offset || memcmp(s+offset, w.data(), w.size())!=0) continue;
+      if (best<0 || w.size()>needles[best].size()) best=i;
+    }
+    if (id) *id=best;
+    return offset;
+  }
+
+  if (n-offset<min_len) return std::string::npos;
+  size_t i=offset;
+
+#ifdef PFI_SUBSTRING_SEARCH_X86
+  if (has_ssse3) {
+    const size_t end=n-fp_len+1;
+    unsigned char cand[16];
+    for (;;) {
+      unsigned int bits;
+      i=teddy_scan(&nibble_mask[0], fp_len, u, i, end, cand, bits);
+      if (!bits) break;
+      for (;bits;bits&=bits-1) {
+        size_t j=__builtin_ctz(bits);
+        if (verify(u, n, i+j, cand[j], id)) return i+j;
+      }
+      i+=16;
+    }
+  }
+#endif
+
+  return find_multi_scalar(u, n, i, n-min_len+1, id);
+}
+
+size_t substring_searcher::find_multi_scalar(const unsigned char *s, size_t n,
+                                             size_t from, size_t to, int *id) const
+{
+  const unsigned char *m=&byte_mask[0];
+  for (size_t i=from;i<to;++i) {
+    unsigned int bits=m[s[i]];
+    for (size_t k=1;k<fp_len && bits;++k) bits&=m[256*k+s[i+k]];
+    if (bits && verify(s, n, i, bits, id)) return i;
+  }
+  return std::string::npos;
+}
+
+} // string
+} // data
+} // pfi
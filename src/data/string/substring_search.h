@@ -0,0 +1,108 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INCLUDE_GUARD_PFI_DATA_STRING_SUBSTRING_SEARCH_H_
+#define INCLUDE_GUARD_PFI_DATA_STRING_SUBSTRING_SEARCH_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace pfi{
+namespace data{
+namespace string{
+
+// byte substring search for one or a few needles.
+// the algorithm is chosen from the needles:
+//   one byte:          memchr
+//   up to 32 bytes:    SIMD scan for the first and last bytes, then compare
+//   longer:            two-way with a last byte skip table (linear time)
+//   2 or more needles: Teddy-like SIMD fingerprint of the first 1-3 bytes
+//                      in 8 buckets, then compare the needles of a bucket
+// several needles are meant for small sets (up to around 64); larger sets
+// should use aho_corasick.
+class substring_searcher{
+public:
+  substring_searcher();
+  explicit substring_searcher(const std::string &needle);
+  explicit substring_searcher(const std::vector<std::string> &needles);
+
+  // leftmost occurrence at or after offset, or std::string::npos.
+  // among needles starting there the longest (then the first) is taken,
+  // and its index is stored in *id.
+  size_t find(const char *s, size_t n, size_t offset, int *id=NULL) const;
+  size_t find(const std::string &text, size_t offset=0, int *id=NULL) const {
+    return find(text.data(), text.size(), offset, id);
+  }
+
+  size_t needle_count() const { return needles.size(); }
+  const std::string &needle(int id) const { return needles[id]; }
+
+private:
+  enum algorithm{
+    none,
+    empty_needle,
+    single_byte,
+    first_last,
+    two_way,
+    multi
+  };
+
+  void init_two_way();
+  void init_multi();
+
+  size_t find_first_last(const char *s, size_t n, size_t offset) const;
+  size_t find_two_way(const char *s, size_t n, size_t offset) const;
+  size_t find_multi(const char *s, size_t n, size_t offset, int *id) const;
+  size_t find_multi_scalar(const unsigned char *s, size_t n, size_t from, size_t to, int *id) const;
+  bool verify(const unsigned char *s, size_t n, size_t pos, unsigned int buckets, int *id) const;
+
+  std::vector<std::string> needles;
+  algorithm algo;
+
+  // two_way: critical factorization and skip by the last byte
+  size_t suffix, period;
+  bool periodic;
+  std::vector<size_t> shift;
+
+  // multi: fingerprint length, nibble masks per fingerprint byte (lo then
+  // hi, 16 bytes each), byte masks for the scalar path, and the needles
+  // of each bucket, longest first
+  size_t fp_len, min_len;
+  std::vector<unsigned char> nibble_mask;
+  std::vector<unsigned char> byte_mask;
+  std::vector<std::vector<int> > buckets;
+};
+
+} // string
+} // data
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_DATA_STRING_SUBSTRING_SEARCH_H_
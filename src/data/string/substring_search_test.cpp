@@ -0,0 +1,176 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include "substring_search.h"
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace pfi::data::string;
+
+namespace {
+
+string random_string(size_t n, int alpha)
+{
+  string ret;
+  for (size_t i=0;i<n;++i) ret+=char('a'+rand()%alpha);
+  return ret;
+}
+
+// leftmost, then longest, then first needle
+size_t naive_find(const vector<string> &needles, const string &text, size_t offset, int &id)
+{
+  for (size_t i=offset;i<=text.size();++i) {
+    id=-1;
+    for (size_t j=0;j<needles.size();++j) {
+      if (text.compare(i, needles[j].size(), needles[j])!=0) continue;
+      if (id<0 || needles[j].size()>needles[id].size()) id=j;
+    }
+    if (id>=0) return i;
+  }
+  return string::npos;
+}
+
+} // namespace
+
+TEST(substring_search_test, single)
+{
+  substring_searcher none;
+  EXPECT_EQ(string::npos, none.find("abc"));
+
+  substring_searcher e("");
+  EXPECT_EQ(0u, e.find("abc"));
+  EXPECT_EQ(3u, e.find("abc", 3));
+  EXPECT_EQ(string::npos, e.find("abc", 4));
+
+  substring_searcher a("a");
+  EXPECT_EQ(2u, a.find("bba"));
+  EXPECT_EQ(string::npos, a.find("bbb"));
+
+  substring_searcher ab("ab");
+  EXPECT_EQ(3u, ab.find("aaaab"));
+  EXPECT_EQ(string::npos, ab.find("aaaab", 4));
+
+  string text=string(100, 'x')+"needle"+string(100, 'x');
+  substring_searcher s("needle");
+  EXPECT_EQ(100u, s.find(text));
+  int id=-1;
+  EXPECT_EQ(100u, s.find(text, 50, &id));
+  EXPECT_EQ(0, id);
+  EXPECT_EQ(string::npos, s.find(text, 101));
+
+  string l(100, 'z');
+  l[50]='y';
+  substring_searcher ls(l);
+  EXPECT_EQ(7u, ls.find(string(7, 'z')+l+"zz"));
+  EXPECT_EQ(string::npos, ls.find(string(1000, 'z')));
+}
+
+TEST(substring_search_test, single_random)
+{
+  srand(1);
+  for (int t=0;t<3000;++t) {
+    int alpha=1+t%4;
+    string text=random_string(rand()%500, alpha);
+    string needle;
+    switch (rand()%3) {
+    case 0: needle=random_string(1+rand()%40, alpha); break;
+    case 1: needle=random_string(30+rand()%80, alpha); break;
+    default: {
+      // periodic needles, often found in the text
+      string unit=random_string(1+rand()%5, alpha);
+      while (needle.size()<size_t(2+rand()%100)) needle+=unit;
+      size_t at=text.empty() ? 0 : rand()%text.size();
+      if (rand()%2) text.insert(at, needle);
+    }
+    }
+    substring_searcher s(needle);
+    for (size_t offset=0;offset<=text.size();offset+=1+rand()%50)
+      ASSERT_EQ(text.find(needle, offset), s.find(text, offset)) << needle << " " << text;
+  }
+}
+
+TEST(substring_search_test, multi)
+{
+  vector<string> needles;
+  needles.push_back("he");
+  needles.push_back("she");
+  needles.push_back("hers");
+  needles.push_back("his");
+  substring_searcher s(needles);
+  EXPECT_EQ(4u, s.needle_count());
+
+  int id=-1;
+  EXPECT_EQ(1u, s.find("ushers", 0, &id));
+  EXPECT_EQ(1, id);
+  EXPECT_EQ(2u, s.find("ushers", 2, &id));
+  EXPECT_EQ(2, id);
+  EXPECT_EQ(string::npos, s.find("ushers", 3, &id));
+  EXPECT_EQ(string::npos, s.find("", 0, &id));
+
+  needles.push_back("");
+  substring_searcher e(needles);
+  EXPECT_EQ(1u, e.find("xhers", 1, &id));
+  EXPECT_EQ(2, id);
+  EXPECT_EQ(0u, e.find("xhers", 0, &id));
+  EXPECT_EQ(4, id);
+
+  vector<string> one(1, "abc");
+  substring_searcher o(one);
+  EXPECT_EQ(2u, o.find("ababc", 0, &id));
+  EXPECT_EQ(0, id);
+}
+
+TEST(substring_search_test, multi_random)
+{
+  srand(2);
+  for (int t=0;t<1000;++t) {
+    int alpha=2+t%6;
+    vector<string> needles(2+rand()%64);
+    for (size_t i=0;i<needles.size();++i)
+      needles[i]=random_string(1+rand()%(1+t%10), alpha);
+    string text=random_string(rand()%1000, alpha+2);
+    substring_searcher s(needles);
+    for (size_t offset=0;offset<=text.size();) {
+      int id=-1, exp_id=-1;
+      size_t pos=s.find(text, offset, &id);
+      size_t exp=naive_find(needles, text, offset, exp_id);
+      ASSERT_EQ(exp, pos);
+      if (exp==string::npos) break;
+      ASSERT_EQ(exp_id, id);
+      offset=pos+1;
+    }
+  }
+}
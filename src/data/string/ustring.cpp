@@ -35,6 +35,10 @@
 #include <string.h>
 #include <iterator>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 using namespace std;
 
 namespace pfi {
@@ -87,30 +91,175 @@ static int take_handakuten_tbl[]={
   0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
 };
 
+namespace {
+// length of the well-formed sequence at p with its code point in c,
+// or 0 if it is invalid or truncated. accepts the same sequences as
+// chars_to_uchar_impl does without calling the fallback.
+inline int utf8_sequence(const unsigned char* p, const unsigned char* end, uchar& c)
+{
+  const unsigned b0 = p[0];
+  if (b0 < 0x80) {
+    c = b0;
+    return 1;
+  }
+  if (b0 < 0xC2)
+    return 0;
+  if (b0 < 0xE0) {
+    if (end - p < 2 || (p[1] & 0xC0) != 0x80)
+      return 0;
+    c = ((b0 & 0x1F) << 6) | (p[1] & 0x3F);
+    return 2;
+  }
+  if (b0 < 0xF0) {
+    const unsigned lo = b0 == 0xE0 ? 0xA0 : 0x80, hi = b0 == 0xED ? 0x9F : 0xBF;
+    if (end - p < 3 || p[1] < lo || p[1] > hi || (p[2] & 0xC0) != 0x80)
+      return 0;
+    c = ((b0 & 0x0F) << 12) | ((p[1] & 0x3F) << 6) | (p[2] & 0x3F);
+    return 3;
+  }
+  if (b0 < 0xF5) {
+    const unsigned lo = b0 == 0xF0 ? 0x90 : 0x80, hi = b0 == 0xF4 ? 0x8F : 0xBF;
+    if (end - p < 4 || p[1] < lo || p[1] > hi ||
+        (p[2] & 0xC0) != 0x80 || (p[3] & 0xC0) != 0x80)
+      return 0;
+    c = ((b0 & 0x07) << 18) | ((p[1] & 0x3F) << 12) | ((p[2] & 0x3F) << 6) | (p[3] & 0x3F);
+    return 4;
+  }
+  return 0;
+}
+
+// decodes the well-formed prefix of [p, end) into out and returns where
+// it stopped. ASCII runs are widened 16 bytes at a time.
+const unsigned char* decode_utf8(const unsigned char* p, const unsigned char* end, uchar*& out)
+{
+  while (p < end) {
+    if (*p < 0x80) {
+#ifdef __SSE2__
+      const __m128i zero = _mm_setzero_si128();
+      while (end - p >= 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        if (_mm_movemask_epi8(v))
+          break;
+        const __m128i lo = _mm_unpacklo_epi8(v, zero), hi = _mm_unpackhi_epi8(v, zero);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi16(lo, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4), _mm_unpackhi_epi16(lo, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8), _mm_unpacklo_epi16(hi, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 12), _mm_unpackhi_epi16(hi, zero));
+        p += 16;
+        out += 16;
+      }
+#endif
+      while (p < end && *p < 0x80)
+        *out++ = *p++;
+      continue;
+    }
+
+    uchar c;
+    const int n = utf8_sequence(p, end, c);
+    if (n == 0)
+      break;
+    *out++ = c;
+    p += n;
+  }
+  return p;
+}
+
+// same as decode_utf8 without output
+const unsigned char* validate_utf8(const unsigned char* p, const unsigned char* end)
+{
+  while (p < end) {
+    if (*p < 0x80) {
+#ifdef __SSE2__
+      while (end - p >= 16) {
+        const int m = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+        if (m) {
+          p += __builtin_ctz(m);
+          break;
+        }
+        p += 16;
+      }
+#endif
+      while (p < end && *p < 0x80)
+        ++p;
+      continue;
+    }
+
+    uchar c;
+    const int n = utf8_sequence(p, end, c);
+    if (n == 0)
+      break;
+    p += n;
+  }
+  return p;
+}
+} // namespace
+
 ustring string_to_ustring(const char* p) {
   return string_to_ustring(p, strlen(p));
 }
 
 ustring string_to_ustring(const char* p, size_t len) {
-  const char* const end = p + len;
   ustring res;
-  while(p != end) res+=chars_to_uchar(p, end);
+  if (len == 0)
+    return res;
+
+  // every character consumes at least one byte
+  res.resize(len);
+  uchar* const begin = &res[0];
+  uchar* out = begin;
+  const unsigned char* in = reinterpret_cast<const unsigned char*>(p);
+  const unsigned char* const end = in + len;
+  for (;;) {
+    in = decode_utf8(in, end, out);
+    if (in == end)
+      break;
+
+    // invalid sequence: let the fallback decide
+    const char* it = reinterpret_cast<const char*>(in);
+    *out++ = chars_to_uchar(it, reinterpret_cast<const char*>(end));
+    in = reinterpret_cast<const unsigned char*>(it);
+  }
+  res.resize(out - begin);
   return res;
 }
 
 ustring string_to_ustring(const std::string& s) {
-  ustring res;
-  for (std::string::const_iterator it = s.begin(), end = s.end(); it != end; ) {
-    res += chars_to_uchar(it, end);
-  }
-  return res;
+  return string_to_ustring(s.data(), s.size());
 }
 
 std::string ustring_to_string(const ustring& us) {
   std::string res;
-  std::back_insert_iterator<std::string> ins(res);
-  for(size_t i = 0 ; i < us.size() ; i ++)
-    uchar_to_chars(us[i], ins);
+  if (us.empty())
+    return res;
+
+  res.resize(us.size() * 4);
+  char* const begin = &res[0];
+  char* out = begin;
+  const uchar* in = us.data();
+  const uchar* const end = in + us.size();
+#ifdef __SSE2__
+  // ASCII blocks are narrowed 16 characters at a time
+  const __m128i non_ascii = _mm_set1_epi32(~0x7F), zero = _mm_setzero_si128();
+  while (end - in >= 16) {
+    const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 4));
+    const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 8));
+    const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 12));
+    const __m128i any = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(any, non_ascii), zero)) == 0xFFFF) {
+      const __m128i v = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out), v);
+      out += 16;
+    } else {
+      for (int i = 0; i < 16; ++i)
+        uchar_to_chars(in[i], out);
+    }
+    in += 16;
+  }
+#endif
+  while (in != end)
+    uchar_to_chars(*in++, out);
+  res.resize(out - begin);
   return res;
 }
 
@@ -183,112 +332,115 @@ int utf8_skip(const std::string& s, size_t p){
 } // namespace
 
 bool check_utf8(const std::string& s) {
-  try {
-    exception_fallback fb;
-    for (std::string::const_iterator it = s.begin(), end = s.end(); it != end; ) {
-      chars_to_uchar(it, end, fb);
-    }
-    return true;
-  } catch (const std::invalid_argument&) {
-    return false;
-  }
+  const unsigned char* const end = reinterpret_cast<const unsigned char*>(s.data()) + s.size();
+  return validate_utf8(reinterpret_cast<const unsigned char*>(s.data()), end) == end;
 }
 
-std::string sanitize_utf8(const std::string& s){
-  std::string ret;
-  unsigned char buf[10];
-  for (size_t p = 0; p < s.size();) {
-    const int ccc = utf8_skip(s, p);
-    if (ccc < 0) {
-      p++;
-      continue;
-    }
-    size_t orgp = p;
-    p++;
-    int i = 0;
-    buf[i] = s[orgp];
-    for (; p <= ccc + orgp && p < s.size(); p++) {
-      if ((s[p]&0xc0) != 0x80) break;
-    }
-    int cccc = ccc + 1;
-    std::string retpartial;
-    if (p == ccc + orgp + 1) {
-      for (size_t t = orgp; t < p; t++) {
-        retpartial += s[t];
-        buf[i] = s[t];
-        i++;
+namespace {
+// longest prefix of [p, end) kept as is by sanitize_utf8: printable ASCII
+// and well-formed sequences other than U+FFFE and U+FFFF
+const unsigned char* sanitized_prefix(const unsigned char* p, const unsigned char* end)
+{
+  while (p < end) {
+    if (*p < 0x80) {
+      if (*p < 0x20)
+        break;
+      ++p;
+#ifdef __SSE2__
+      // bytes below 0x20 and above 0x7F are both negative or less than 0x20
+      const __m128i space = _mm_set1_epi8(0x20);
+      while (end - p >= 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const int m = _mm_movemask_epi8(_mm_cmplt_epi8(v, space));
+        if (m) {
+          p += __builtin_ctz(m);
+          break;
+        }
+        p += 16;
       }
-    } else {
+#endif
       continue;
     }
-    bool invalid = true;
-    if (cccc == 1) {
-      if (buf[0] < 0x20) continue;
-      invalid = false;
-    }
-    if (cccc == 2) {
-      if (utf8_invalid2(buf)) continue;
-      if (0xc2 <= buf[0] && buf[0] <= 0xdf && 0x80 <= buf[1] && buf[1] <= 0xbf) invalid = false;
-    }
-    if (cccc == 3) {
-      if (utf8_invalid3(buf)) continue;
-      if (buf[0] == 0xe0 && 0xa0 <= buf[1] && buf[1] <= 0xbf && 0x80 <= buf[2] && buf[2] <= 0xbf) invalid = false;
-      if (0xe1 <= buf[0] && buf[0] <= 0xec && 0x80 <= buf[1] && buf[1] <= 0xbf && 0x80 <= buf[2] && buf[2] <= 0xbf) invalid = false;
-      if (buf[0] == 0xed && 0x80 <= buf[1] && buf[1] <= 0x9f && 0x80 <= buf[2] && buf[2] <= 0xbf) invalid = false;
-      if (0xee <= buf[0] && buf[0] <= 0xef && 0x80 <= buf[1] && buf[1] <= 0xbf && 0x80 <= buf[2] && buf[2] <= 0xbf) invalid = false;
-    }
-    if (cccc == 4) {
-      if (utf8_invalid4(buf)) continue;
-      if (buf[0] == 0xf0 && 0x90 <= buf[1] && buf[1] <= 0xbf && 0x80 <= buf[2] && buf[2] <= 0xbf && 0x80 <= buf[3] && buf[3] <= 0xbf) invalid = false;
 
-      if (0xf1 <= buf[0] && buf[0] <= 0xf3 && 0x80 <= buf[1] && buf[1] <= 0xbf && 0x80 <= buf[2] && buf[2] <= 0xbf && 0x80 <= buf[3] && buf[3] <=
-          0xbf) invalid = false;
-      if (buf[0] == 0xf4 && 0x80 <= buf[1] && buf[1] <= 0x8f && 0x80 <= buf[2] && buf[2] <= 0xbf && 0x80 <= buf[3] && buf[3] <= 0xbf) invalid = false;
-    }
-    // TODO: check cccc == 5, cccc == 6
-    if (invalid) continue;
-    ret += retpartial;
+    uchar c;
+    const int n = utf8_sequence(p, end, c);
+    if (n == 0 || c == 0xFFFE || c == 0xFFFF)
+      break;
+    p += n;
   }
-  return ret;
+  return p;
 }
 
-ustring hankaku_to_zenkaku(const ustring& ustr){
-  ustring res;
-  for (size_t i=0;i<ustr.size();++i) {
-    uchar c=res.size()>0?res[res.size()-1]:0xFFFFFFFFU;
-    if (is_hankaku(ustr[i])) {
-      if (ustr[i]==UTF_HANKAKU_DAKUTEN) { 
-        if (c!=0xFFFFFFFFU&&is_katakana(c)&&take_dakuten_tbl[c-0x30a0]) {
-          if (c==0x30a6) { // ウ
-            res[res.size()-1]=0x30f4;
-          } else if (c==0x30f2) { // ヲ
-            res[res.size()-1]=0x30fa;
-          } else {
-            ++res[res.size()-1];
-          }
-        } else {
-          res.push_back(UTF_ZENKAKU_DAKUTEN); // zenkaku dakuten
-        }
-      } else if (ustr[i]==UTF_HANKAKU_HANDAKUTEN) {
-        if (c!=0xFFFFFFFFU&&is_katakana(c)&&take_handakuten_tbl[c-0x30a0]) {
-          res[res.size()-1]+=2;
-        } else {
-          res.push_back(UTF_ZENKAKU_HANDAKUTEN); // zenkaku dakuten
-        }
-      } else {
-        res.push_back(hankaku_zenkaku_tbl[ustr[i]-0xff60]);
-      }
-    } else if (ustr[i]==UTF_HANKAKU_BAR) { // -
-      if (c!=0xFFFFFFFFU&&!is_basic_latin(c)) {
-        res.push_back(UTF_ZENKAKU_BAR);
-      } else {
-        res.push_back(ustr[i]);
-      }
-    } else {
-      res.push_back(ustr[i]);
+// sanitizes one character at p, returns the next position
+size_t sanitize_char(const std::string& s, size_t p, std::string& ret)
+{
+  unsigned char buf[10];
+  const int ccc = utf8_skip(s, p);
+  if (ccc < 0) {
+    return p + 1;
+  }
+  size_t orgp = p;
+  p++;
+  int i = 0;
+  buf[i] = s[orgp];
+  for (; p <= ccc + orgp && p < s.size(); p++) {
+    if ((s[p]&0xc0) != 0x80) break;
+  }
+  int cccc = ccc + 1;
+  std::string retpartial;
+  if (p == ccc + orgp + 1) {
+    for (size_t t = orgp; t < p; t++) {
+      retpartial += s[t];
+      buf[i] = s[t];
+      i++;
     }
-  } 
-  return res;
+  } else {
+    return p;
+  }
+  bool invalid = true;
+  if (cccc == 1) {
+    if (buf[0] < 0x20) return p;
+    invalid = false;
+  }
+  if (cccc == 2) {
+    if (utf8_invalid2(buf)) return p;
+    if (0xc2 <= buf[0] && buf[0] <= 0xdf && 0x80 <= buf[1] && buf[1] <= 0xbf) invalid = false;
+  }
+  if (cccc == 3) {
+    if (utf8_invalid3(buf)) return p;
+    if (buf[0] == 0xe0 && 0xa0 <= buf[1] && buf[1] <= 0xbf && 0x80 <= buf[2] && buf[2] <= 0xbf) invalid = false;
+    if (0xe1 <= buf[0] && buf[0] <= 0xec && 0x80 <= buf[1] && buf[1] <= 0xbf && 0x80 <= buf[2] && buf[2] <= 0xbf) invalid = false;
+    if (buf[0] == 0xed && 0x80 <= buf[1] && buf[1] <= 0x9f && 0x80 <= buf[2] && buf[2] <= 0xbf) invalid = false;
+    if (0xee <= buf[0] && buf[0] <= 0xef && 0x80 <= buf[1] && buf[1] <= 0xbf && 0x80 <= buf[2] && buf[2] <= 0xbf) invalid = false;
+  }
+  if (cccc == 4) {
+    if (utf8_invalid4(buf)) return p;
+    if (buf[0] == 0xf0 && 0x90 <= buf[1] && buf[1] <= 0xbf && 0x80 <= buf[2] && buf[2] <= 0xbf && 0x80 <= buf[3] && buf[3] <= 0xbf) invalid = false;
+
+    if (0xf1 <= buf[0] && buf[0] <= 0xf3 && 0x80 <= buf[1] && buf[1] <= 0xbf && 0x80 <= buf[2] && buf[2] <= 0xbf && 0x80 <= buf[3] && buf[3] <=
+        0xbf) invalid = false;
+    if (buf[0] == 0xf4 && 0x80 <= buf[1] && buf[1] <= 0x8f && 0x80 <= buf[2] && buf[2] <= 0xbf && 0x80 <= buf[3] && buf[3] <= 0xbf) invalid = false;
+  }
+  // TODO: check cccc == 5, cccc == 6
+  if (invalid) return p;
+  ret += retpartial;
+  return p;
+}
+} // namespace
+
+std::string sanitize_utf8(const std::string& s){
+  std::string ret;
+  ret.reserve(s.size());
+  const unsigned char* const begin = reinterpret_cast<const unsigned char*>(s.data());
+  const unsigned char* const end = begin + s.size();
+  for (size_t p = 0; p < s.size();) {
+    const size_t q = sanitized_prefix(begin + p, end) - begin;
+    ret.append(s, p, q - p);
+    p = q;
+    if (p < s.size())
+      p = sanitize_char(s, p, ret);
+  }
+  return ret;
 }
 
 namespace {
@@ -313,21 +465,143 @@ inline uchar basic_latin_to_zenkaku_latin_impl(uchar uc)
 }
 } // namespace
 
-ustring zenkaku_latin_to_basic_latin(const ustring& us)
+ustring basic_latin_to_zenkaku_latin(const ustring& us)
 {
   ustring res=us;
   for (size_t i=0;i<us.size();++i) {
-    res[i]=zenkaku_latin_to_basic_latin_impl(us[i]);
+    res[i]=basic_latin_to_zenkaku_latin_impl(us[i]);
   }
   return res;
 }
 
-ustring basic_latin_to_zenkaku_latin(const ustring& us)
+namespace {
+// transforms of normalize() after hankaku_to_zenkaku, which do not
+// depend on the neighbouring characters
+inline uchar fold_uchar(uchar uc, int flags)
 {
-  ustring res=us;
-  for (size_t i=0;i<us.size();++i) {
-    res[i]=basic_latin_to_zenkaku_latin_impl(us[i]);
+  if (flags & normalize_zenkaku_latin)
+    uc = zenkaku_latin_to_basic_latin_impl(uc);
+  if (flags & normalize_lower) {
+    if (uc - 'A' < 26U || uc - 0xff21 < 26U)
+      uc += 0x20;
   }
+  if (flags & normalize_katakana) {
+    if (uc - 0x30a1 < 0x56U || uc == 0x30fd || uc == 0x30fe)
+      uc -= 0x60;
+  }
+  return uc;
+}
+
+#ifdef __SSE2__
+inline __m128i add_in_range(__m128i v, int lo, int hi, int delta)
+{
+  const __m128i m = _mm_and_si128(_mm_cmpgt_epi32(v, _mm_set1_epi32(lo - 1)),
+                                  _mm_cmplt_epi32(v, _mm_set1_epi32(hi + 1)));
+  return _mm_add_epi32(v, _mm_and_si128(m, _mm_set1_epi32(delta)));
+}
+
+inline __m128i in_range(__m128i v, int lo, int hi)
+{
+  return _mm_and_si128(_mm_cmpgt_epi32(v, _mm_set1_epi32(lo - 1)),
+                       _mm_cmplt_epi32(v, _mm_set1_epi32(hi + 1)));
+}
+
+// fold_uchar for 4 characters
+inline __m128i fold_uchar4(__m128i v, int flags)
+{
+  if (flags & normalize_zenkaku_latin) {
+    v = add_in_range(v, 0xff01, 0xff5e, 0x0020 - 0xff00);
+    v = add_in_range(v, UTF_ZENKAKU_SPACE, UTF_ZENKAKU_SPACE, UTF_HANKAKU_SPACE - UTF_ZENKAKU_SPACE);
+  }
+  if (flags & normalize_lower) {
+    v = add_in_range(v, 'A', 'Z', 0x20);
+    v = add_in_range(v, 0xff21, 0xff3a, 0x20);
+  }
+  if (flags & normalize_katakana) {
+    v = add_in_range(v, 0x30a1, 0x30f6, -0x60);
+    v = add_in_range(v, 0x30fd, 0x30fe, -0x60);
+  }
+  return v;
+}
+#endif
+} // namespace
+
+size_t normalize(const uchar* in, size_t n, uchar* out, int flags)
+{
+  const bool hankaku = flags & normalize_hankaku_kana;
+  // last character after hankaku_to_zenkaku, before the other transforms
+  uchar prev = 0;
+  size_t j = 0;
+  for (size_t i = 0; i < n; ) {
+#ifdef __SSE2__
+    // blocks without hankaku kana or '-' are transformed 4 at a time.
+    // out never passes in, so the block is read before it is overwritten
+    if (n - i >= 4) {
+      const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+      if (!hankaku ||
+          !_mm_movemask_epi8(_mm_or_si128(in_range(v, 0xff60, 0xff9f),
+                                          _mm_cmpeq_epi32(v, _mm_set1_epi32(UTF_HANKAKU_BAR))))) {
+        prev = in[i + 3];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + j), fold_uchar4(v, flags));
+        i += 4;
+        j += 4;
+        continue;
+      }
+    }
+#endif
+    uchar c = in[i++];
+    if (hankaku) {
+      if (is_hankaku(c)) {
+        if (c == UTF_HANKAKU_DAKUTEN) {
+          if (j > 0 && is_katakana(prev) && take_dakuten_tbl[prev - 0x30a0]) {
+            if (prev == 0x30a6) // ウ
+              prev = 0x30f4;
+            else if (prev == 0x30f2) // ヲ
+              prev = 0x30fa;
+            else
+              ++prev;
+            out[j - 1] = fold_uchar(prev, flags);
+            continue;
+          }
+          c = UTF_ZENKAKU_DAKUTEN;
+        } else if (c == UTF_HANKAKU_HANDAKUTEN) {
+          if (j > 0 && is_katakana(prev) && take_handakuten_tbl[prev - 0x30a0]) {
+            prev += 2;
+            out[j - 1] = fold_uchar(prev, flags);
+            continue;
+          }
+          c = UTF_ZENKAKU_HANDAKUTEN;
+        } else {
+          c = hankaku_zenkaku_tbl[c - 0xff60];
+        }
+      } else if (c == UTF_HANKAKU_BAR && j > 0 && !is_basic_latin(prev)) {
+        c = UTF_ZENKAKU_BAR;
+      }
+    }
+    prev = c;
+    out[j++] = fold_uchar(c, flags);
+  }
+  return j;
+}
+
+void normalize(ustring& us, int flags)
+{
+  if (us.empty())
+    return;
+  us.resize(normalize(&us[0], us.size(), &us[0], flags));
+}
+
+ustring hankaku_to_zenkaku(const ustring& us)
+{
+  ustring res = us;
+  normalize(res, normalize_hankaku_kana);
+  return res;
+}
+
+ustring zenkaku_latin_to_basic_latin(const ustring& us)
+{
+  ustring res = us;
+  normalize(res, normalize_zenkaku_latin);
   return res;
 }
 
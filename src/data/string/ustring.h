@@ -41,6 +41,8 @@
 #include <stdint.h>
 #include <stdexcept>
 
+#include "../functional_hash.h"
+
 namespace pfi {
 namespace data {
 namespace string {
@@ -282,10 +284,30 @@ ustring basic_latin_to_zenkaku_latin(const ustring& us);
 uchar zenkaku_latin_to_basic_latin(uchar uc);
 uchar basic_latin_to_zenkaku_latin(uchar uc);
 
+// transforms for normalize(), combined with |
+enum normalize_flag {
+  normalize_hankaku_kana = 1 << 0,  // same as hankaku_to_zenkaku
+  normalize_zenkaku_latin = 1 << 1, // same as zenkaku_latin_to_basic_latin
+  normalize_lower = 1 << 2,         // A-Z and zenkaku A-Z to lower case
+  normalize_katakana = 1 << 3       // katakana to hiragana
+};
+
+// applies the selected transforms in the order listed above in a single
+// pass, and returns the length of out, which is at most n. out may be in.
+size_t normalize(const uchar* in, size_t n, uchar* out, int flags);
+void normalize(ustring& us, int flags);
+
 std::ostream& operator<<(std::ostream& out, const ustring &str);
 std::istream& operator>>(std::istream& in , ustring &str);
 
 } // string
+
+template <>
+struct hash<string::ustring> : public hash<std::basic_string<string::uchar> > {
+  hash() {}
+  explicit hash(uint64_t seed) : hash<std::basic_string<string::uchar> >(seed) {}
+};
+
 } // data
 } // pfi
 #endif // #ifndef INCLUDE_GUARD_PFI_DATA_STRING_USTRING_H_
@@ -34,6 +34,9 @@
 #include "./ustring.h"
 
 #include <algorithm>
+#include <ctime>
+#include <iterator>
+#include <stdexcept>
 #include <vector>
 
 using namespace std;
@@ -133,6 +136,170 @@ TEST(ustring_test, basic_latin_to_zenkaku_latin_ustring) {
   EXPECT_EQ(zenkaku_latin,basic_latin_to_zenkaku_latin(basic_latin));
 }
 
+namespace {
+// long strings mixing ASCII runs, multibyte characters and broken bytes
+std::string random_utf8(size_t n) {
+  static const char* pieces[] = {
+    "abcdefghijklmnopqrstuvwxyz0123456789", "\t\n", "\xC3\xA9", "\xE3\x81\x82",
+    "\xEF\xBF\xBF", "\xF0\x9F\x98\x80", "\xED\xA0\x80", "\xC0\xAF", "\xE3\x81",
+    "\xF4\x90\x80\x80", "\xFE", "\x80", "" // NUL
+  };
+  std::string s;
+  while (s.size() < n) {
+    const char* p = pieces[rand() % (sizeof(pieces)/sizeof(pieces[0]))];
+    s += *p ? std::string(p) : std::string(1, '\0');
+    if (rand() % 4 == 0) s += std::string(rand() % 40, 'x');
+  }
+  return s;
+}
+}
+
+TEST(ustring_test, conversion_random) {
+  srand(time(NULL));
+  for (int t = 0; t < 200; ++t) {
+    const std::string s = random_utf8(rand() % 200);
+
+    ustring expect;
+    bool valid = true;
+    for (std::string::const_iterator it = s.begin(); it != s.end(); ) {
+      try {
+        exception_fallback fb;
+        std::string::const_iterator jt = it;
+        chars_to_uchar(jt, s.end(), fb);
+      } catch (const std::invalid_argument&) {
+        valid = false;
+      }
+      expect += chars_to_uchar(it, s.end());
+    }
+    EXPECT_EQ(expect, string_to_ustring(s));
+    EXPECT_EQ(expect, string_to_ustring(s.data(), s.size()));
+    EXPECT_EQ(valid, check_utf8(s));
+
+    std::string back;
+    std::back_insert_iterator<std::string> ins(back);
+    for (size_t i = 0; i < expect.size(); ++i)
+      uchar_to_chars(expect[i], ins);
+    EXPECT_EQ(back, ustring_to_string(expect));
+
+    const std::string sanitized = sanitize_utf8(s);
+    EXPECT_TRUE(check_utf8(sanitized));
+    EXPECT_EQ(sanitized, sanitize_utf8(sanitized));
+  }
+}
+
+namespace {
+// the scalar conversions normalize() replaced, kept as its reference
+const uchar ref_hankaku_zenkaku_tbl[]={
+  0x0000,0x3002,0x300c,0x300d,0x3001,0x30fb,0x30f2,0x30a1,0x30a3,0x30a5,0x30a7,0x30a9,0x30e3,0x30e5,0x30e7,0x30c3, // 0xff60 - 0xff6f
+  0x30fc,0x30a2,0x30a4,0x30a6,0x30a8,0x30aa,0x30ab,0x30ad,0x30af,0x30b1,0x30b3,0x30b5,0x30b7,0x30b9,0x30bb,0x30bd, // 0xff70 - 0xff7f
+  0x30bf,0x30c1,0x30c4,0x30c6,0x30c8,0x30ca,0x30cb,0x30cc,0x30cd,0x30ce,0x30cf,0x30d2,0x30d5,0x30d8,0x30db,0x30de, // 0xff80 - 0xff8f
+  0x30df,0x30e0,0x30e1,0x30e2,0x30e4,0x30e6,0x30e8,0x30e9,0x30ea,0x30eb,0x30ec,0x30ed,0x30ef,0x30f3,0x3099,0x309a // 0xff90 - 0x9f
+};
+
+const int ref_take_dakuten_tbl[]={
+  0,0,0,0,0,0,1,0,0,0,0,1,0,1,0,1,
+  0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,
+  0,1,0,0,1,0,1,0,1,0,0,0,0,0,0,1,
+  0,0,1,0,0,1,0,0,1,0,0,1,0,0,0,0,
+  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+  0,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,
+};
+
+const int ref_take_handakuten_tbl[]={
+  0,0,0,0,0,0,0,0,0,0,0,0,0,1,0,1,
+  0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,
+  0,1,0,0,1,0,1,0,1,0,0,0,0,0,0,1,
+  0,0,1,0,0,1,0,0,1,0,0,1,0,0,0,0,
+  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+};
+
+ustring hankaku_to_zenkaku_reference(const ustring& ustr) {
+  ustring res;
+  for (size_t i=0;i<ustr.size();++i) {
+    uchar c=res.size()>0?res[res.size()-1]:0xFFFFFFFFU;
+    if (is_hankaku(ustr[i])) {
+      if (ustr[i]==0xff9e) { // hankaku dakuten
+        if (c!=0xFFFFFFFFU&&is_katakana(c)&&ref_take_dakuten_tbl[c-0x30a0]) {
+          if (c==0x30a6) { // ウ
+            res[res.size()-1]=0x30f4;
+          } else if (c==0x30f2) { // ヲ
+            res[res.size()-1]=0x30fa;
+          } else {
+            ++res[res.size()-1];
+          }
+        } else {
+          res.push_back(0x3099); // zenkaku dakuten
+        }
+      } else if (ustr[i]==0xff9f) { // hankaku handakuten
+        if (c!=0xFFFFFFFFU&&is_katakana(c)&&ref_take_handakuten_tbl[c-0x30a0]) {
+          res[res.size()-1]+=2;
+        } else {
+          res.push_back(0x309a); // zenkaku handakuten
+        }
+      } else {
+        res.push_back(ref_hankaku_zenkaku_tbl[ustr[i]-0xff60]);
+      }
+    } else if (ustr[i]=='-') {
+      if (c!=0xFFFFFFFFU&&!is_basic_latin(c)) {
+        res.push_back(0x30fc); // ー
+      } else {
+        res.push_back(ustr[i]);
+      }
+    } else {
+      res.push_back(ustr[i]);
+    }
+  }
+  return res;
+}
+
+// hankaku_to_zenkaku followed by each transform applied separately
+ustring normalize_reference(const ustring& us, int flags) {
+  ustring res = (flags & normalize_hankaku_kana) ? hankaku_to_zenkaku_reference(us) : us;
+  for (size_t i = 0; i < res.size(); ++i) {
+    if (flags & normalize_zenkaku_latin) {
+      if (0xff01 <= res[i] && res[i] <= 0xff5e)
+        res[i] = res[i] - 0xff00 + 0x0020;
+      else if (res[i] == 0x3000)
+        res[i] = ' ';
+    }
+    if ((flags & normalize_lower) &&
+        (('A' <= res[i] && res[i] <= 'Z') || (0xff21 <= res[i] && res[i] <= 0xff3a)))
+      res[i] += 0x20;
+    if ((flags & normalize_katakana) &&
+        ((0x30a1 <= res[i] && res[i] <= 0x30f6) || res[i] == 0x30fd || res[i] == 0x30fe))
+      res[i] -= 0x60;
+  }
+  return res;
+}
+}
+
+TEST(ustring_test, normalize) {
+  ustring fused = string_to_ustring("ｶﾞﾊﾟ-ＡＢＣ　Abc");
+  normalize(fused, normalize_hankaku_kana | normalize_zenkaku_latin |
+            normalize_lower | normalize_katakana);
+  EXPECT_EQ(string_to_ustring("がぱーabc abc"), fused);
+
+  const ustring pool = hankaku_kana + katakana + hiragana + alphabet + zenkaku_latin +
+    basic_latin + string_to_ustring("ﾞﾟ-ヽヾ漢字");
+  srand(time(NULL));
+  for (int t = 0; t < 1000; ++t) {
+    ustring us;
+    const int n = rand() % 40;
+    for (int i = 0; i < n; ++i)
+      us += pool[rand() % pool.size()];
+    const int flags = rand() % 16;
+
+    EXPECT_EQ(hankaku_to_zenkaku_reference(us), hankaku_to_zenkaku(us));
+    const ustring expect = normalize_reference(us, flags);
+    ustring out(us.size(), 0);
+    out.resize(normalize(us.data(), us.size(), &out[0], flags));
+    EXPECT_EQ(expect, out);
+    normalize(us, flags);
+    EXPECT_EQ(expect, us);
+  }
+}
+
 TEST(check_utf8_test, valid) {
   EXPECT_TRUE(check_utf8("有効なUTF-8文字列"));
 }
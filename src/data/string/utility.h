@@ -34,8 +34,18 @@
 
 #include <vector>
 #include <algorithm>
+#include <iterator>
+#include <string>
+#include <type_traits>
 
 #include <ctype.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "string_view.h"
 
 namespace pfi{
 namespace data{
@@ -171,16 +181,72 @@ inline String rstrip(const String &str)
   return ret;
 }
 
+namespace detail {
+
+// the int overloads are preferred; a piece with neither size() nor a
+// terminating null is taken as a single character
+template <class T>
+inline auto piece_size(const T &s, int) -> decltype(size_t(s.size()))
+{
+  return s.size();
+}
+
+template <class Char>
+inline size_t piece_size(Char *s, int)
+{
+  return std::char_traits<typename std::remove_const<Char>::type>::length(s);
+}
+
+template <class T>
+inline size_t piece_size(const T &, long)
+{
+  return 1;
+}
+
+template <class String, class T>
+inline void append_piece(String &ret, const T &s)
+{
+  ret += s;
+}
+
+template <class String, class Char>
+inline void append_piece(String &ret, const basic_string_view<Char> &s)
+{
+  ret.append(s.begin(), s.end());
+}
+
+template <class Iterator, class String>
+void reserve_join(Iterator begin, Iterator end, const String &sep, String &ret,
+                  std::forward_iterator_tag)
+{
+  size_t n = 0;
+  for (Iterator p = begin; p != end; p++) {
+    if (p != begin) n += sep.size();
+    n += piece_size(*p, 0);
+  }
+  ret.reserve(n);
+}
+
+template <class Iterator, class String>
+void reserve_join(Iterator, Iterator, const String &, String &, std::input_iterator_tag)
+{
+}
+
+} // detail
+
+// the result is allocated once when the pieces can be visited twice
 template <class Iterator, class String>
 void join(Iterator begin, Iterator end, const String &sep, String &res)
 {
   String ret;
+  detail::reserve_join(begin, end, sep, ret,
+                       typename std::iterator_traits<Iterator>::iterator_category());
   bool first = true;
 
   for (Iterator p = begin; p != end; p++) {
     if (first) first = false;
     else ret += sep;
-    ret += *p;
+    detail::append_piece(ret, *p);
   }
 
   ret.swap(res);
@@ -251,6 +317,239 @@ inline String replace(const String &str, const String &from, const String &to)
   return ret;
 }
 
+// view-returning variants. the results refer to the characters of str,
+// which must outlive them.
+
+template <class String>
+basic_string_view<typename String::value_type> strip_view(const String &str)
+{
+  const typename String::value_type *beg = str.data(), *end = beg + str.size();
+  while (beg != end && isspace(*beg)) ++beg;
+  while (beg != end && isspace(end[-1])) --end;
+  return basic_string_view<typename String::value_type>(beg, end);
+}
+
+template <class String>
+basic_string_view<typename String::value_type> lstrip_view(const String &str)
+{
+  const typename String::value_type *beg = str.data(), *end = beg + str.size();
+  while (beg != end && isspace(*beg)) ++beg;
+  return basic_string_view<typename String::value_type>(beg, end);
+}
+
+template <class String>
+basic_string_view<typename String::value_type> rstrip_view(const String &str)
+{
+  const typename String::value_type *beg = str.data(), *end = beg + str.size();
+  while (beg != end && isspace(end[-1])) --end;
+  return basic_string_view<typename String::value_type>(beg, end);
+}
+
+// a set of single byte delimiters for split_view.
+// up to 8 delimiters are searched 16 bytes at a time.
+class delimiter_set {
+public:
+  delimiter_set() : num(0) {
+    std::fill(table, table + 256, false);
+  }
+  explicit delimiter_set(string_view chars) : num(0) {
+    std::fill(table, table + 256, false);
+    for (size_t i = 0; i < chars.size(); ++i) {
+      if (table[(unsigned char)chars[i]]) continue;
+      table[(unsigned char)chars[i]] = true;
+      if (num < max_vector) vec[num] = chars[i];
+      ++num;
+    }
+  }
+
+  bool contains(char c) const { return table[(unsigned char)c]; }
+  size_t length() const { return 1; }
+
+  const char *find(const char *b, const char *e) const {
+    if (num == 0)
+      return e;
+    if (num == 1)
+      return find_one(b, e, vec[0]);
+#ifdef __SSE2__
+    if (num <= max_vector) {
+      __m128i needles[max_vector];
+      for (int i = 0; i < num; ++i)
+        needles[i] = _mm_set1_epi8(vec[i]);
+      for (; e - b >= 16; b += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+        __m128i m = _mm_cmpeq_epi8(v, needles[0]);
+        for (int i = 1; i < num; ++i)
+          m = _mm_or_si128(m, _mm_cmpeq_epi8(v, needles[i]));
+        const int mask = _mm_movemask_epi8(m);
+        if (mask) return b + __builtin_ctz(mask);
+      }
+    }
+#endif
+    while (b != e && !table[(unsigned char)*b]) ++b;
+    return b;
+  }
+
+  static const char *find_one(const char *b, const char *e, char c) {
+    const void *p = memchr(b, c, e - b);
+    return p ? static_cast<const char*>(p) : e;
+  }
+
+private:
+  static const int max_vector = 8;
+  bool table[256];
+  char vec[max_vector];
+  int num;
+};
+
+namespace detail {
+
+template <class Char>
+inline const Char *find_char(const Char *b, const Char *e, Char c)
+{
+  return std::find(b, e, c);
+}
+
+inline const char *find_char(const char *b, const char *e, char c)
+{
+  return delimiter_set::find_one(b, e, c);
+}
+
+template <class Char>
+class char_delimiter {
+public:
+  char_delimiter() : c() {}
+  explicit char_delimiter(Char c) : c(c) {}
+  const Char *find(const Char *b, const Char *e) const { return find_char(b, e, c); }
+  size_t length() const { return 1; }
+private:
+  Char c;
+};
+
+template <class Char>
+class string_delimiter {
+public:
+  string_delimiter() {}
+  explicit string_delimiter(basic_string_view<Char> s) : s(s) {}
+  const Char *find(const Char *b, const Char *e) const {
+    for (;; ++b) {
+      b = find_char(b, e, s[0]);
+      if (size_t(e - b) < s.size()) return e;
+      if (std::char_traits<Char>::compare(b, s.data(), s.size()) == 0) return b;
+    }
+  }
+  size_t length() const { return s.size(); }
+private:
+  basic_string_view<Char> s;
+};
+
+} // detail
+
+// forward iterator over the pieces of a split_view
+template <class Char, class Delimiter>
+class split_iterator {
+public:
+  typedef std::forward_iterator_tag iterator_category;
+  typedef basic_string_view<Char> value_type;
+  typedef ptrdiff_t difference_type;
+  typedef const value_type *pointer;
+  typedef const value_type &reference;
+
+  split_iterator() : delim(), rest(NULL), end(NULL), last(true), done(true) {}
+  split_iterator(const Char *b, const Char *e, const Delimiter &delim)
+    : delim(delim), end(e), done(false) {
+    next(b);
+  }
+
+  reference operator*() const { return cur; }
+  pointer operator->() const { return &cur; }
+
+  split_iterator &operator++() {
+    if (last) done = true;
+    else next(rest);
+    return *this;
+  }
+
+  split_iterator operator++(int) {
+    split_iterator ret = *this;
+    ++*this;
+    return ret;
+  }
+
+  bool operator==(const split_iterator &it) const {
+    if (done || it.done) return done == it.done;
+    return cur.data() == it.cur.data() && last == it.last;
+  }
+  bool operator!=(const split_iterator &it) const { return !(*this == it); }
+
+private:
+  void next(const Char *b) {
+    const Char *d = delim.find(b, end);
+    cur = value_type(b, d);
+    last = d == end;
+    rest = last ? end : d + delim.length();
+  }
+
+  Delimiter delim;
+  value_type cur;
+  const Char *rest, *end;
+  bool last, done;
+};
+
+// lazily split pieces as views, without allocation
+template <class Char, class Delimiter>
+class split_range {
+public:
+  typedef split_iterator<Char, Delimiter> iterator;
+  typedef iterator const_iterator;
+  typedef basic_string_view<Char> value_type;
+
+  split_range(basic_string_view<Char> str, const Delimiter &delim, bool empty = false)
+    : str(str), delim(delim), empty(empty) {}
+
+  iterator begin() const {
+    if (empty) return iterator();
+    return iterator(str.begin(), str.end(), delim);
+  }
+  iterator end() const { return iterator(); }
+
+  template <class Container>
+  Container to() const { return Container(begin(), end()); }
+
+private:
+  basic_string_view<Char> str;
+  Delimiter delim;
+  bool empty;
+};
+
+template <class String, class Char>
+inline typename std::enable_if<std::is_integral<Char>::value,
+                               split_range<typename String::value_type,
+                                           detail::char_delimiter<typename String::value_type> > >::type
+split_view(const String &str, Char sep)
+{
+  typedef typename String::value_type C;
+  return split_range<C, detail::char_delimiter<C> >(
+    basic_string_view<C>(str.data(), str.size()), detail::char_delimiter<C>(sep));
+}
+
+template <class String>
+inline split_range<char, delimiter_set> split_view(const String &str, const delimiter_set &seps)
+{
+  return split_range<char, delimiter_set>(string_view(str.data(), str.size()), seps);
+}
+
+// an empty sep gives no pieces, as split does
+template <class String>
+inline split_range<typename String::value_type, detail::string_delimiter<typename String::value_type> >
+split_view(const String &str, const String &sep)
+{
+  typedef typename String::value_type C;
+  return split_range<C, detail::string_delimiter<C> >(
+    basic_string_view<C>(str.data(), str.size()),
+    detail::string_delimiter<C>(basic_string_view<C>(sep.data(), sep.size())),
+    sep.empty());
+}
+
 } // string
 } // data
 } // pfi
@@ -317,3 +317,107 @@ TEST(utility_test, replace)
   EXPECT_EQ("bba", replace<string>("aaaaa", "aa", "b"));
   EXPECT_EQ("cbc", replace<string>("abababa", "aba", "c"));
 }
+
+namespace {
+
+template <class Range>
+vector<string> to_strings(const Range &r)
+{
+  vector<string> ret;
+  for (typename Range::iterator it = r.begin(); it != r.end(); ++it)
+    ret.push_back(it->str());
+  return ret;
+}
+
+vector<string> split_set_reference(const string &str, const string &seps)
+{
+  vector<string> ret(1);
+  for (size_t i = 0; i < str.size(); ++i) {
+    if (seps.find(str[i]) != string::npos) ret.push_back("");
+    else ret.back() += str[i];
+  }
+  return ret;
+}
+
+} // namespace
+
+TEST(utility_test, split_view)
+{
+  const char *strs[] = {"", ",", ",,", "a", "a,b", "a,b,c", "a,", ",a,", "ab,,cd,"};
+  for (size_t i = 0; i < sizeof(strs) / sizeof(strs[0]); ++i) {
+    string s = strs[i];
+    EXPECT_TRUE(split(s, ',') == to_strings(split_view(s, ',')));
+    EXPECT_TRUE(split(s, string(",,")) == to_strings(split_view(s, string(",,"))));
+    EXPECT_TRUE(split(s, string("")) == to_strings(split_view(s, string(""))));
+    EXPECT_TRUE(split(s, ',') == to_strings(split_view(s, delimiter_set(","))));
+    vector<string> whole(1, s);
+    EXPECT_TRUE(whole == to_strings(split_view(s, delimiter_set())));
+    EXPECT_TRUE(whole == to_strings(split_view(s, delimiter_set(""))));
+  }
+  {
+    string s(100, 'a');
+    vector<string> whole(1, s);
+    EXPECT_TRUE(whole == to_strings(split_view(s, delimiter_set())));
+  }
+  {
+    string s = "abc,def";
+    vector<string_view> res = split_view(s, ',').to<vector<string_view> >();
+    ASSERT_EQ(2u, res.size());
+    EXPECT_EQ(s.data(), res[0].data());
+    EXPECT_EQ(s.data() + 4, res[1].data());
+  }
+  {
+    ustring s = U("あ☆い☆う");
+    vector<ustring> res;
+    typedef split_range<uchar, detail::char_delimiter<uchar> > range;
+    range r = split_view(s, string_to_uchar("☆"));
+    for (range::iterator it = r.begin(); it != r.end(); ++it)
+      res.push_back(it->to<ustring>());
+    EXPECT_TRUE(split(s, string_to_uchar("☆")) == res);
+  }
+
+  srand(1);
+  const char alphabet[] = "ab ,;\t|\n";
+  const string sets[] = {",", ",;", " \t\n", ",;|\t\n :x", "abcdefghijk,"};
+  for (int t = 0; t < 1000; ++t) {
+    string s;
+    const int n = rand() % 100;
+    for (int i = 0; i < n; ++i)
+      s += alphabet[rand() % (sizeof(alphabet) - 1)];
+    for (size_t j = 0; j < sizeof(sets) / sizeof(sets[0]); ++j)
+      EXPECT_TRUE(split_set_reference(s, sets[j]) ==
+                  to_strings(split_view(s, delimiter_set(sets[j]))));
+  }
+}
+
+TEST(utility_test, strip_view)
+{
+  const char *strs[] = {"", " ", "  a", "a  ", " \t a b \n ", "ab"};
+  for (size_t i = 0; i < sizeof(strs) / sizeof(strs[0]); ++i) {
+    string s = strs[i];
+    EXPECT_EQ(strip(s), strip_view(s).str());
+    EXPECT_EQ(lstrip(s), lstrip_view(s).str());
+    EXPECT_EQ(rstrip(s), rstrip_view(s).str());
+  }
+}
+
+TEST(utility_test, join_view)
+{
+  string s = "a,,bc,d";
+  vector<string_view> pieces = split_view(s, ',').to<vector<string_view> >();
+  EXPECT_EQ("a::::bc::d", join(pieces, string("::")));
+
+  list<string> strs; strs.push_back("x"); strs.push_back("yz");
+  EXPECT_EQ("x-yz", join(strs, string("-")));
+
+  vector<const char*> cstrs; cstrs.push_back("p"); cstrs.push_back("q");
+  EXPECT_EQ("p q", join(cstrs, string(" ")));
+
+  char p[] = "pq", q[] = "r";
+  vector<char*> mstrs; mstrs.push_back(p); mstrs.push_back(q);
+  EXPECT_EQ("pq r", join(mstrs, string(" ")));
+
+  string chars = "abc", res;
+  join(chars.begin(), chars.end(), string(","), res);
+  EXPECT_EQ("a,b,c", res);
+}